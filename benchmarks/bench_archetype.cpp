@@ -0,0 +1,91 @@
+#include "benchutils.hpp"
+
+#include <engine/game/core/registry.hpp>
+#include <engine/utils/containers/archetypestorage.hpp>
+
+struct Position { float x, y, z; };
+struct Velocity { float x, y, z; };
+struct Health { int value; };
+struct Tag { int group; };
+
+// Mixed component sets: every entity has a Position, half of them a Velocity and
+// a scrambled half of those a Health, giving four archetypes.
+// Joins are compared between one WeakSlotMap per type (Registry) and archetypes.
+void benchJoin(uint32_t _numEntities)
+{
+	Registry registry;
+	auto positions = registry.getComponents<Position>();
+	auto velocities = registry.getComponents<Velocity>();
+	auto healths = registry.getComponents<Health>();
+	utils::ArchetypeStorage<Entity::IdType> archetypes;
+	for (uint32_t i = 0; i < _numEntities; ++i)
+	{
+		const Entity ent = registry.create();
+		positions.insert(ent, Position{ 0.f, 0.f, 0.f });
+		archetypes.emplace<Position>(ent.toIndex(), Position{ 0.f, 0.f, 0.f });
+		if (i % 2)
+		{
+			velocities.insert(ent, Velocity{ 1.f, 0.f, 0.f });
+			archetypes.emplace<Velocity>(ent.toIndex(), Velocity{ 1.f, 0.f, 0.f });
+		}
+		if (scramble(i) % 2)
+		{
+			healths.insert(ent, Health{ 100 });
+			archetypes.emplace<Health>(ent.toIndex(), Health{ 100 });
+		}
+	}
+
+	report("Registry join 2 components", _numEntities, measure([&]()
+		{
+			registry.execute([](Position& _pos, const Velocity& _vel) { _pos.x += _vel.x; });
+		}, _numEntities));
+	report("ArchetypeStorage join 2 components", _numEntities, measure([&]()
+		{
+			archetypes.forEach<Position, const Velocity>([](Entity::IdType, Position& _pos, const Velocity& _vel) { _pos.x += _vel.x; });
+		}, _numEntities));
+	report("Registry join 3 components", _numEntities, measure([&]()
+		{
+			registry.execute([](Position& _pos, const Velocity& _vel, Health& _health) { _pos.x += _vel.x; _health.value -= 1; });
+		}, _numEntities));
+	report("ArchetypeStorage join 3 components", _numEntities, measure([&]()
+		{
+			archetypes.forEach<Position, const Velocity, Health>([](Entity::IdType, Position& _pos, const Velocity& _vel, Health& _health)
+				{
+					_pos.x += _vel.x;
+					_health.value -= 1;
+				});
+		}, _numEntities));
+
+	// structural changes: add and remove a Tag for 10% of the entities
+	auto tags = registry.getComponents<Tag>();
+	const uint32_t numChanges = _numEntities / 10;
+	report("Registry add + remove component", numChanges, measure([&]()
+		{
+			for (uint32_t i = 0; i < numChanges; ++i)
+				tags.insert(Entity((i * 7919u) % _numEntities), Tag{ 1 });
+			for (uint32_t i = 0; i < numChanges; ++i)
+				tags.erase(Entity((i * 7919u) % _numEntities));
+		}, numChanges));
+	report("ArchetypeStorage add + remove component", numChanges, measure([&]()
+		{
+			for (uint32_t i = 0; i < numChanges; ++i)
+				archetypes.emplace<Tag>((i * 7919u) % _numEntities, Tag{ 1 });
+			for (uint32_t i = 0; i < numChanges; ++i)
+				archetypes.remove<Tag>((i * 7919u) % _numEntities);
+		}, numChanges));
+
+	float sum = 0.f;
+	archetypes.forEach<const Position>([&](Entity::IdType, const Position& _pos) { sum += _pos.x; });
+	registry.execute([&](const Position& _pos) { sum += _pos.x; });
+	consume(static_cast<uint64_t>(sum));
+}
+
+int main()
+{
+	for (uint32_t n : {10000u, 1000000u})
+	{
+		benchJoin(n);
+		std::cout << std::endl;
+	}
+	return 0;
+}
@@ -0,0 +1,103 @@
+#include "benchutils.hpp"
+
+#include <engine/utils/blockalloc.hpp>
+#include <vector>
+#include <thread>
+#include <memory>
+#include <string>
+
+// Similar to a SparseOctree node: bounds, child pointers and a small payload.
+struct OctreeNode
+{
+	float min[3], max[3];
+	OctreeNode* children[4];
+	uint64_t payload = 0;
+};
+
+// Keep _numLive objects alive and replace a pseudo random one _numOps times.
+// Returns ns per destroy + create pair.
+template<typename Create, typename Destroy>
+double churn(uint32_t _numLive, uint32_t _numOps, Create&& _create, Destroy&& _destroy)
+{
+	std::vector<OctreeNode*> live(_numLive);
+	for (uint32_t i = 0; i < _numLive; ++i)
+		live[i] = _create();
+	const double t = measure([&]()
+		{
+			for (uint32_t i = 0; i < _numOps; ++i)
+			{
+				OctreeNode*& node = live[scramble(i) % _numLive];
+				_destroy(node);
+				node = _create();
+				node->payload = i;
+			}
+		}, _numOps);
+	for (OctreeNode* node : live)
+	{
+		consume(node->payload);
+		_destroy(node);
+	}
+	return t;
+}
+
+// The memory after a warmup with _numLive objects has to stay the same during the churn.
+template<typename Allocator>
+void benchAllocator(const std::string& _name, uint32_t _numLive, uint32_t _numOps)
+{
+	Allocator alloc;
+	std::vector<OctreeNode*> warmup;
+	for (uint32_t i = 0; i < _numLive; ++i)
+		warmup.push_back(alloc.create());
+	for (OctreeNode* node : warmup) alloc.destroy(node);
+	const size_t memoryBefore = alloc.memoryUsage();
+	report(_name + " create + destroy", _numOps, churn(_numLive, _numOps,
+		[&]() { return alloc.create(); },
+		[&](OctreeNode* _node) { alloc.destroy(_node); }));
+	report(_name + " memory before", _numOps, memoryBefore / 1024.0, "KiB");
+	report(_name + " memory after", _numOps, alloc.memoryUsage() / 1024.0, "KiB");
+}
+
+void benchChurn(uint32_t _numLive, uint32_t _numOps)
+{
+	report("new + delete", _numOps, churn(_numLive, _numOps,
+		[]() { return new OctreeNode(); },
+		[](OctreeNode* _node) { delete _node; }));
+
+	benchAllocator<utils::BlockAllocator<OctreeNode, 128>>("BlockAllocator", _numLive, _numOps);
+	benchAllocator<utils::BlockAllocator<OctreeNode, 128, true>>("BlockAllocator thread local", _numLive, _numOps);
+}
+
+// Every thread churns its own objects in one shared allocator.
+void benchThreads(uint32_t _numThreads, uint32_t _numLive, uint32_t _numOps)
+{
+	const std::string threads = std::to_string(_numThreads) + " threads ";
+	auto run = [&](auto&& _create, auto&& _destroy)
+	{
+		std::vector<std::thread> workers;
+		const double t = measure([&]()
+			{
+				for (uint32_t i = 0; i < _numThreads; ++i)
+					workers.emplace_back([&]() { churn(_numLive / _numThreads, _numOps / _numThreads, _create, _destroy); });
+				for (std::thread& worker : workers) worker.join();
+			}, _numOps);
+		return t;
+	};
+
+	report(threads + "new + delete", _numOps, run(
+		[]() { return new OctreeNode(); },
+		[](OctreeNode* _node) { delete _node; }));
+
+	utils::BlockAllocator<OctreeNode, 128, true> alloc;
+	report(threads + "BlockAllocator thread local", _numOps, run(
+		[&]() { return alloc.create(); },
+		[&](OctreeNode* _node) { alloc.destroy(_node); }));
+	report(threads + "BlockAllocator memory", _numOps, alloc.memoryUsage() / 1024.0, "KiB");
+}
+
+int main()
+{
+	benchChurn(100000, 10000000);
+	std::cout << std::endl;
+	benchThreads(4, 100000, 10000000);
+	return 0;
+}
@@ -0,0 +1,81 @@
+#include "benchutils.hpp"
+
+#include <engine/utils/containers/concurrenthashmap.hpp>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <atomic>
+#include <string>
+
+// Adapter for a HashMap protected by a single global mutex, as needed so far.
+struct GlobalLockMap
+{
+	void add(uint32_t _key, uint32_t _data)
+	{
+		std::scoped_lock lock(mutex);
+		map.add(_key, _data);
+	}
+	bool contains(uint32_t _key) const
+	{
+		std::scoped_lock lock(mutex);
+		return static_cast<bool>(map.find(_key));
+	}
+	utils::HashMap<uint32_t, uint32_t> map;
+	mutable std::mutex mutex;
+};
+
+struct ShardedMap
+{
+	void add(uint32_t _key, uint32_t _data) { map.add(_key, _data); }
+	bool contains(uint32_t _key) const { return map.find(_key).has_value(); }
+	utils::ConcurrentHashMap<uint32_t, uint32_t> map;
+};
+
+// Read mostly workload: every thread does 1 insert per 16 lookups.
+template<typename MapT>
+void benchScaling(const std::string& _name, uint32_t _numElements, unsigned _numThreads)
+{
+	MapT map;
+	for (uint32_t i = 0; i < _numElements; ++i)
+		map.add(scramble(i), i);
+
+	constexpr uint32_t NUM_OPS_PER_THREAD = 1000000;
+	std::atomic<uint64_t> totalFound = 0;
+	const double tOps = measure([&]()
+		{
+			std::vector<std::thread> threads;
+			for (unsigned t = 0; t < _numThreads; ++t)
+				threads.emplace_back([&, t]()
+					{
+						uint64_t found = 0;
+						for (uint32_t i = 0; i < NUM_OPS_PER_THREAD; ++i)
+						{
+							if (i % 16 == 0)
+								map.add(scramble(_numElements + t * NUM_OPS_PER_THREAD + i), i);
+							else
+								found += map.contains(scramble((i * 7919u + t) % _numElements));
+						}
+						totalFound += found;
+					});
+			for (auto& thread : threads)
+				thread.join();
+		}, NUM_OPS_PER_THREAD * static_cast<size_t>(_numThreads));
+	consume(totalFound);
+	report(_name + " " + std::to_string(_numThreads) + " threads", _numElements, tOps);
+}
+
+// Usage: bench_concurrenthashmap [maxThreads], defaults to the hardware concurrency.
+int main(int _argc, char** _argv)
+{
+	const unsigned maxThreads = _argc > 1 ? static_cast<unsigned>(std::stoul(_argv[1]))
+		: std::max(1u, std::thread::hardware_concurrency());
+	std::cout << "mixed find/add, time per operation over all threads" << std::endl;
+	for (unsigned numThreads = 1; numThreads <= maxThreads; numThreads *= 2)
+	{
+		benchScaling<GlobalLockMap>("HashMap + global mutex", 100000, numThreads);
+		benchScaling<ShardedMap>("ConcurrentHashMap", 100000, numThreads);
+	}
+
+	return 0;
+}
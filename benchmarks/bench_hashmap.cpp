@@ -0,0 +1,138 @@
+#include "benchutils.hpp"
+
+#include <engine/utils/containers/hashmap.hpp>
+#include <engine/utils/containers/flathashmap.hpp>
+#include <engine/utils/containers/densehashmap.hpp>
+#include <unordered_map>
+#include <vector>
+
+// Adapter to use std::unordered_map with the HashMap interface in the benchmarks.
+template<typename K, typename T>
+struct StdMap
+{
+	void add(const K& _key, const T& _data) { map[_key] = _data; }
+	bool contains(const K& _key) const { return map.find(_key) != map.end(); }
+	void remove(const K& _key) { map.erase(_key); }
+	std::unordered_map<K, T> map;
+};
+
+template<typename MapT>
+bool contains(const MapT& _map, uint32_t _key) { return static_cast<bool>(_map.find(_key)); }
+template<typename K, typename T>
+bool contains(const StdMap<K, T>& _map, uint32_t _key) { return _map.contains(_key); }
+
+template<typename MapT>
+void benchLookups(const std::string& _name, uint32_t _numElements)
+{
+	MapT map;
+	const double tInsert = measure([&]()
+		{
+			for (uint32_t i = 0; i < _numElements; ++i)
+				map.add(scramble(i), i);
+		}, _numElements);
+	report(_name + " insert", _numElements, tInsert);
+
+	// Query in a different order than insertion to avoid cache friendly patterns.
+	constexpr uint32_t NUM_QUERIES = 1000000;
+	const double tHit = measure([&]()
+		{
+			uint64_t found = 0;
+			for (uint32_t i = 0; i < NUM_QUERIES; ++i)
+				found += contains(map, scramble((i * 7919u) % _numElements));
+			consume(found);
+		}, NUM_QUERIES);
+	report(_name + " find (hit)", _numElements, tHit);
+
+	const double tMiss = measure([&]()
+		{
+			uint64_t found = 0;
+			for (uint32_t i = 0; i < NUM_QUERIES; ++i)
+				found += contains(map, scramble(_numElements + i));
+			consume(found);
+		}, NUM_QUERIES);
+	report(_name + " find (miss)", _numElements, tMiss);
+
+	const double tRemove = measure([&]()
+		{
+			for (uint32_t i = 0; i < _numElements; i += 2)
+				map.remove(scramble(i));
+		}, _numElements / 2);
+	report(_name + " remove", _numElements, tRemove);
+}
+
+// Growth and lookups with string keys, where hashing and comparing is expensive.
+template<typename MapT>
+void benchStringRehash(const std::string& _name, uint32_t _numElements)
+{
+	std::vector<std::string> keys;
+	keys.reserve(_numElements);
+	for (uint32_t i = 0; i < _numElements; ++i)
+		keys.push_back("resources/textures/some_longer_name_" + std::to_string(scramble(i)));
+
+	MapT map(_numElements);
+	for (uint32_t i = 0; i < _numElements; ++i)
+		map.add(keys[i], i);
+
+	// Each reserve doubles the capacity and therefore rehashes all elements.
+	const double tRehash = measure([&]()
+		{
+			map.reserve(_numElements * 2);
+			map.reserve(_numElements * 4);
+		}, _numElements * 2);
+	report(_name + " rehash (per element)", _numElements, tRehash);
+
+	constexpr uint32_t NUM_QUERIES = 1000000;
+	const double tHit = measure([&]()
+		{
+			uint64_t found = 0;
+			for (uint32_t i = 0; i < NUM_QUERIES; ++i)
+				found += static_cast<bool>(map.find(keys[(i * 7919u) % _numElements]));
+			consume(found);
+		}, NUM_QUERIES);
+	report(_name + " find (hit)", _numElements, tHit);
+}
+
+// Iterate over all elements of a full map and of the same map after removing 99% of the elements.
+template<typename MapT>
+void benchIteration(const std::string& _name, uint32_t _numElements)
+{
+	MapT map;
+	for (uint32_t i = 0; i < _numElements; ++i)
+		map.add(scramble(i), i);
+
+	auto iterate = [&]()
+		{
+			uint64_t sum = 0;
+			for (auto it : map)
+				sum += it.data();
+			consume(sum);
+		};
+	report(_name + " iterate (full)", map.size(), measure(iterate, map.size()));
+
+	for (uint32_t i = 0; i < _numElements; ++i)
+		if (i % 100 != 0) map.remove(scramble(i));
+	report(_name + " iterate (1% remaining)", map.size(), measure(iterate, map.size()));
+}
+
+int main()
+{
+	benchStringRehash<utils::HashMap<std::string, uint32_t>>("HashMap (odd capacity)", 1000000);
+	benchStringRehash<utils::HashMap<std::string, uint32_t, std::hash<std::string>, std::equal_to<std::string>,
+		utils::PowerOfTwoLayout>>("HashMap (power of two)", 1000000);
+	std::cout << std::endl;
+
+	benchIteration<utils::HashMap<uint32_t, uint32_t>>("HashMap (robin hood)", 1000000);
+	benchIteration<utils::DenseHashMap<uint32_t, uint32_t>>("DenseHashMap", 1000000);
+	std::cout << std::endl;
+
+	for (uint32_t n : {1000u, 100000u, 10000000u})
+	{
+		benchLookups<utils::HashMap<uint32_t, uint32_t>>("HashMap (robin hood)", n);
+		benchLookups<utils::FlatHashMap<uint32_t, uint32_t>>("FlatHashMap (control bytes)", n);
+		benchLookups<utils::DenseHashMap<uint32_t, uint32_t>>("DenseHashMap", n);
+		benchLookups<StdMap<uint32_t, uint32_t>>("std::unordered_map", n);
+		std::cout << std::endl;
+	}
+
+	return 0;
+}
@@ -0,0 +1,56 @@
+#include "benchutils.hpp"
+
+#include <engine/utils/containers/hashmap.hpp>
+#include <engine/utils/containers/mappedhashmap.hpp>
+#include <string>
+#include <vector>
+#include <cstdio>
+
+// Startup cost of an asset name -> id table: rebuilding it element by element
+// compared to opening a memory mapped image of it.
+int main()
+{
+	constexpr uint32_t NUM_ELEMENTS = 1000000;
+	constexpr uint32_t NUM_QUERIES = 1000;
+	const char* fileName = "bench_mappedhashmap.bin";
+
+	std::vector<std::string> names;
+	names.reserve(NUM_ELEMENTS);
+	for (uint32_t i = 0; i < NUM_ELEMENTS; ++i)
+		names.push_back("assets/textures/environment/tile_" + std::to_string(scramble(i)) + ".png");
+
+	using NameMap = utils::HashMap<std::string, uint32_t, utils::StableHash, std::equal_to<>, utils::PowerOfTwoLayout>;
+	using MappedNameMap = utils::MappedHashMap<std::string, uint32_t>;
+
+	const double tBuild = measure([&]()
+		{
+			NameMap map;
+			for (uint32_t i = 0; i < NUM_ELEMENTS; ++i)
+				map.add(names[i], i);
+			uint64_t sum = 0;
+			for (uint32_t i = 0; i < NUM_QUERIES; ++i)
+				sum += map.find(std::string_view(names[(i * 7919u) % NUM_ELEMENTS])).data();
+			consume(sum);
+		});
+	report("HashMap insert all + lookups", NUM_ELEMENTS, tBuild / 1.0e6, "ms");
+
+	{
+		NameMap map;
+		for (uint32_t i = 0; i < NUM_ELEMENTS; ++i)
+			map.add(names[i], i);
+		MappedNameMap::write(fileName, map);
+	}
+
+	const double tMapped = measure([&]()
+		{
+			const MappedNameMap map(fileName);
+			uint64_t sum = 0;
+			for (uint32_t i = 0; i < NUM_QUERIES; ++i)
+				sum += map.find(names[(i * 7919u) % NUM_ELEMENTS]).data();
+			consume(sum);
+		});
+	report("MappedHashMap open + lookups", NUM_ELEMENTS, tMapped / 1.0e6, "ms");
+
+	std::remove(fileName);
+	return 0;
+}
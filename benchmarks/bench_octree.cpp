@@ -0,0 +1,93 @@
+#include "benchutils.hpp"
+
+#include <engine/utils/containers/octree.hpp>
+#include <glm/glm.hpp>
+#include <vector>
+#include <string>
+
+using Tree = utils::SparseOctree<uint32_t, 2, float>;
+using AABB = Tree::AABB;
+
+// Counts all nodes of the tree.
+struct NodeCounter
+{
+	bool descend(const AABB&) { ++numNodes; return true; }
+	void process(const AABB&, uint32_t) {}
+
+	size_t numNodes = 0;
+};
+
+// Pseudo random value in [0, 1).
+float random01(uint32_t& _state)
+{
+	_state = scramble(_state + 1);
+	return static_cast<float>(_state >> 8) / static_cast<float>(1 << 24);
+}
+
+AABB objectBox(const glm::vec2& _position)
+{
+	return AABB(_position, _position + glm::vec2(0.5f));
+}
+
+void reportTree(const std::string& _name, const Tree& _tree, const std::vector<glm::vec2>& _positions)
+{
+	const uint32_t numQueries = 10000;
+	size_t numHits = 0;
+	report(_name + " query", _positions.size(), measure([&]()
+		{
+			for (uint32_t i = 0; i < numQueries; ++i)
+			{
+				const glm::vec2& center = _positions[scramble(i) % _positions.size()];
+				Tree::AABBQuery query(AABB(center - glm::vec2(5.f), center + glm::vec2(5.f)));
+				_tree.traverse(query);
+				numHits += query.hits.size();
+			}
+		}, numQueries));
+	consume(numHits);
+
+	NodeCounter counter;
+	_tree.traverse(counter);
+	report(_name + " nodes", _positions.size(), static_cast<double>(counter.numNodes), "nodes");
+	report(_name + " memory", _positions.size(), _tree.memoryUsage() / 1024.0, "KiB");
+}
+
+// Objects do a random walk with a common drift, so that the occupied region
+// moves far away from where the tree started.
+void benchMoves(uint32_t _numObjects, uint32_t _numRounds)
+{
+	uint32_t state = 0;
+	std::vector<glm::vec2> positions(_numObjects);
+	Tree tree(1.f);
+	for (uint32_t i = 0; i < _numObjects; ++i)
+	{
+		positions[i] = glm::vec2(random01(state), random01(state)) * 200.f;
+		tree.insert(objectBox(positions[i]), i);
+	}
+	reportTree("SparseOctree initial", tree, positions);
+
+	const glm::vec2 drift(2.f, 1.f);
+	report("SparseOctree move (remove + insert)", _numObjects, measure([&]()
+		{
+			for (uint32_t round = 0; round < _numRounds; ++round)
+				for (uint32_t i = 0; i < _numObjects; ++i)
+				{
+					tree.remove(objectBox(positions[i]), i);
+					positions[i] = positions[i] + drift + (glm::vec2(random01(state), random01(state)) - glm::vec2(0.5f)) * 4.f;
+					tree.insert(objectBox(positions[i]), i);
+				}
+		}, static_cast<size_t>(_numObjects) * _numRounds));
+	reportTree("SparseOctree after moves", tree, positions);
+
+	report("SparseOctree compact", _numObjects, measure([&]() { tree.compact(); }, _numObjects));
+	reportTree("SparseOctree after compact", tree, positions);
+}
+
+int main()
+{
+	for (uint32_t n : {10000u, 100000u})
+	{
+		benchMoves(n, 200);
+		std::cout << std::endl;
+	}
+	return 0;
+}
@@ -0,0 +1,84 @@
+#include "benchutils.hpp"
+
+#include <engine/game/core/registry.hpp>
+#include <string>
+
+struct Position { float x, y, z; };
+struct Velocity { float x, y, z; };
+struct Health { int value; };
+struct Tag { int group; };
+
+// All entities have all components, each execute touches every entity.
+void benchDense(uint32_t _numEntities)
+{
+	Registry registry;
+	auto positions = registry.getComponents<Position>();
+	auto velocities = registry.getComponents<Velocity>();
+	auto healths = registry.getComponents<Health>();
+	auto tags = registry.getComponents<Tag>();
+	for (uint32_t i = 0; i < _numEntities; ++i)
+	{
+		const Entity ent = registry.create();
+		positions.insert(ent, Position{ 0.f, 0.f, 0.f });
+		velocities.insert(ent, Velocity{ 1.f, 0.f, 0.f });
+		healths.insert(ent, Health{ 100 });
+		tags.insert(ent, Tag{ static_cast<int>(i % 8) });
+	}
+
+	report("execute 1 component", _numEntities, measure([&]()
+		{
+			registry.execute([](Position& _pos) { _pos.x += 1.f; });
+		}, _numEntities));
+	report("execute 2 components", _numEntities, measure([&]()
+		{
+			registry.execute([](Position& _pos, const Velocity& _vel) { _pos.x += _vel.x; });
+		}, _numEntities));
+	report("execute 3 components", _numEntities, measure([&]()
+		{
+			registry.execute([](Position& _pos, const Velocity& _vel, Health& _health) { _pos.x += _vel.x; _health.value -= 1; });
+		}, _numEntities));
+	report("execute 4 components", _numEntities, measure([&]()
+		{
+			registry.execute([](Position& _pos, const Velocity& _vel, Health& _health, const Tag& _tag)
+				{
+					_pos.x += _vel.x;
+					_health.value -= _tag.group;
+				});
+		}, _numEntities));
+	uint64_t sum = 0;
+	registry.execute([&](const Health& _health) { sum += _health.value; });
+	consume(sum);
+}
+
+// Only 1% of the entities have a Tag. Driving the iteration with the smallest pool
+// only visits these, no matter where Tag appears in the signature.
+void benchSparse(uint32_t _numEntities)
+{
+	Registry registry;
+	auto positions = registry.getComponents<Position>();
+	auto tags = registry.getComponents<Tag>();
+	for (uint32_t i = 0; i < _numEntities; ++i)
+	{
+		const Entity ent = registry.create();
+		positions.insert(ent, Position{ 0.f, 0.f, 0.f });
+		if (scramble(i) % 100 == 0)
+			tags.insert(ent, Tag{ 1 });
+	}
+
+	report("execute 2 components, 1% match", _numEntities, measure([&]()
+		{
+			registry.execute([](Position& _pos, const Tag& _tag) { _pos.y += static_cast<float>(_tag.group); });
+		}, _numEntities));
+}
+
+int main()
+{
+	for (uint32_t n : {10000u, 1000000u})
+	{
+		benchDense(n);
+		benchSparse(n);
+		std::cout << std::endl;
+	}
+
+	return 0;
+}
@@ -0,0 +1,89 @@
+#include "benchutils.hpp"
+
+#include <engine/utils/resourcemanager.hpp>
+#include <engine/utils/containers/hashmap.hpp>
+#include <string>
+#include <vector>
+#include <new>
+#include <cstdlib>
+
+// Count all heap allocations to verify that cached lookups do not allocate.
+static size_t numAllocations = 0;
+
+void* operator new(std::size_t _size)
+{
+	++numAllocations;
+	if (void* ptr = std::malloc(_size))
+		return ptr;
+	throw std::bad_alloc();
+}
+void operator delete(void* _ptr) noexcept { std::free(_ptr); }
+
+struct DummyLoader
+{
+	using Handle = int;
+	static Handle load(const char* _name) { return static_cast<int>(std::string_view(_name).size()); }
+	static void unload(Handle) {}
+};
+
+using DummyManager = utils::ResourceManager<DummyLoader>;
+
+// The lookup as done before: concatenate the path and hash the full string.
+struct LegacyHash
+{
+	uint32_t operator () (const std::string& _string) const
+	{
+		uint32_t hashvalue = 208357;
+		const char* string = _string.c_str();
+		while (int c = *string++)
+			hashvalue = ((hashvalue << 5) + (hashvalue << 1) + hashvalue) ^ c;
+		return hashvalue;
+	}
+};
+
+int main()
+{
+	using namespace std::string_literals;
+
+	// Names which exceed the small string optimization as typical for resource paths.
+	std::vector<std::string> names;
+	for (int i = 0; i < 64; ++i)
+		names.push_back("textures/environment/tile_" + std::to_string(i) + ".png");
+
+	constexpr size_t NUM_QUERIES = 1000000;
+
+	utils::HashMap<std::string, int, LegacyHash> legacyMap;
+	for (const std::string& name : names)
+		legacyMap.add("../resources/"s + name, 0);
+
+	size_t allocsBefore = numAllocations;
+	const double tLegacy = measure([&]()
+		{
+			uint64_t sum = 0;
+			for (size_t i = 0; i < NUM_QUERIES; ++i)
+			{
+				const std::string name("../resources/"s + names[i % names.size()].c_str());
+				sum += legacyMap.find(name).data();
+			}
+			consume(sum);
+		}, NUM_QUERIES);
+	report("string concat + find (previous get)", names.size(), tLegacy);
+	std::cout << "  allocations per lookup: " << static_cast<double>(numAllocations - allocsBefore) / NUM_QUERIES << std::endl;
+
+	for (const std::string& name : names)
+		DummyManager::get(name.c_str());
+
+	allocsBefore = numAllocations;
+	const double tGet = measure([&]()
+		{
+			uint64_t sum = 0;
+			for (size_t i = 0; i < NUM_QUERIES; ++i)
+				sum += DummyManager::get(names[i % names.size()].c_str());
+			consume(sum);
+		}, NUM_QUERIES);
+	report("ResourceManager::get (cached hit)", names.size(), tGet);
+	std::cout << "  allocations per lookup: " << static_cast<double>(numAllocations - allocsBefore) / NUM_QUERIES << std::endl;
+
+	DummyManager::clear();
+	return 0;
+}
@@ -0,0 +1,563 @@
+#include "benchutils.hpp"
+
+#include <engine/utils/containers/slotmap.hpp>
+#include <engine/utils/containers/slotindex.hpp>
+#include <engine/utils/containers/flatmultislotmap.hpp>
+#include <engine/utils/containers/weakslotmap.hpp>
+#include <engine/utils/containers/deferredcommands.hpp>
+#include <engine/utils/containers/keyintersection.hpp>
+#include <engine/utils/containers/slotmapgroup.hpp>
+#include <vector>
+#include <algorithm>
+#include <optional>
+
+// Sparse component maps: few entities with ids spread over a large range.
+template<typename Index>
+void benchSlotIndex(const std::string& _name, uint32_t _numKeys, uint32_t _maxKey)
+{
+	std::vector<uint32_t> keys;
+	for (uint32_t i = 0; i < _numKeys; ++i)
+		keys.push_back(scramble(i) % _maxKey);
+
+	Index index;
+	for (uint32_t i = 0; i < _numKeys; ++i)
+		index.set(keys[i], i);
+	report(_name + " memory", _numKeys, index.memoryUsage() / 1024.0, "KiB");
+
+	utils::SlotMap<uint32_t, uint32_t, Index> slotMap;
+	for (uint32_t i = 0; i < _numKeys; ++i)
+		slotMap.emplace(keys[i], i);
+
+	constexpr uint32_t NUM_QUERIES = 1000000;
+	const double tAccess = measure([&]()
+		{
+			uint64_t sum = 0;
+			for (uint32_t i = 0; i < NUM_QUERIES; ++i)
+			{
+				const uint32_t key = keys[(i * 7919u) % _numKeys];
+				if (slotMap.contains(key))
+					sum += slotMap[key];
+			}
+			consume(sum);
+		}, NUM_QUERIES);
+	report(_name + " contains + operator[]", _numKeys, tAccess);
+}
+
+struct Transform { float position[3]; float rotation[4]; };
+struct Velocity { float linear[3]; float angular[3]; };
+
+// Iterate one component map and access a second one with the same keys,
+// once in the random order after many erases and once after sort().
+void benchJointIteration(uint32_t _numKeys)
+{
+	utils::SlotMap<uint32_t, Transform> transforms;
+	utils::SlotMap<uint32_t, Velocity> velocities;
+	for (uint32_t i = 0; i < _numKeys; ++i)
+	{
+		transforms.emplace(i, Transform{});
+		velocities.emplace(i, Velocity{ {1.f, 0.f, 0.f}, {} });
+	}
+	// churn to break up the key order
+	for (uint32_t i = 0; i < _numKeys; i += 2)
+	{
+		const uint32_t key = scramble(i) % _numKeys;
+		if (transforms.contains(key)) transforms.erase(key);
+		if (velocities.contains(key)) velocities.erase(key);
+	}
+	for (uint32_t i = 0; i < _numKeys; i += 2)
+	{
+		const uint32_t key = scramble(i) % _numKeys;
+		transforms.emplace(key, Transform{});
+		velocities.emplace(key, Velocity{ {1.f, 0.f, 0.f}, {} });
+	}
+
+	auto update = [&]()
+		{
+			for (auto it = transforms.begin(); it != transforms.end(); ++it)
+			{
+				const Velocity& velocity = velocities[it.key()];
+				for (int j = 0; j < 3; ++j)
+					(*it).position[j] += velocity.linear[j];
+			}
+			consume(static_cast<uint64_t>(transforms.begin().value().position[0]));
+		};
+	report("joint iteration (unsorted)", _numKeys, measure(update, _numKeys));
+
+	const double tSort = measure([&]()
+		{
+			transforms.sort();
+			velocities.sort();
+		}, _numKeys);
+	report("sort() both maps", _numKeys, tSort);
+	report("joint iteration (sorted)", _numKeys, measure(update, _numKeys));
+}
+
+// Transforms for all keys and velocities for a random half of them, filled in
+// random order. The join iterates the velocities and looks up each transform,
+// or scans the packed front of both maps in a SlotMapGroup.
+void benchGroup(uint32_t _numKeys)
+{
+	utils::SlotMap<uint32_t, Transform> transforms;
+	utils::SlotMap<uint32_t, Velocity> velocities;
+	for (uint32_t i = 0; i < _numKeys; ++i)
+	{
+		const uint32_t key = static_cast<uint32_t>(uint64_t(i) * 7919u % _numKeys);
+		transforms.emplace(key, Transform{});
+		if (key % 2) velocities.emplace(key, Velocity{ {1.f, 0.f, 0.f}, {} });
+	}
+
+	auto integrate = [](Transform& _transform, const Velocity& _velocity)
+		{
+			for (int j = 0; j < 3; ++j)
+				_transform.position[j] += _velocity.linear[j];
+		};
+	report("join with lookups", velocities.size(), measure([&]()
+		{
+			for (auto it = velocities.begin(); it != velocities.end(); ++it)
+				integrate(transforms[it.key()], *it);
+		}, velocities.size()));
+
+	// maintenance: move 10% of the keys out of the group and back in
+	const uint32_t numChanges = _numKeys / 10;
+	report("erase + emplace direct", numChanges, measure([&]()
+		{
+			for (uint32_t i = 1; i < 2 * numChanges; i += 2)
+				velocities.erase(i);
+			for (uint32_t i = 1; i < 2 * numChanges; i += 2)
+				velocities.emplace(i, Velocity{});
+		}, numChanges));
+
+	std::optional<utils::SlotMapGroup<decltype(transforms), decltype(velocities)>> group;
+	report("build group", velocities.size(), measure([&]() { group.emplace(transforms, velocities); }, velocities.size()));
+	report("join group", group->size(), measure([&]()
+		{
+			group->forEach<Transform, const Velocity>([&](uint32_t, Transform& _transform, const Velocity& _velocity)
+				{
+					integrate(_transform, _velocity);
+				});
+		}, group->size()));
+
+	report("erase + emplace through group", numChanges, measure([&]()
+		{
+			for (uint32_t i = 1; i < 2 * numChanges; i += 2)
+				group->erase<1>(i);
+			for (uint32_t i = 1; i < 2 * numChanges; i += 2)
+				group->emplace<1, Velocity>(i, Velocity{});
+		}, numChanges));
+	consume(static_cast<uint64_t>(transforms.begin().value().position[0]));
+}
+
+// Keys contained in three maps: all keys, a random half and a random 1%.
+// contains() lookups from the largest or the smallest map compared to ANDing
+// the presence bitmaps. Times are for one complete query.
+void benchIntersection(uint32_t _numKeys)
+{
+	using PresenceIndex = utils::PresenceSlotIndex<uint32_t>;
+	utils::SlotMap<uint32_t, Transform, PresenceIndex> transforms;
+	utils::SlotMap<uint32_t, Velocity, PresenceIndex> velocities;
+	utils::SlotMap<uint32_t, int, PresenceIndex> tags;
+	for (uint32_t i = 0; i < _numKeys; ++i)
+	{
+		transforms.emplace(i, Transform{});
+		if (scramble(i) % 2) velocities.emplace(i, Velocity{});
+		if (scramble(i) % 100 == 1) tags.emplace(i, 1);
+	}
+
+	uint64_t expected = 0;
+	const double tLargest = measure([&]()
+		{
+			for (auto it = transforms.begin(); it != transforms.end(); ++it)
+				if (velocities.contains(it.key()) && tags.contains(it.key())) expected += it.key();
+		});
+	report("largest map + contains()", _numKeys, tLargest / 1000.0, "us");
+
+	uint64_t sum = 0;
+	const double tSmallest = measure([&]()
+		{
+			for (auto it = tags.begin(); it != tags.end(); ++it)
+				if (transforms.contains(it.key()) && velocities.contains(it.key())) sum += it.key();
+		});
+	report("smallest map + contains()", _numKeys, tSmallest / 1000.0, "us");
+
+	const double tBitmap = measure([&]()
+		{
+			utils::commonKeys(transforms, velocities, tags).forEach([&](uint32_t _key) { sum += _key; });
+		});
+	report("presence bitmap intersection", _numKeys, tBitmap / 1000.0, "us");
+
+	const double tIterator = measure([&]()
+		{
+			for (uint32_t key : utils::commonKeys(transforms, velocities, tags))
+				sum += key;
+		});
+	report("presence bitmap intersection (iterator)", _numKeys, tIterator / 1000.0, "us");
+	consume(sum == expected * 3 ? sum : 0);
+}
+
+// Spawning a wave of _numSpawned entities into maps which already hold as many:
+// one emplace() per element vs. emplaceRange() from prepared arrays vs. emplaceN().
+void benchSpawn(uint32_t _numSpawned)
+{
+	std::vector<uint32_t> keys(_numSpawned);
+	std::vector<Transform> values(_numSpawned);
+	for (uint32_t i = 0; i < _numSpawned; ++i)
+	{
+		keys[i] = _numSpawned + i;
+		values[i].position[0] = static_cast<float>(i);
+	}
+	auto generate = [](uint32_t _key) { Transform t{}; t.position[0] = static_cast<float>(_key); return t; };
+
+	auto prepareSlotMap = [&]()
+	{
+		utils::SlotMap<uint32_t, Transform> map;
+		for (uint32_t i = 0; i < _numSpawned; ++i)
+			map.emplace(i, values[i]);
+		return map;
+	};
+	auto spawnSlotMap = [&](const std::string& _case, auto&& _spawn)
+	{
+		auto map = prepareSlotMap();
+		report("SlotMap spawn " + _case, _numSpawned, measure([&]() { _spawn(map); }, _numSpawned));
+		consume(map.size());
+	};
+	spawnSlotMap("emplace", [&](auto& _map)
+		{
+			for (uint32_t i = 0; i < _numSpawned; ++i)
+				_map.emplace(keys[i], values[i]);
+		});
+	spawnSlotMap("emplaceRange", [&](auto& _map) { _map.emplaceRange(keys, values); });
+	spawnSlotMap("emplaceN", [&](auto& _map) { _map.emplaceN(_numSpawned, _numSpawned, generate); });
+
+	using WeakMap = utils::WeakSlotMap<uint32_t, true>;
+	auto spawnWeakSlotMap = [&](const std::string& _case, auto&& _spawn)
+	{
+		WeakMap map(utils::TypeHolder<Transform>{});
+		for (uint32_t i = 0; i < _numSpawned; ++i)
+			map.emplace<Transform>(i, values[i]);
+		report("WeakSlotMap spawn " + _case, _numSpawned, measure([&]() { _spawn(map); }, _numSpawned));
+		consume(map.size());
+	};
+	spawnWeakSlotMap("emplace", [&](WeakMap& _map)
+		{
+			for (uint32_t i = 0; i < _numSpawned; ++i)
+				_map.emplace<Transform>(keys[i], values[i]);
+		});
+	spawnWeakSlotMap("emplaceRange", [&](WeakMap& _map) { _map.emplaceRange<Transform>(keys, values); });
+	spawnWeakSlotMap("emplaceN", [&](WeakMap& _map) { _map.emplaceN<Transform>(_numSpawned, _numSpawned, generate); });
+}
+
+// Latency of single emplace() calls. Contiguous storage has spikes whenever
+// the whole array is relocated, chunked storage only allocates a new block.
+template<typename Storage>
+void benchEmplaceLatency(const std::string& _name, uint32_t _numKeys)
+{
+	utils::WeakSlotMap<uint32_t, true, utils::DenseSlotIndex<uint32_t>, Storage> map(utils::TypeHolder<Transform>{});
+	std::vector<double> times(_numKeys);
+	const double tTotal = measure([&]()
+		{
+			for (uint32_t i = 0; i < _numKeys; ++i)
+				times[i] = measure([&]() { map.template emplace<Transform>(i, Transform{}); });
+		}, _numKeys);
+	std::sort(times.begin(), times.end());
+	report(_name + " emplace", _numKeys, tTotal);
+	report(_name + " emplace p99", _numKeys, times[_numKeys / 100 * 99]);
+	report(_name + " emplace max", _numKeys, times.back());
+
+	const double tIterate = measure([&]()
+		{
+			float sum = 0.f;
+			for (const auto& [key, transform] : map.template iterate<Transform>())
+				sum += transform.position[0];
+			consume(static_cast<uint64_t>(sum));
+		}, _numKeys);
+	report(_name + " iteration", _numKeys, tIterate);
+}
+
+// Same data as Transform, but the user defined move makes it non trivially copyable.
+struct ManagedTransform
+{
+	ManagedTransform() = default;
+	ManagedTransform(ManagedTransform&& _oth) noexcept : data(_oth.data) {}
+	ManagedTransform& operator=(ManagedTransform&& _oth) noexcept { data = _oth.data; return *this; }
+	Transform data;
+};
+
+// Growth and swap-remove throughput with the memcpy path vs. the type erased moves.
+template<typename Value>
+void benchEraseGrow(const std::string& _name, uint32_t _numKeys)
+{
+	utils::WeakSlotMap<uint32_t, false> map(utils::TypeHolder<Value>{});
+	const double tGrow = measure([&]()
+		{
+			for (uint32_t i = 0; i < _numKeys; ++i)
+				map.template emplace<Value>(i);
+		}, _numKeys);
+	report(_name + " emplace with growth", _numKeys, tGrow);
+
+	const double tErase = measure([&]()
+		{
+			for (uint32_t i = 0; i < _numKeys; ++i)
+				map.erase(static_cast<uint32_t>(uint64_t(i) * 7919u % _numKeys));
+		}, _numKeys);
+	report(_name + " erase", _numKeys, tErase);
+}
+
+// Per frame component update, serial loop vs. parallelForEach on the global pool.
+void benchParallelUpdate(uint32_t _numKeys)
+{
+	utils::SlotMap<uint32_t, Transform> transforms;
+	for (uint32_t i = 0; i < _numKeys; ++i)
+		transforms.emplace(i, Transform{ {0.f, 0.f, 0.f}, {0.f, 0.f, 0.f, 1.f} });
+
+	auto update = [](uint32_t, Transform& _transform)
+		{
+			for (int j = 0; j < 3; ++j)
+				_transform.position[j] = _transform.position[j] * 0.99f + _transform.rotation[j] * 0.5f + 0.01f;
+		};
+	const double tSerial = measure([&]()
+		{
+			for (auto it = transforms.begin(); it != transforms.end(); ++it)
+				update(it.key(), it.value());
+		}, _numKeys);
+	report("SlotMap update serial", _numKeys, tSerial);
+
+	const double tParallel = measure([&]() { transforms.parallelForEach(update); }, _numKeys);
+	report("SlotMap update parallelForEach (" + std::to_string(utils::ThreadPool::global().numThreads()) + " threads)",
+		_numKeys, tParallel);
+
+	const double tReduce = measure([&]()
+		{
+			const double sum = transforms.parallelReduce(0.0,
+				[](double& _acc, uint32_t, const Transform& _transform) { _acc += _transform.position[0]; },
+				[](double _a, double _b) { return _a + _b; });
+			consume(static_cast<uint64_t>(sum));
+		}, _numKeys);
+	report("SlotMap parallelReduce", _numKeys, tReduce);
+}
+
+// Process only the changed components, e.g. to upload them to the GPU,
+// compared to a pass over all elements.
+void benchDirtyTracking(uint32_t _numKeys)
+{
+	utils::SlotMap<uint32_t, Transform, utils::DenseSlotIndex<uint32_t>, true> transforms;
+	for (uint32_t i = 0; i < _numKeys; ++i)
+		transforms.emplace(i, Transform{});
+	transforms.clearDirty();
+	// 1% of the elements change per frame
+	for (uint32_t i = 0; i < _numKeys / 100; ++i)
+		transforms[scramble(i) % _numKeys].position[0] += 1.f;
+
+	std::vector<Transform> uploadBuffer;
+	auto fullPass = [&]()
+		{
+			uploadBuffer.clear();
+			for (auto it = transforms.begin(); it != transforms.end(); ++it)
+				uploadBuffer.push_back(*it);
+			consume(uploadBuffer.size());
+		};
+	fullPass(); // warm up the buffer
+	const double tFull = measure(fullPass);
+	report("full upload pass", _numKeys, tFull / 1000.0, "us/frame");
+
+	const double tDirty = measure([&]()
+		{
+			uploadBuffer.clear();
+			transforms.forEachDirty([&](uint32_t, Transform& _transform) { uploadBuffer.push_back(_transform); });
+			consume(uploadBuffer.size());
+		});
+	report("dirty only upload pass (" + std::to_string(transforms.numDirty()) + " dirty)", _numKeys, tDirty / 1000.0, "us/frame");
+	report("clearDirty()", _numKeys, measure([&]() { transforms.clearDirty(); }) / 1000.0, "us/frame");
+}
+
+// Structural changes collected during an update: 10% of the elements die and the
+// same number is spawned per frame. Individual calls in discovery order vs. one
+// batched apply(). The first frame is not measured so that all buffers have grown.
+void benchDeferredCommands(uint32_t _numKeys)
+{
+	constexpr int NUM_FRAMES = 5;
+	// Precompute the keys which die and spawn in each frame. Like entity ids in the
+	// Registry, keys of dead elements are recycled in the next frame.
+	std::vector<uint32_t> live(_numKeys);
+	for (uint32_t i = 0; i < _numKeys; ++i)
+		live[i] = i;
+	std::vector<uint32_t> freeKeys;
+	uint32_t nextKey = _numKeys;
+	std::vector<std::vector<uint32_t>> dying(NUM_FRAMES);
+	std::vector<std::vector<uint32_t>> spawning(NUM_FRAMES);
+	for (int frame = 0; frame < NUM_FRAMES; ++frame)
+	{
+		std::vector<uint32_t> freed;
+		std::vector<bool> picked(_numKeys, false);
+		for (uint32_t i = 0; i < _numKeys / 10; ++i)
+		{
+			const uint32_t slot = scramble(i + frame * _numKeys) % _numKeys;
+			if (picked[slot]) continue;
+			picked[slot] = true;
+			uint32_t& key = live[slot];
+			dying[frame].push_back(key);
+			freed.push_back(key);
+			if (freeKeys.empty()) key = nextKey++;
+			else
+			{
+				key = freeKeys.back();
+				freeKeys.pop_back();
+			}
+			spawning[frame].push_back(key);
+		}
+		freeKeys.insert(freeKeys.end(), freed.begin(), freed.end());
+	}
+
+	auto run = [&](auto&& _frame)
+		{
+			utils::SlotMap<uint32_t, Transform> map;
+			for (uint32_t i = 0; i < _numKeys; ++i)
+				map.emplace(i, Transform{});
+			_frame(map, 0);
+			const double t = measure([&]()
+				{
+					for (int frame = 1; frame < NUM_FRAMES; ++frame)
+						_frame(map, frame);
+				}, (NUM_FRAMES - 1) * dying[0].size());
+			consume(map.size());
+			return t;
+		};
+
+	const double tDirect = run([&](utils::SlotMap<uint32_t, Transform>& _map, int _frame)
+		{
+			std::vector<uint32_t> erases;
+			std::vector<uint32_t> spawns;
+			for (size_t i = 0; i < dying[_frame].size(); ++i)
+			{
+				erases.push_back(dying[_frame][i]);
+				spawns.push_back(spawning[_frame][i]);
+			}
+			for (uint32_t key : erases)
+				if (_map.contains(key)) _map.erase(key);
+			for (uint32_t key : spawns)
+				_map.emplace(key, Transform{});
+		});
+	report("individual erase + emplace", _numKeys, tDirect);
+
+	utils::DeferredCommands<uint32_t, Transform> commands;
+	const double tDeferred = run([&](utils::SlotMap<uint32_t, Transform>& _map, int _frame)
+		{
+			for (size_t i = 0; i < dying[_frame].size(); ++i)
+			{
+				commands.erase(dying[_frame][i]);
+				commands.emplace(spawning[_frame][i], Transform{});
+			}
+			commands.apply(_map);
+		});
+	report("DeferredCommands record + apply", _numKeys, tDeferred);
+}
+
+struct Collider { float center[3]; float radius; };
+
+// Many values per key, added in interleaved order as it happens when entities
+// get their components over multiple frames.
+template<typename MultiMap>
+void benchMultiValues(const std::string& _name, uint32_t _numKeys)
+{
+	constexpr uint32_t PER_KEY = 4;
+	MultiMap map;
+	for (uint32_t round = 0; round < PER_KEY; ++round)
+		for (uint32_t i = 0; i < _numKeys; ++i)
+			map.emplace(static_cast<uint32_t>(uint64_t(i) * 7919u % _numKeys), Collider{ {0.f, 0.f, 0.f}, static_cast<float>(round) });
+
+	auto iterate = [&]()
+		{
+			uint64_t hits = 0;
+			for (uint32_t key = 0; key < _numKeys; ++key)
+				map.forEach(key, [&](const Collider& _collider) { hits += _collider.radius > 2.f; });
+			consume(hits);
+		};
+	report(_name + " per key iteration", _numKeys, measure(iterate, _numKeys));
+	if constexpr (requires { map.compact(); })
+	{
+		report(_name + " compact()", _numKeys, measure([&]() { map.compact(); }, _numKeys));
+		report(_name + " per key iteration (compacted)", _numKeys, measure(iterate, _numKeys));
+	}
+
+	const double tErase = measure([&]()
+		{
+			for (uint32_t key = 0; key < _numKeys; key += 2)
+				map.erase(key);
+		}, _numKeys / 2);
+	report(_name + " erase(key)", _numKeys, tErase);
+}
+
+int main()
+{
+	for (uint32_t n : {10000u, 1000000u})
+	{
+		benchGroup(n);
+		std::cout << std::endl;
+	}
+
+	for (uint32_t n : {10000u, 100000u})
+	{
+		benchSpawn(n);
+		std::cout << std::endl;
+	}
+
+	for (uint32_t n : {10000u, 1000000u})
+	{
+		benchIntersection(n);
+		std::cout << std::endl;
+	}
+
+	for (uint32_t n : {10000u, 1000000u})
+	{
+		benchDeferredCommands(n);
+		std::cout << std::endl;
+	}
+
+	for (uint32_t n : {10000u, 1000000u})
+	{
+		benchDirtyTracking(n);
+		std::cout << std::endl;
+	}
+
+	for (uint32_t n : {10000u, 500000u})
+	{
+		benchParallelUpdate(n);
+		std::cout << std::endl;
+	}
+
+	for (uint32_t n : {10000u, 1000000u})
+	{
+		benchEraseGrow<Transform>("WeakSlotMap trivially copyable", n);
+		benchEraseGrow<ManagedTransform>("WeakSlotMap type erased move", n);
+		std::cout << std::endl;
+	}
+
+	for (uint32_t n : {10000u, 1000000u})
+	{
+		benchEmplaceLatency<utils::ContiguousStorage>("WeakSlotMap contiguous", n);
+		benchEmplaceLatency<utils::ChunkedStorage<>>("WeakSlotMap chunked", n);
+		std::cout << std::endl;
+	}
+
+	for (uint32_t n : {10000u, 1000000u})
+	{
+		benchMultiValues<utils::MultiSlotMap<uint32_t, Collider>>("MultiSlotMap (linked)", n);
+		benchMultiValues<utils::FlatMultiSlotMap<uint32_t, Collider>>("FlatMultiSlotMap (contiguous)", n);
+		std::cout << std::endl;
+	}
+
+	for (uint32_t n : {10000u, 1000000u})
+	{
+		benchJointIteration(n);
+		std::cout << std::endl;
+	}
+
+	for (uint32_t maxKey : {100000u, 50000000u})
+	{
+		std::cout << "keys in [0, " << maxKey << ")" << std::endl;
+		benchSlotIndex<utils::DenseSlotIndex<uint32_t>>("DenseSlotIndex", 10000, maxKey);
+		benchSlotIndex<utils::PagedSlotIndex<uint32_t>>("PagedSlotIndex", 10000, maxKey);
+		std::cout << std::endl;
+	}
+
+	return 0;
+}
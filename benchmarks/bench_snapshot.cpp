@@ -0,0 +1,99 @@
+#include "benchutils.hpp"
+
+#include <engine/utils/containers/slotmap.hpp>
+#include <engine/utils/containers/weakslotmap.hpp>
+#include <engine/utils/containers/hashmap.hpp>
+#include <engine/utils/mappedfile.hpp>
+#include <fstream>
+#include <vector>
+#include <cstdio>
+
+struct Transform
+{
+	float position[3];
+	float rotation[4];
+	float scale;
+};
+
+struct Velocity
+{
+	float linear[3];
+	float angular[3];
+};
+
+// A scene with one transform and velocity per entity and a lookup from
+// persistent ids to entities.
+struct World
+{
+	utils::SlotMap<uint32_t, Transform> transforms;
+	utils::WeakSlotMap<uint32_t, true> velocities{ utils::TypeHolder<Velocity>{} };
+	utils::HashMap<uint32_t, uint32_t> persistentIds;
+
+	uint64_t checksum() const
+	{
+		return transforms.size() + velocities.size() + persistentIds.size()
+			+ static_cast<uint64_t>(transforms[7].scale) + persistentIds.find(scramble(7)).data();
+	}
+};
+
+// Loading a scene of _numEntities: adding every element again compared to
+// restoring a snapshot from a memory mapped file.
+void benchRestore(uint32_t _numEntities)
+{
+	const char* fileName = "bench_snapshot.bin";
+
+	const double tInsert = measure([&]()
+		{
+			World world;
+			for (uint32_t i = 0; i < _numEntities; ++i)
+			{
+				const float f = static_cast<float>(i);
+				world.transforms.emplace(i, Transform{ { f, f, f }, { 0.f, 0.f, 0.f, 1.f }, 1.f });
+				world.velocities.emplace<Velocity>(i, Velocity{ { f, 0.f, 0.f }, { 0.f, 0.f, 0.f } });
+				world.persistentIds.add(scramble(i), i);
+			}
+			consume(world.checksum());
+		});
+	report("insert element by element", _numEntities, tInsert / 1.0e6, "ms");
+
+	{
+		World world;
+		for (uint32_t i = 0; i < _numEntities; ++i)
+		{
+			const float f = static_cast<float>(i);
+			world.transforms.emplace(i, Transform{ { f, f, f }, { 0.f, 0.f, 0.f, 1.f }, 1.f });
+			world.velocities.emplace<Velocity>(i, Velocity{ { f, 0.f, 0.f }, { 0.f, 0.f, 0.f } });
+			world.persistentIds.add(scramble(i), i);
+		}
+		const double tWrite = measure([&]()
+			{
+				std::ofstream file(fileName, std::ios::binary);
+				utils::BinaryWriter writer(file);
+				world.transforms.snapshot(writer);
+				world.velocities.snapshot<Velocity>(writer);
+				world.persistentIds.snapshot(writer);
+			});
+		report("write snapshot", _numEntities, tWrite / 1.0e6, "ms");
+	}
+
+	const double tRestore = measure([&]()
+		{
+			const utils::MappedFile file(fileName);
+			utils::BinaryReader reader(std::span<const char>(file.data(), file.size()));
+			World world;
+			const bool success = world.transforms.restore(reader)
+				&& world.velocities.restore<Velocity>(reader)
+				&& world.persistentIds.restore(reader);
+			consume(success ? world.checksum() : 0);
+		});
+	report("restore snapshot (mapped file)", _numEntities, tRestore / 1.0e6, "ms");
+
+	std::remove(fileName);
+}
+
+int main()
+{
+	benchRestore(10000);
+	benchRestore(1000000);
+	return 0;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <cstdint>
+
+// Accumulates results of benchmarked code so that the compiler cannot remove it.
+static volatile uint64_t benchSink = 0;
+
+inline void consume(uint64_t _value) { benchSink = benchSink + _value; }
+
+// Run _func once and return the elapsed time in nanoseconds per operation.
+template<typename Func>
+double measure(Func&& _func, size_t _numOps = 1)
+{
+	const auto begin = std::chrono::high_resolution_clock::now();
+	_func();
+	const auto end = std::chrono::high_resolution_clock::now();
+	return std::chrono::duration<double, std::nano>(end - begin).count() / static_cast<double>(_numOps);
+}
+
+// Print a single result line in a fixed table format.
+inline void report(const std::string& _case, size_t _numElements, double _value, const char* _unit = "ns/op")
+{
+	std::cout << std::left << std::setw(48) << _case
+		<< std::right << std::setw(10) << _numElements
+		<< std::setw(14) << std::fixed << std::setprecision(2) << _value << " " << _unit
+		<< std::endl;
+}
+
+// Deterministic bijective scrambling of integers to create unique pseudo random keys.
+inline uint32_t scramble(uint32_t _x)
+{
+	_x ^= _x >> 16;
+	_x *= 0x7feb352du;
+	_x ^= _x >> 15;
+	_x *= 0x846ca68bu;
+	_x ^= _x >> 16;
+	return _x;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+
+// Handle of an object in the Registry. The id of an Entity is reused after it was
+// erased, use an EntityRef to check whether the object still exists.
+class Entity
+{
+public:
+	using IdType = uint32_t;
+	constexpr static IdType INVALID_ID = std::numeric_limits<IdType>::max();
+
+	constexpr Entity() : m_id(INVALID_ID) {}
+	explicit constexpr Entity(IdType _id) : m_id(_id) {}
+
+	constexpr IdType toIndex() const { return m_id; }
+
+	constexpr bool operator==(const Entity& _oth) const { return m_id == _oth.m_id; }
+	constexpr bool operator!=(const Entity& _oth) const { return m_id != _oth.m_id; }
+private:
+	IdType m_id;
+};
+
+// Persistent reference to an Entity which becomes invalid once the Entity is erased,
+// even if its id is reused afterwards. See Registry::getEntity().
+struct EntityRef
+{
+	Entity entity;
+	uint32_t generation = 0;
+};
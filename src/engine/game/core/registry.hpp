@@ -0,0 +1,210 @@
+#pragma once
+
+#include "entity.hpp"
+#include "../../utils/assert.hpp"
+#include "../../utils/typeindex.hpp"
+#include "../../utils/metaproghelpers.hpp"
+#include "../../utils/containers/weakslotmap.hpp"
+#include <vector>
+#include <array>
+#include <memory>
+#include <optional>
+#include <tuple>
+#include <utility>
+#include <type_traits>
+#include <limits>
+
+// One dense pool per component type, indexed by the entity id.
+using ComponentStorage = utils::WeakSlotMap<Entity::IdType>;
+
+// Typed access to the components of a single type.
+// Only valid as long as the Registry exists.
+template<typename Component>
+class ComponentAccess
+{
+public:
+	ComponentAccess(ComponentStorage& _storage) : m_storage(&_storage) {}
+
+	// Add a component to _ent. If it already has one, the existing component is returned.
+	template<typename... Args>
+	Component& insert(Entity _ent, Args&&... _args)
+	{
+		return m_storage->template emplace<Component>(_ent.toIndex(), std::forward<Args>(_args)...);
+	}
+
+	void erase(Entity _ent) { m_storage->erase(_ent.toIndex()); }
+
+	bool has(Entity _ent) const { return m_storage->contains(_ent.toIndex()); }
+
+	// Returns nullptr if _ent has no component of this type.
+	Component* at(Entity _ent)
+	{
+		return has(_ent) ? &m_storage->template at<Component>(_ent.toIndex()) : nullptr;
+	}
+	const Component* at(Entity _ent) const
+	{
+		return has(_ent) ? &m_storage->template at<Component>(_ent.toIndex()) : nullptr;
+	}
+
+	size_t size() const { return m_storage->size(); }
+private:
+	ComponentStorage* m_storage;
+};
+
+// Entity component system with one dense pool per component type.
+// \details Entity ids are recycled; each id has a generation which is increased on
+//		erase to detect stale EntityRefs.
+class Registry
+{
+public:
+	Entity create()
+	{
+		if (!m_unusedEntities.empty())
+		{
+			const Entity ent = m_unusedEntities.back();
+			m_unusedEntities.pop_back();
+			m_alive[ent.toIndex()] = true;
+			return ent;
+		}
+
+		m_generations.push_back(0);
+		m_alive.push_back(true);
+		return Entity(static_cast<Entity::IdType>(m_generations.size() - 1));
+	}
+
+	// Destroy _ent and all its components.
+	void erase(Entity _ent)
+	{
+		ASSERT(isAlive(_ent), "Trying to erase a non existing entity.");
+
+		for (auto& components : m_components)
+			if (components && components->contains(_ent.toIndex()))
+				components->erase(_ent.toIndex());
+
+		++m_generations[_ent.toIndex()];
+		m_alive[_ent.toIndex()] = false;
+		m_unusedEntities.push_back(_ent);
+	}
+
+	bool isAlive(Entity _ent) const
+	{
+		return _ent.toIndex() < m_alive.size() && m_alive[_ent.toIndex()];
+	}
+
+	EntityRef getRef(Entity _ent) const
+	{
+		ASSERT(isAlive(_ent), "Trying to reference a non existing entity.");
+		return EntityRef{ _ent, m_generations[_ent.toIndex()] };
+	}
+
+	// Returns the entity if it still exists.
+	std::optional<Entity> getEntity(const EntityRef& _ref) const
+	{
+		if (isAlive(_ref.entity) && m_generations[_ref.entity.toIndex()] == _ref.generation)
+			return _ref.entity;
+		return std::nullopt;
+	}
+
+	template<typename Component>
+	ComponentAccess<Component> getComponents()
+	{
+		const size_t typeIndex = static_cast<size_t>(utils::TypeIndex::value<Component>());
+		if (m_components.size() <= typeIndex)
+			m_components.resize(typeIndex + 1);
+		if (!m_components[typeIndex])
+			m_components[typeIndex] = std::make_unique<ComponentStorage>(utils::TypeHolder<Component>{});
+
+		return ComponentAccess<Component>(*m_components[typeIndex]);
+	}
+
+	// Call _action for every entity which has all components from the signature of _action.
+	// Parameters are references to components or an Entity to receive the current entity.
+	// Iterates the smallest of the involved component pools and looks up the others.
+	// The action must not add or remove components of the involved types.
+	// Example: registry.execute([](Entity _ent, Position& _pos, const Velocity& _vel) {...});
+	template<typename Action>
+	void execute(Action&& _action)
+	{
+		using ActionT = std::remove_reference_t<Action>;
+		executeUnpacked(_action, utils::UnpackFunction(&ActionT::operator()));
+	}
+
+private:
+	template<typename Arg>
+	constexpr static bool IS_ENTITY = std::is_same_v<std::decay_t<Arg>, Entity>;
+
+	template<typename Action, typename... Args>
+	void executeUnpacked(Action& _action, utils::UnpackFunction<Action, Args...>)
+	{
+		static_assert((!IS_ENTITY<Args> || ...), "At least one component type is required.");
+
+		constexpr size_t NUM_ARGS = sizeof...(Args);
+		const std::array<ComponentStorage*, NUM_ARGS> pools = { findPool<std::decay_t<Args>>()... };
+		constexpr std::array<bool, NUM_ARGS> isEntity = { IS_ENTITY<Args>... };
+
+		// The smallest pool limits the number of entities that can match.
+		size_t driver = NUM_ARGS;
+		Entity::IdType minSize = std::numeric_limits<Entity::IdType>::max();
+		for (size_t i = 0; i < NUM_ARGS; ++i)
+		{
+			if (isEntity[i]) continue;
+			if (!pools[i]) return;
+			if (pools[i]->size() < minSize)
+			{
+				minSize = pools[i]->size();
+				driver = i;
+			}
+		}
+
+		[&]<size_t... I>(std::index_sequence<I...> _seq)
+		{
+			((driver == I ? iterateFrom<I, Action, Args...>(_action, pools, _seq) : void()), ...);
+		}(std::index_sequence_for<Args...>{});
+	}
+
+	template<size_t Driver, typename Action, typename... Args, size_t... I>
+	void iterateFrom(Action& _action, const std::array<ComponentStorage*, sizeof...(Args)>& _pools, std::index_sequence<I...>)
+	{
+		using DriverT = std::decay_t<std::tuple_element_t<Driver, std::tuple<Args...>>>;
+		if constexpr (!std::is_same_v<DriverT, Entity>)
+		{
+			for (auto [key, driverComp] : _pools[Driver]->template iterate<DriverT>())
+			{
+				const auto args = std::make_tuple(fetch<I == Driver, std::decay_t<Args>>(_pools[I], key, &driverComp)...);
+				if ((isValid(std::get<I>(args)) && ...))
+					_action(deref(std::get<I>(args))...);
+			}
+		}
+	}
+
+	// Get a pointer to the component of _key or the entity itself.
+	template<bool IsDriver, typename Arg, typename DriverT>
+	static auto fetch(ComponentStorage* _pool, Entity::IdType _key, DriverT* _driverComp)
+	{
+		if constexpr (std::is_same_v<Arg, Entity>) return Entity(_key);
+		else if constexpr (IsDriver) return _driverComp;
+		else return _pool->contains(_key) ? &_pool->template at<Arg>(_key) : static_cast<Arg*>(nullptr);
+	}
+	template<typename T>
+	static bool isValid(T* _comp) { return _comp != nullptr; }
+	static bool isValid(Entity) { return true; }
+	template<typename T>
+	static T& deref(T* _comp) { return *_comp; }
+	static Entity deref(Entity _ent) { return _ent; }
+
+	template<typename Component>
+	ComponentStorage* findPool() const
+	{
+		if constexpr (std::is_same_v<Component, Entity>) return nullptr;
+		else
+		{
+			const size_t typeIndex = static_cast<size_t>(utils::TypeIndex::value<Component>());
+			return typeIndex < m_components.size() ? m_components[typeIndex].get() : nullptr;
+		}
+	}
+
+	std::vector<std::unique_ptr<ComponentStorage>> m_components;
+	std::vector<uint32_t> m_generations;
+	std::vector<bool> m_alive;
+	std::vector<Entity> m_unusedEntities;
+};
@@ -5,6 +5,7 @@
 #include "../core/shader.hpp"
 #include "../core/device.hpp"
 #include "../resources.hpp"
+#include "../../utils/alloctracker.hpp"
 
 #include <glm/gtx/norm.hpp>
 #include <string>
@@ -23,8 +24,10 @@ namespace graphics {
 	constexpr int MIP_LEVELS = 4;			///< Number of smaller mip-maps
 	constexpr int MIP_RANGE = 1<<MIP_LEVELS;///< Size factor between largest (BASE_SIZE) and smallest map
 
-	FontRenderer::FontRenderer() :
-		m_texture(nullptr)
+	FontRenderer::FontRenderer(std::pmr::memory_resource* _frameMemory) :
+		m_texture(nullptr),
+		m_instances(_frameMemory ? _frameMemory : utils::AllocTracker::resource(utils::AllocTag::RENDERER)),
+		m_frameMemory(_frameMemory != nullptr)
 	{
 		m_program.attach(ShaderManager::get("../resources/shader/font.vert", ShaderType::VERTEX));
 		m_program.attach(ShaderManager::get("../resources/shader/font.geom", ShaderType::GEOMETRY));
@@ -218,7 +221,15 @@ namespace graphics {
 
 	void FontRenderer::clearText()
 	{
-		m_instances.clear();
+		if(m_frameMemory)
+		{
+			// the old memory belongs to a previous frame, start with the previous size
+			const size_t previousSize = m_instances.size();
+			m_instances = std::pmr::vector<CharacterVertex>(m_instances.get_allocator());
+			m_instances.reserve(previousSize);
+		}
+		else
+			m_instances.clear();
 	}
 
 	void FontRenderer::present(const Camera& _camera)
@@ -9,6 +9,7 @@
 #include <glm/gtc/type_precision.hpp>
 #include <glm/packing.hpp>
 #include <vector>
+#include <memory_resource>
 #include <unordered_map>
 #include <functional>
 #include <memory>
@@ -26,7 +27,11 @@ namespace graphics {
 	{
 	public:
 		/// Create OpenGL-resources
-		FontRenderer();
+		/// \param [in] _frameMemory Optional per-frame memory for the character instances,
+		///		e.g. a utils::FrameArena. clearText() then drops the instances instead of keeping
+		///		their capacity and has to be called every frame after the arena moved on.
+		///		Otherwise the instances are reported to utils::AllocTag::RENDERER.
+		explicit FontRenderer(std::pmr::memory_resource* _frameMemory = nullptr);
 		/// Destroy OpenGL-resources
 		~FontRenderer();
 
@@ -111,7 +116,8 @@ namespace graphics {
 		mutable bool m_dirty;
 
 		std::unordered_map<char32_t, CharacterDef> m_chars;
-		std::vector<CharacterVertex> m_instances;
+		std::pmr::vector<CharacterVertex> m_instances;
+		bool m_frameMemory;					///< m_instances are allocated from per-frame memory
 		int m_baseLineOffset;				///< Offset to the original text base line (normalization lifts all characters)
 
 		Program m_program;
@@ -2,14 +2,17 @@
 #include "../core/opengl.hpp"
 #include "../core/vertexformat.hpp"
 #include "../resources.hpp"
+#include "../../utils/alloctracker.hpp"
 #include <spdlog/spdlog.h>
 
 using namespace glm;
 
 namespace graphics {
 
-SpriteRenderer::SpriteRenderer()
-	: m_dirty(true)
+SpriteRenderer::SpriteRenderer(std::pmr::memory_resource* _frameMemory)
+	: m_instances(_frameMemory ? _frameMemory : utils::AllocTracker::resource(utils::AllocTag::RENDERER)),
+	m_dirty(true),
+	m_frameMemory(_frameMemory != nullptr)
 {
 	m_program.attach(ShaderManager::get("../resources/shader/sprite.vert", ShaderType::VERTEX));
 	m_program.attach(ShaderManager::get("../resources/shader/sprite.geom", ShaderType::GEOMETRY));
@@ -73,7 +76,15 @@ void SpriteRenderer::draw(const Sprite& _sprite, const vec3& _position, float _r
 
 void SpriteRenderer::clear()
 {
-	m_instances.clear();
+	if(m_frameMemory)
+	{
+		// the old memory belongs to a previous frame, start with the previous size
+		const size_t previousSize = m_instances.size();
+		m_instances = std::pmr::vector<SpriteInstance>(m_instances.get_allocator());
+		m_instances.reserve(previousSize);
+	}
+	else
+		m_instances.clear();
 	m_dirty = true;
 }
 
@@ -4,6 +4,7 @@
 #include "../core/shader.hpp"
 #include "../camera.hpp"
 #include <vector>
+#include <memory_resource>
 
 namespace graphics {
 
@@ -14,7 +15,11 @@ namespace graphics {
 	{
 	public:
 		/// Initialize the renderer once.
-		SpriteRenderer();
+		/// \param [in] _frameMemory Optional per-frame memory for the instances, e.g. a
+		///		utils::FrameArena. clear() then drops the instances instead of keeping their
+		///		capacity and has to be called every frame after the arena moved on.
+		///		Otherwise the instances are reported to utils::AllocTag::RENDERER.
+		explicit SpriteRenderer(std::pmr::memory_resource* _frameMemory = nullptr);
 
 		/// \param [in] _position Position in world (x,y) and z for the "layer". You may also use
 		///		the sprites in a 3D environment as billboards. Dependent on the camera z is also
@@ -64,8 +69,9 @@ namespace graphics {
 		unsigned m_vao;		///< OpenGL vertex array object
 		unsigned m_vbo;		///< OpenGL vertex buffer for sprites
 
-		std::vector<SpriteInstance> m_instances;
+		std::pmr::vector<SpriteInstance> m_instances;
 		mutable bool m_dirty;
+		bool m_frameMemory;		///< m_instances are allocated from per-frame memory
 
 		Program m_program; // todo: move outside to reuse
 	};
@@ -0,0 +1,140 @@
+#include "alloctracker.hpp"
+#include <nlohmann/json.hpp>
+#include <fstream>
+
+namespace utils {
+
+	using json = nlohmann::json;
+
+	namespace {
+		// Forwards to std::pmr::new_delete_resource() and reports to the tracker.
+		class TrackedResource : public std::pmr::memory_resource
+		{
+		public:
+			explicit TrackedResource(AllocTag _tag) : m_tag(_tag) {}
+
+		private:
+			void* do_allocate(size_t _bytes, size_t _alignment) override
+			{
+				void* ptr = std::pmr::new_delete_resource()->allocate(_bytes, _alignment);
+				AllocTracker::allocate(m_tag, _bytes);
+				return ptr;
+			}
+
+			void do_deallocate(void* _ptr, size_t _bytes, size_t _alignment) override
+			{
+				AllocTracker::deallocate(m_tag, _bytes);
+				std::pmr::new_delete_resource()->deallocate(_ptr, _bytes, _alignment);
+			}
+
+			bool do_is_equal(const std::pmr::memory_resource& _other) const noexcept override
+			{
+				return this == &_other;
+			}
+
+			AllocTag m_tag;
+		};
+	}
+
+	void AllocTracker::nextFrame()
+	{
+		for (details::AllocCounters& counters : details::g_allocCounters)
+		{
+			const size_t allocations = counters.frameAllocations.exchange(0, std::memory_order_relaxed);
+			counters.lastFrameAllocations.store(allocations, std::memory_order_relaxed);
+			counters.lastFrameBytes.store(counters.frameBytes.exchange(0, std::memory_order_relaxed), std::memory_order_relaxed);
+			if (allocations > counters.maxFrameAllocations.load(std::memory_order_relaxed))
+				counters.maxFrameAllocations.store(allocations, std::memory_order_relaxed);
+		}
+		details::g_allocTrackingFrame.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	AllocTracker::Stats AllocTracker::stats(AllocTag _tag)
+	{
+		const details::AllocCounters& counters = details::g_allocCounters[static_cast<size_t>(_tag)];
+		Stats stats;
+		stats.liveBytes = counters.liveBytes.load(std::memory_order_relaxed);
+		stats.peakBytes = static_cast<size_t>(counters.peakBytes.load(std::memory_order_relaxed));
+		stats.numAllocations = counters.numAllocations.load(std::memory_order_relaxed);
+		stats.numDeallocations = counters.numDeallocations.load(std::memory_order_relaxed);
+		stats.frameAllocations = counters.lastFrameAllocations.load(std::memory_order_relaxed);
+		stats.frameBytes = counters.lastFrameBytes.load(std::memory_order_relaxed);
+		stats.maxFrameAllocations = counters.maxFrameAllocations.load(std::memory_order_relaxed);
+		return stats;
+	}
+
+	const char* AllocTracker::name(AllocTag _tag)
+	{
+		switch (_tag)
+		{
+		case AllocTag::HASH_MAP: return "HashMap";
+		case AllocTag::BLOCK_ALLOCATOR: return "BlockAllocator";
+		case AllocTag::SLOT_MAP: return "SlotMap";
+		case AllocTag::RENDERER: return "Renderer";
+		case AllocTag::OTHER: return "Other";
+		default: return "Unknown";
+		}
+	}
+
+	std::string AllocTracker::toJson(int _indent)
+	{
+		json tags = json::object();
+		for (size_t i = 0; i < static_cast<size_t>(AllocTag::COUNT); ++i)
+		{
+			const AllocTag tag = static_cast<AllocTag>(i);
+			const Stats tagStats = stats(tag);
+			tags[name(tag)] = {
+				{ "liveBytes", tagStats.liveBytes },
+				{ "peakBytes", tagStats.peakBytes },
+				{ "numAllocations", tagStats.numAllocations },
+				{ "numDeallocations", tagStats.numDeallocations },
+				{ "frameAllocations", tagStats.frameAllocations },
+				{ "frameBytes", tagStats.frameBytes },
+				{ "maxFrameAllocations", tagStats.maxFrameAllocations }
+			};
+		}
+
+		const json result = {
+			{ "enabled", isEnabled() },
+			{ "frame", frame() },
+			{ "tags", std::move(tags) }
+		};
+		return result.dump(_indent);
+	}
+
+	bool AllocTracker::dumpJson(const std::string& _fileName)
+	{
+		std::ofstream file(_fileName);
+		file << toJson(4);
+		return static_cast<bool>(file);
+	}
+
+	void AllocTracker::reset()
+	{
+		for (details::AllocCounters& counters : details::g_allocCounters)
+		{
+			counters.liveBytes.store(0, std::memory_order_relaxed);
+			counters.peakBytes.store(0, std::memory_order_relaxed);
+			counters.numAllocations.store(0, std::memory_order_relaxed);
+			counters.numDeallocations.store(0, std::memory_order_relaxed);
+			counters.frameAllocations.store(0, std::memory_order_relaxed);
+			counters.frameBytes.store(0, std::memory_order_relaxed);
+			counters.lastFrameAllocations.store(0, std::memory_order_relaxed);
+			counters.lastFrameBytes.store(0, std::memory_order_relaxed);
+			counters.maxFrameAllocations.store(0, std::memory_order_relaxed);
+		}
+		details::g_allocTrackingFrame.store(0, std::memory_order_relaxed);
+	}
+
+	std::pmr::memory_resource* AllocTracker::resource(AllocTag _tag)
+	{
+		static std::array<TrackedResource, static_cast<size_t>(AllocTag::COUNT)> resources = {
+			TrackedResource(AllocTag::HASH_MAP),
+			TrackedResource(AllocTag::BLOCK_ALLOCATOR),
+			TrackedResource(AllocTag::SLOT_MAP),
+			TrackedResource(AllocTag::RENDERER),
+			TrackedResource(AllocTag::OTHER)
+		};
+		return &resources[static_cast<size_t>(_tag)];
+	}
+}
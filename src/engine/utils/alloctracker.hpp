@@ -0,0 +1,117 @@
+#pragma once
+
+#include <memory_resource>
+#include <atomic>
+#include <array>
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+namespace utils {
+
+	/// Subsystems whose heap memory is tracked separately.
+	enum struct AllocTag : uint8_t
+	{
+		HASH_MAP,			///< utils::HashMap and utils::FlatHashMap tables
+		BLOCK_ALLOCATOR,	///< blocks of utils::BlockAllocator
+		SLOT_MAP,			///< value storages of utils::WeakSlotMap and utils::ArchetypeStorage
+		RENDERER,			///< instance arrays of the renderers
+		OTHER,				///< anything using AllocTracker::resource(AllocTag::OTHER)
+		COUNT
+	};
+
+	namespace details {
+		// One cache line per tag, so that different subsystems do not contend.
+		struct alignas(64) AllocCounters
+		{
+			std::atomic<int64_t> liveBytes{ 0 };
+			std::atomic<int64_t> peakBytes{ 0 };
+			std::atomic<size_t> numAllocations{ 0 };
+			std::atomic<size_t> numDeallocations{ 0 };
+			std::atomic<size_t> frameAllocations{ 0 };
+			std::atomic<size_t> frameBytes{ 0 };
+			std::atomic<size_t> lastFrameAllocations{ 0 };
+			std::atomic<size_t> lastFrameBytes{ 0 };
+			std::atomic<size_t> maxFrameAllocations{ 0 };
+		};
+
+		inline std::atomic<bool> g_allocTrackingEnabled{ false };
+		inline std::atomic<uint64_t> g_allocTrackingFrame{ 0 };
+		inline std::array<AllocCounters, static_cast<size_t>(AllocTag::COUNT)> g_allocCounters;
+	}
+
+	/// Opt-in counters of live bytes, peak bytes and allocations per AllocTag.
+	/// \details Containers report their own allocations with allocate() / deallocate(),
+	///		everything based on std::pmr can use resource(). While tracking is disabled
+	///		(the default) each report costs a single branch. Enable it at startup, memory
+	///		which was allocated before is not known and deallocating it reduces the live
+	///		bytes below their real value, possibly below 0. The peak is only raised by
+	///		positive live bytes.
+	///		All functions are thread-safe, the counters are updated with relaxed atomics.
+	class AllocTracker
+	{
+	public:
+		struct Stats
+		{
+			// negative if more memory was freed than allocated while enabled
+			int64_t liveBytes = 0;
+			size_t peakBytes = 0;
+			size_t numAllocations = 0;
+			size_t numDeallocations = 0;
+			// allocations in the last frame, see nextFrame()
+			size_t frameAllocations = 0;
+			size_t frameBytes = 0;
+			// largest number of allocations in a single frame
+			size_t maxFrameAllocations = 0;
+		};
+
+		static void setEnabled(bool _enabled) { details::g_allocTrackingEnabled.store(_enabled, std::memory_order_relaxed); }
+		static bool isEnabled() { return details::g_allocTrackingEnabled.load(std::memory_order_relaxed); }
+
+		static void allocate(AllocTag _tag, size_t _bytes)
+		{
+			if (!isEnabled()) return;
+
+			details::AllocCounters& counters = details::g_allocCounters[static_cast<size_t>(_tag)];
+			const int64_t bytes = static_cast<int64_t>(_bytes);
+			const int64_t live = counters.liveBytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+			int64_t peak = counters.peakBytes.load(std::memory_order_relaxed);
+			while (live > peak && !counters.peakBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {}
+			counters.numAllocations.fetch_add(1, std::memory_order_relaxed);
+			counters.frameAllocations.fetch_add(1, std::memory_order_relaxed);
+			counters.frameBytes.fetch_add(_bytes, std::memory_order_relaxed);
+		}
+
+		static void deallocate(AllocTag _tag, size_t _bytes)
+		{
+			if (!isEnabled()) return;
+
+			details::AllocCounters& counters = details::g_allocCounters[static_cast<size_t>(_tag)];
+			counters.liveBytes.fetch_sub(static_cast<int64_t>(_bytes), std::memory_order_relaxed);
+			counters.numDeallocations.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		/// End the current frame. The allocations since the last call become the
+		/// frame statistics of stats().
+		static void nextFrame();
+		/// Number of completed frames.
+		static uint64_t frame() { return details::g_allocTrackingFrame.load(std::memory_order_relaxed); }
+
+		static Stats stats(AllocTag _tag);
+		static const char* name(AllocTag _tag);
+
+		/// All counters as JSON object of the form
+		/// { "enabled": true, "frame": 42, "tags": { "HashMap": { "liveBytes": ... }, ... } }.
+		/// \param [in] _indent Number of spaces per level, -1 for a single line.
+		static std::string toJson(int _indent = -1);
+		/// Write toJson() to a file.
+		/// \return false if the file could not be written.
+		static bool dumpJson(const std::string& _fileName);
+
+		/// Set all counters to 0.
+		static void reset();
+
+		/// std::pmr::new_delete_resource() which reports to _tag.
+		static std::pmr::memory_resource* resource(AllocTag _tag);
+	};
+}
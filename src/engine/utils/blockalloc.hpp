@@ -1,67 +1,283 @@
 #pragma once
 
+#include "alloctracker.hpp"
 #include <utility>
 #include <memory>
+#include <mutex>
+#include <atomic>
+#include <vector>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
 
 namespace utils {
-	/// @brief A simple allocator which maintains memory blocks holding multiple 
-	///		elements of the same type.
+	namespace details {
+		// Identifies the thread local caches of an allocator. Ids are never reused,
+		// so caches of destroyed allocators are not found again.
+		inline std::atomic<uint64_t> g_blockAllocatorIds{ 1 };
+	}
+
+	/// @brief A simple allocator which maintains memory blocks holding multiple
+	///		elements of the same type. Destroyed objects leave a slot in an intrusive
+	///		free list, which is reused before a new block is allocated.
 	/// @param T The type of objects to handle.
 	/// @param ElemPerBlock Number elements to hold in a single memory block.
-	///		A larger value leads to fewer allocations but more wasted space if 
+	///		A larger value leads to fewer allocations but more wasted space if
 	///		the lifetimes differ.
-	template<typename T, int ElemPerBlock>
+	/// @param ThreadLocalCaches Allow create() and destroy() from multiple threads.
+	///		Each thread allocates from its own block and keeps its own free list. Only
+	///		allocating a block and exchanging batches of ElemPerBlock free slots lock a
+	///		mutex, so objects freed by other threads are reused as well. When a thread
+	///		exits, its free slots and the rest of its block are handed back for reuse.
+	///		reset() and the destructor require that no other thread uses the allocator
+	///		or exits at the same time.
+	template<typename T, int ElemPerBlock, bool ThreadLocalCaches = false>
 	class BlockAllocator
 	{
 	public:
-		BlockAllocator()
-			: first(new Node()), current(first.get())
-		{
-
-		}
+		BlockAllocator() = default;
+		BlockAllocator(const BlockAllocator&) = delete;
+		BlockAllocator& operator=(const BlockAllocator&) = delete;
+		~BlockAllocator() { reset(); }
 
 		/// @brief Create a new object.
 		/// Arguments are forwarded to the constructor of T.
 		template<typename... Args>
 		T* create(Args&&... args)
 		{
-			if (current->numElements == ElemPerBlock)
-			{
-				Node* prev = current;
-				current = new Node();
-				prev->next = current;
-			}
-			char* ptr = current->buffer + current->numElements * sizeof(T);
-			++current->numElements;
+			return new (allocate()) T (std::forward<Args>(args)...);
+		}
 
-			return new (ptr) T (std::forward<Args>(args)...);
+		/// @brief Destroy an object created by this allocator and keep its slot for reuse.
+		void destroy(T* _ptr)
+		{
+			_ptr->~T();
+			Cache& cache = localCache();
+			Slot* slot = reinterpret_cast<Slot*>(_ptr);
+			slot->next = cache.freeList;
+			cache.freeList = slot;
+			++cache.numFree;
+			if constexpr (ThreadLocalCaches)
+				if (cache.numFree >= 2 * ElemPerBlock) releaseBatch(cache);
 		}
 
-		// Delete all objects and free all but one block.
+		// Delete all objects and free all blocks.
 		void reset()
 		{
-			first.reset(new Node());
-			current = first.get();
+			if constexpr (!std::is_trivially_destructible_v<T>)
+				destroyLiveObjects();
+
+			while (m_blocks)
+			{
+				Node* next = m_blocks->next;
+				AllocTracker::deallocate(AllocTag::BLOCK_ALLOCATOR, sizeof(Node));
+				delete m_blocks;
+				m_blocks = next;
+			}
+			m_numBlocks = 0;
+			m_batches.clear();
+			m_cache = Cache{};
+			for (auto& cache : m_caches)
+				*cache = Cache{};
 		}
 
+		// Memory held by the blocks in bytes. Not synchronized with other threads.
+		size_t memoryUsage() const { return m_numBlocks * sizeof(Node); }
+
 	private:
+		union Slot
+		{
+			Slot* next;
+			alignas(T) std::byte data[sizeof(T)];
+		};
+
 		struct Node
 		{
-			~Node()
+			Slot slots[ElemPerBlock];
+			Node* next = nullptr;
+			int numElements = 0;
+		};
+
+		// Allocation state of one thread.
+		struct Cache
+		{
+			Node* block = nullptr;
+			Slot* freeList = nullptr;
+			size_t numFree = 0;
+		};
+
+		// A list of free slots shared between threads.
+		struct Batch
+		{
+			Slot* freeList;
+			size_t numFree;
+		};
+
+		void* allocate()
+		{
+			Cache& cache = localCache();
+			if (!cache.freeList && (!cache.block || cache.block->numElements == ElemPerBlock))
 			{
-				T* ptr = reinterpret_cast<T*>(buffer);
-				for (int i = 0; i < numElements; ++i)
-					ptr[i].~T();
+				if constexpr (ThreadLocalCaches)
+				{
+					std::scoped_lock lock(m_mutex);
+					if (!m_batches.empty())
+					{
+						cache.freeList = m_batches.back().freeList;
+						cache.numFree = m_batches.back().numFree;
+						m_batches.pop_back();
+					}
+					else cache.block = addBlock();
+				}
+				else cache.block = addBlock();
+			}
 
-				if (next) delete next;
+			if (cache.freeList)
+			{
+				Slot* slot = cache.freeList;
+				cache.freeList = slot->next;
+				--cache.numFree;
+				return slot;
 			}
+			return &cache.block->slots[cache.block->numElements++];
+		}
 
-			char buffer[sizeof(T) * ElemPerBlock];
-			Node* next = nullptr;
-			int numElements = 0;
+		Node* addBlock()
+		{
+			Node* node = new Node;
+			AllocTracker::allocate(AllocTag::BLOCK_ALLOCATOR, sizeof(Node));
+			node->next = m_blocks;
+			m_blocks = node;
+			++m_numBlocks;
+			return node;
+		}
+
+		// Move ElemPerBlock free slots to the shared list for other threads.
+		void releaseBatch(Cache& _cache)
+		{
+			Slot* batch = _cache.freeList;
+			Slot* last = batch;
+			for (int i = 1; i < ElemPerBlock; ++i)
+				last = last->next;
+			_cache.freeList = last->next;
+			_cache.numFree -= ElemPerBlock;
+			last->next = nullptr;
+
+			std::scoped_lock lock(m_mutex);
+			m_batches.push_back({ batch, ElemPerBlock });
+		}
+
+		// Hand all free slots of an exiting thread to the other threads and drop its cache.
+		void returnCache(Cache& _cache)
+		{
+			if (_cache.block)
+			{
+				for (int i = _cache.block->numElements; i < ElemPerBlock; ++i)
+				{
+					Slot* slot = &_cache.block->slots[i];
+					slot->next = _cache.freeList;
+					_cache.freeList = slot;
+					++_cache.numFree;
+				}
+				_cache.block->numElements = ElemPerBlock;
+			}
+
+			std::scoped_lock lock(m_mutex);
+			if (_cache.freeList)
+				m_batches.push_back({ _cache.freeList, _cache.numFree });
+			std::erase_if(m_caches, [&](const std::shared_ptr<Cache>& _entry) { return _entry.get() == &_cache; });
+		}
+
+		Cache& localCache()
+		{
+			if constexpr (!ThreadLocalCaches) return m_cache;
+			else
+			{
+				ThreadCaches& caches = threadCaches();
+				if (caches.lastId != m_id)
+				{
+					caches.lastCache = findCache(caches);
+					caches.lastId = m_id;
+				}
+				return *caches.lastCache;
+			}
+		}
+
+		// The caches of one thread for all allocators it has used. The allocators own
+		// the caches, so entries of destroyed allocators expire and are removed
+		// whenever a new cache is added. On thread exit the remaining caches are
+		// returned to their allocators.
+		struct ThreadCaches
+		{
+			struct Entry
+			{
+				uint64_t id;
+				BlockAllocator* allocator;
+				std::weak_ptr<Cache> cache;
+			};
+
+			~ThreadCaches()
+			{
+				for (Entry& entry : entries)
+					if (std::shared_ptr<Cache> cache = entry.cache.lock())
+						entry.allocator->returnCache(*cache);
+			}
+
+			uint64_t lastId = 0;
+			Cache* lastCache = nullptr;
+			std::vector<Entry> entries;
 		};
 
-		std::unique_ptr<Node> first;
-		Node* current;
+		static ThreadCaches& threadCaches()
+		{
+			thread_local ThreadCaches caches;
+			return caches;
+		}
+
+		Cache* findCache(ThreadCaches& _caches)
+		{
+			for (auto& entry : _caches.entries)
+				if (entry.id == m_id) return entry.cache.lock().get();
+
+			std::erase_if(_caches.entries, [](const auto& _entry) { return _entry.cache.expired(); });
+			std::scoped_lock lock(m_mutex);
+			const std::shared_ptr<Cache>& cache = m_caches.emplace_back(std::make_shared<Cache>());
+			_caches.entries.push_back({ m_id, this, cache });
+			return cache.get();
+		}
+
+		void destroyLiveObjects()
+		{
+			std::vector<const Slot*> freeSlots;
+			auto addList = [&](const Slot* _slot)
+			{
+				for (; _slot; _slot = _slot->next)
+					freeSlots.push_back(_slot);
+			};
+			addList(m_cache.freeList);
+			for (auto& cache : m_caches)
+				addList(cache->freeList);
+			for (const Batch& batch : m_batches)
+				addList(batch.freeList);
+			std::sort(freeSlots.begin(), freeSlots.end(), std::less<>());
+
+			for (Node* node = m_blocks; node; node = node->next)
+				for (int i = 0; i < node->numElements; ++i)
+				{
+					Slot* slot = &node->slots[i];
+					if (!std::binary_search(freeSlots.begin(), freeSlots.end(), slot, std::less<>()))
+						reinterpret_cast<T*>(slot)->~T();
+				}
+		}
+
+		Node* m_blocks = nullptr;
+		size_t m_numBlocks = 0;
+		Cache m_cache;
+		// only used with ThreadLocalCaches
+		uint64_t m_id = ThreadLocalCaches ? details::g_blockAllocatorIds.fetch_add(1) : 0;
+		std::mutex m_mutex;
+		std::vector<std::shared_ptr<Cache>> m_caches;
+		std::vector<Batch> m_batches;
 	};
-}
\ No newline at end of file
+}
@@ -0,0 +1,427 @@
+#pragma once
+
+#include "../../utils/assert.hpp"
+#include "../../utils/typeindex.hpp"
+#include "slotstorage.hpp"
+#include <vector>
+#include <array>
+#include <tuple>
+#include <memory>
+#include <algorithm>
+#include <limits>
+#include <utility>
+#include <concepts>
+#include <cstring>
+#include <cstdint>
+#include <type_traits>
+
+namespace utils {
+
+	namespace details {
+		/// Type erased operations of a component type.
+		struct ComponentType
+		{
+			int id; // TypeIndex
+			size_t size;
+			size_t alignment;
+			// trivially copyable components are relocated with memcpy and never destroyed
+			bool trivial;
+			void (*moveConstruct)(void* _dst, void* _src);
+			void (*destroy)(void* _ptr);
+
+			template<typename T>
+			static ComponentType create()
+			{
+				return ComponentType{ TypeIndex::value<T>(), sizeof(T), alignof(T), std::is_trivially_copyable_v<T>,
+					[](void* _dst, void* _src) { new (_dst) T(std::move(*static_cast<T*>(_src))); },
+					[](void* _ptr) { static_cast<T*>(_ptr)->~T(); } };
+			}
+		};
+	}
+
+	/// Stores the components of entities grouped by their component set (archetype).
+	/// \details Each archetype is a table of fixed size chunks with one column per
+	///		component type and one for the keys. Iterating all entities with a given set
+	///		of components is a linear pass over the matching chunks without any lookups.
+	///		Adding or removing a component moves the entity with all its components to
+	///		another archetype; the transitions are cached per archetype. References to
+	///		components are invalidated by any structural change of the same archetype.
+	///		The alternative with one WeakSlotMap per component type (see Registry) has
+	///		cheaper structural changes but has to probe the other pools during a join.
+	/// \tparam Key Small integer ids like Entity::IdType, memory for the locations is
+	///		proportional to the largest key.
+	/// \tparam ChunkBytes Size of each chunk. A chunk holds at least one entity.
+	template<std::integral Key, size_t ChunkBytes = 16384>
+	class ArchetypeStorage
+	{
+	public:
+		ArchetypeStorage()
+		{
+			// entities without components
+			m_archetypes.push_back(std::make_unique<Archetype>(std::vector<details::ComponentType>{}));
+		}
+		ArchetypeStorage(ArchetypeStorage&&) noexcept = default;
+		ArchetypeStorage& operator=(ArchetypeStorage&&) noexcept = default;
+
+		// Add a component to _key, which is created if it did not exist yet.
+		// If the component exists already, it is returned unchanged.
+		template<std::movable Component, typename... Args>
+		Component& emplace(Key _key, Args&&... _args)
+		{
+			if (!contains(_key)) create(_key);
+
+			const details::ComponentType type = details::ComponentType::create<Component>();
+			Location& location = m_locations[_key];
+			Archetype& current = *m_archetypes[location.archetype];
+			const int column = current.findColumn(type.id);
+			if (column != -1)
+				return *reinterpret_cast<Component*>(current.at(column, location.row));
+
+			const uint32_t target = addTransition(location.archetype, type);
+			moveEntity(_key, target, -1);
+			Archetype& archetype = *m_archetypes[target];
+			return *new (archetype.at(archetype.findColumn(type.id), m_locations[_key].row))
+				Component(std::forward<Args>(_args)...);
+		}
+
+		// Remove the component of type Component from _key if it has one.
+		// The key remains, even without any components.
+		template<typename Component>
+		void remove(Key _key)
+		{
+			ASSERT(contains(_key), "Trying to remove a component of a non existing key.");
+
+			const int typeId = TypeIndex::value<Component>();
+			const Location location = m_locations[_key];
+			const int column = m_archetypes[location.archetype]->findColumn(typeId);
+			if (column == -1) return;
+
+			moveEntity(_key, removeTransition(location.archetype, typeId), column);
+		}
+
+		// Remove _key with all its components.
+		void erase(Key _key)
+		{
+			ASSERT(contains(_key), "Trying to delete a non existing key.");
+
+			const Location location = m_locations[_key];
+			Archetype& archetype = *m_archetypes[location.archetype];
+			for (size_t i = 0; i < archetype.numColumns(); ++i)
+				archetype.destroy(i, location.row);
+			removeRow(archetype, location.row);
+			m_locations[_key] = Location{};
+			--m_size;
+		}
+
+		bool contains(Key _key) const
+		{
+			return static_cast<size_t>(_key) < m_locations.size() && m_locations[_key].archetype != INVALID;
+		}
+
+		template<typename Component>
+		bool has(Key _key) const
+		{
+			return contains(_key) && m_archetypes[m_locations[_key].archetype]->findColumn(TypeIndex::value<Component>()) != -1;
+		}
+
+		// Returns nullptr if _key has no component of this type.
+		template<typename Component>
+		Component* at(Key _key)
+		{
+			if (!contains(_key)) return nullptr;
+			const Location location = m_locations[_key];
+			Archetype& archetype = *m_archetypes[location.archetype];
+			const int column = archetype.findColumn(TypeIndex::value<Component>());
+			return column != -1 ? reinterpret_cast<Component*>(archetype.at(column, location.row)) : nullptr;
+		}
+		template<typename Component>
+		const Component* at(Key _key) const
+		{
+			return const_cast<ArchetypeStorage*>(this)->template at<Component>(_key);
+		}
+
+		// Call _func(Key, Components&...) for every key which has all Components.
+		// Components may be const qualified. _func must not add or remove components.
+		// Example: storage.forEach<Position, const Velocity>([](Key, Position&, const Velocity&) {...});
+		template<typename... Components, typename Func>
+		void forEach(Func&& _func)
+		{
+			static_assert(sizeof...(Components) > 0, "At least one component type is required.");
+			constexpr size_t NUM_COMPONENTS = sizeof...(Components);
+			const std::array<int, NUM_COMPONENTS> types = { TypeIndex::value<std::remove_const_t<Components>>()... };
+
+			for (auto& archetype : m_archetypes)
+			{
+				if (archetype->size() == 0) continue;
+				std::array<size_t, NUM_COMPONENTS> offsets;
+				bool match = true;
+				for (size_t i = 0; i < NUM_COMPONENTS && match; ++i)
+				{
+					const int column = archetype->findColumn(types[i]);
+					match = column != -1;
+					if (match) offsets[i] = archetype->columnOffset(column);
+				}
+				if (!match) continue;
+
+				archetype->forEachChunk([&](const Key* _keys, char* _chunk, size_t _count)
+					{
+						iterateChunk<Components...>(_func, _keys, _chunk, offsets, _count,
+							std::make_index_sequence<NUM_COMPONENTS>{});
+					});
+			}
+		}
+
+		// Number of keys.
+		size_t size() const { return m_size; }
+		bool empty() const { return m_size == 0; }
+		size_t numArchetypes() const { return m_archetypes.size(); }
+
+	private:
+		constexpr static uint32_t INVALID = std::numeric_limits<uint32_t>::max();
+
+		struct Location
+		{
+			uint32_t archetype = INVALID;
+			Key row = 0;
+		};
+
+		// Table of the entities with the same set of components.
+		class Archetype
+		{
+		public:
+			// _types have to be sorted by id.
+			explicit Archetype(std::vector<details::ComponentType> _types)
+			{
+				// chunks start at a cache line
+				m_alignment = std::max<size_t>(alignof(Key), 64);
+				size_t rowBytes = sizeof(Key);
+				for (const details::ComponentType& type : _types)
+				{
+					m_columns.push_back({ type, 0 });
+					rowBytes += type.size;
+					m_alignment = std::max(m_alignment, type.alignment);
+				}
+				// padding between the columns can reduce the number of rows
+				m_rowsPerChunk = std::max<size_t>(1, ChunkBytes / rowBytes);
+				while (m_rowsPerChunk > 1 && layout(m_rowsPerChunk) > ChunkBytes)
+					--m_rowsPerChunk;
+				m_chunkBytes = layout(m_rowsPerChunk);
+			}
+
+			~Archetype()
+			{
+				for (size_t i = 0; i < m_columns.size(); ++i)
+					for (size_t row = 0; row < m_size; ++row)
+						destroy(i, row);
+			}
+
+			Archetype(const Archetype&) = delete;
+			Archetype& operator=(const Archetype&) = delete;
+
+			// -1 if the component is not part of this archetype
+			int findColumn(int _typeId) const
+			{
+				for (size_t i = 0; i < m_columns.size(); ++i)
+					if (m_columns[i].type.id == _typeId) return static_cast<int>(i);
+				return -1;
+			}
+			size_t numColumns() const { return m_columns.size(); }
+			size_t columnOffset(int _column) const { return m_columns[_column].offset; }
+			const details::ComponentType& type(size_t _column) const { return m_columns[_column].type; }
+
+			std::vector<details::ComponentType> types() const
+			{
+				std::vector<details::ComponentType> types;
+				for (const Column& column : m_columns)
+					types.push_back(column.type);
+				return types;
+			}
+
+			bool sameTypes(const std::vector<details::ComponentType>& _types) const
+			{
+				return std::equal(m_columns.begin(), m_columns.end(), _types.begin(), _types.end(),
+					[](const Column& _column, const details::ComponentType& _type) { return _column.type.id == _type.id; });
+			}
+
+			char* at(size_t _column, size_t _row) const
+			{
+				const Column& column = m_columns[_column];
+				return m_chunks[_row / m_rowsPerChunk].get() + column.offset + (_row % m_rowsPerChunk) * column.type.size;
+			}
+			Key& key(size_t _row) const
+			{
+				return reinterpret_cast<Key*>(m_chunks[_row / m_rowsPerChunk].get())[_row % m_rowsPerChunk];
+			}
+
+			// Append a row with uninitialized components.
+			size_t pushRow(Key _key)
+			{
+				if (m_size == m_chunks.size() * m_rowsPerChunk)
+					m_chunks.push_back(details::allocateAligned(m_chunkBytes, m_alignment));
+				key(m_size) = _key;
+				return m_size++;
+			}
+			// Remove the last row without destroying its components.
+			void popRow() { --m_size; }
+
+			// Move construct the component at (_column, _srcRow) to _dst and destroy the source.
+			void relocate(size_t _column, size_t _srcRow, char* _dst)
+			{
+				const details::ComponentType& type = m_columns[_column].type;
+				char* src = at(_column, _srcRow);
+				if (type.trivial) std::memcpy(_dst, src, type.size);
+				else
+				{
+					type.moveConstruct(_dst, src);
+					type.destroy(src);
+				}
+			}
+
+			void destroy(size_t _column, size_t _row)
+			{
+				const details::ComponentType& type = m_columns[_column].type;
+				if (!type.trivial) type.destroy(at(_column, _row));
+			}
+
+			// Call _func(const Key*, char* chunk, size_t count) for every chunk in use.
+			template<typename Func>
+			void forEachChunk(Func&& _func) const
+			{
+				for (size_t begin = 0; begin < m_size; begin += m_rowsPerChunk)
+				{
+					char* chunk = m_chunks[begin / m_rowsPerChunk].get();
+					_func(reinterpret_cast<const Key*>(chunk), chunk, std::min(m_rowsPerChunk, m_size - begin));
+				}
+			}
+
+			size_t size() const { return m_size; }
+
+			// cached archetype changes
+			struct Edge
+			{
+				int typeId;
+				bool add;
+				uint32_t target;
+			};
+			std::vector<Edge> edges;
+		private:
+			struct Column
+			{
+				details::ComponentType type;
+				size_t offset; // of the first element inside a chunk
+			};
+
+			// Set the column offsets for _rows rows per chunk.
+			// \returns The required chunk size.
+			size_t layout(size_t _rows)
+			{
+				size_t offset = _rows * sizeof(Key);
+				for (Column& column : m_columns)
+				{
+					offset = (offset + column.type.alignment - 1) / column.type.alignment * column.type.alignment;
+					column.offset = offset;
+					offset += _rows * column.type.size;
+				}
+				return offset;
+			}
+
+			std::vector<Column> m_columns;
+			std::vector<details::AlignedBuffer> m_chunks;
+			size_t m_rowsPerChunk = 1;
+			size_t m_chunkBytes = 0;
+			size_t m_alignment = 0;
+			size_t m_size = 0;
+		};
+
+		void create(Key _key)
+		{
+			if (m_locations.size() <= static_cast<size_t>(_key))
+				m_locations.resize(static_cast<size_t>(_key) + 1);
+			m_locations[_key] = Location{ 0, static_cast<Key>(m_archetypes[0]->pushRow(_key)) };
+			++m_size;
+		}
+
+		// Move _key to the archetype _target. Components which do not exist in the target
+		// are destroyed, new components stay uninitialized. _removedColumn is the column
+		// in the current archetype which is not part of the target or -1.
+		void moveEntity(Key _key, uint32_t _target, int _removedColumn)
+		{
+			const Location location = m_locations[_key];
+			Archetype& src = *m_archetypes[location.archetype];
+			Archetype& dst = *m_archetypes[_target];
+			const size_t row = dst.pushRow(_key);
+			for (size_t i = 0; i < src.numColumns(); ++i)
+			{
+				if (static_cast<int>(i) == _removedColumn) src.destroy(i, location.row);
+				else src.relocate(i, location.row, dst.at(dst.findColumn(src.type(i).id), row));
+			}
+			removeRow(src, location.row);
+			m_locations[_key] = Location{ _target, static_cast<Key>(row) };
+		}
+
+		// Fill the hole at _row with the last row, the components at _row have to be
+		// destroyed or moved already.
+		void removeRow(Archetype& _archetype, size_t _row)
+		{
+			const size_t last = _archetype.size() - 1;
+			if (_row != last)
+			{
+				for (size_t i = 0; i < _archetype.numColumns(); ++i)
+					_archetype.relocate(i, last, _archetype.at(i, _row));
+				const Key movedKey = _archetype.key(last);
+				_archetype.key(_row) = movedKey;
+				m_locations[movedKey].row = static_cast<Key>(_row);
+			}
+			_archetype.popRow();
+		}
+
+		uint32_t addTransition(uint32_t _archetype, const details::ComponentType& _type)
+		{
+			for (const auto& edge : m_archetypes[_archetype]->edges)
+				if (edge.add && edge.typeId == _type.id) return edge.target;
+
+			std::vector<details::ComponentType> types = m_archetypes[_archetype]->types();
+			types.insert(std::upper_bound(types.begin(), types.end(), _type,
+				[](const details::ComponentType& a, const details::ComponentType& b) { return a.id < b.id; }), _type);
+			const uint32_t target = findArchetype(std::move(types));
+			m_archetypes[_archetype]->edges.push_back({ _type.id, true, target });
+			return target;
+		}
+
+		uint32_t removeTransition(uint32_t _archetype, int _typeId)
+		{
+			for (const auto& edge : m_archetypes[_archetype]->edges)
+				if (!edge.add && edge.typeId == _typeId) return edge.target;
+
+			std::vector<details::ComponentType> types = m_archetypes[_archetype]->types();
+			std::erase_if(types, [&](const details::ComponentType& _type) { return _type.id == _typeId; });
+			const uint32_t target = findArchetype(std::move(types));
+			m_archetypes[_archetype]->edges.push_back({ _typeId, false, target });
+			return target;
+		}
+
+		// Index of the archetype with exactly _types, which is created if necessary.
+		// Only called for transitions which are not cached yet.
+		uint32_t findArchetype(std::vector<details::ComponentType> _types)
+		{
+			for (uint32_t i = 0; i < m_archetypes.size(); ++i)
+				if (m_archetypes[i]->sameTypes(_types)) return i;
+			m_archetypes.push_back(std::make_unique<Archetype>(std::move(_types)));
+			return static_cast<uint32_t>(m_archetypes.size() - 1);
+		}
+
+		template<typename... Components, typename Func, size_t... Is>
+		static void iterateChunk(Func& _func, const Key* _keys, char* _chunk,
+			const std::array<size_t, sizeof...(Components)>& _offsets, size_t _count, std::index_sequence<Is...>)
+		{
+			const std::tuple<Components*...> columns{ reinterpret_cast<Components*>(_chunk + _offsets[Is])... };
+			for (size_t row = 0; row < _count; ++row)
+				_func(_keys[row], std::get<Is>(columns)[row]...);
+		}
+
+		// archetypes are never removed, so indices into this stay valid
+		std::vector<std::unique_ptr<Archetype>> m_archetypes;
+		std::vector<Location> m_locations;
+		size_t m_size = 0;
+	};
+}
@@ -0,0 +1,214 @@
+#pragma once
+
+#include "hashmap.hpp"
+#include <shared_mutex>
+#include <mutex>
+#include <optional>
+#include <array>
+#include <vector>
+#include <future>
+
+namespace utils {
+
+/// Thread safe hash map which is split into NumShards independent HashMaps.
+/// \details Each shard is protected by its own reader-writer lock. Lookups only take
+///		a shared lock, so readers never block each other, and writers only block the
+///		shard their key falls into. Since the underlying maps move elements on insertion
+///		and removal, no handles or references are returned. Lookups return copies instead,
+///		which makes this map best suited for small values like resource handles.
+/// \tparam NumShards Number of independent shards, must be a power of two.
+template<typename K, typename T, typename Hash = std::hash<K>, typename Compare = std::equal_to<K>,
+	typename Layout = OddCapacityLayout, uint32_t NumShards = 16>
+class ConcurrentHashMap
+{
+	static_assert(std::has_single_bit(NumShards), "NumShards must be a power of two.");
+	using Map = HashMap<K, T, Hash, Compare, Layout>;
+public:
+	explicit ConcurrentHashMap(uint32_t _expectedElementCount = 15)
+	{
+		for(Shard& shard : m_shards)
+			shard.map.reserve(_expectedElementCount / NumShards + 1);
+	}
+
+	// Add an element to the map.
+	// Overwrites the current value if the key already exists.
+	template<class KeyT, class DataT>
+		requires (std::is_same_v<std::remove_cvref_t<KeyT>, K>)
+	void add(KeyT&& _key, DataT&& _data)
+	{
+		const size_t h = m_hash(_key);
+		add(std::forward<KeyT>(_key), std::forward<DataT>(_data), h);
+	}
+
+	// Version of add() with a precomputed hash _hash == Hash()(_key).
+	template<class KeyT, class DataT>
+		requires (std::is_same_v<std::remove_cvref_t<KeyT>, K>)
+	void add(KeyT&& _key, DataT&& _data, size_t _hash)
+	{
+		Shard& shard = getShard(_hash);
+		std::unique_lock lock(shard.mutex);
+		shard.map.add(std::forward<KeyT>(_key), std::forward<DataT>(_data), _hash);
+	}
+
+	// Remove an element if it exists.
+	void remove(const K& _key)
+	{
+		Shard& shard = getShard(m_hash(_key));
+		std::unique_lock lock(shard.mutex);
+		shard.map.remove(_key);
+	}
+
+	// Returns a copy of the element if it exists.
+	template<typename KeyT>
+		requires (std::is_same_v<KeyT, K> || transparent_lookup<Hash, Compare>)
+	std::optional<T> find(const KeyT& _key) const
+	{
+		return find(_key, m_hash(_key));
+	}
+
+	// Lookup with a precomputed hash _hash == Hash()(_key).
+	template<typename KeyT>
+		requires (std::is_same_v<KeyT, K> || transparent_lookup<Hash, Compare>)
+	std::optional<T> find(const KeyT& _key, size_t _hash) const
+	{
+		const Shard& shard = getShard(_hash);
+		std::shared_lock lock(shard.mutex);
+		auto hndl = shard.map.find(_key, _hash);
+		if(hndl) return hndl.data();
+		return std::nullopt;
+	}
+
+	// Returns the element for _key or adds the result of _create() if it does not exist yet.
+	// _create is called at most once per key, even if multiple threads request the same
+	// key concurrently; these threads wait for the result. _create runs without holding
+	// a lock, so it may use the map itself, except for requesting the same key again.
+	// If _create throws, the exception is passed to all waiting threads.
+	template<typename KeyT, typename CreateFn>
+		requires (std::is_same_v<KeyT, K> || transparent_lookup<Hash, Compare>)
+	T findOrAdd(const KeyT& _key, size_t _hash, CreateFn&& _create)
+	{
+		Shard& shard = getShard(_hash);
+		{
+			std::shared_lock lock(shard.mutex);
+			auto hndl = shard.map.find(_key, _hash);
+			if(hndl) return hndl.data();
+		}
+
+		std::promise<T> promise;
+		{
+			std::unique_lock lock(shard.mutex);
+			// Another thread might have added the element between the two locks.
+			auto hndl = shard.map.find(_key, _hash);
+			if(hndl) return hndl.data();
+
+			// or is still creating it
+			for(const Pending& pending : shard.pending)
+				if(pending.hash == _hash && m_compare(pending.key, _key))
+				{
+					std::shared_future<T> result = pending.result;
+					lock.unlock();
+					return result.get();
+				}
+			shard.pending.push_back({ K(_key), _hash, promise.get_future().share() });
+		}
+
+		std::optional<T> value;
+		try {
+			value.emplace(_create());
+		}
+		catch(...)
+		{
+			{
+				std::unique_lock lock(shard.mutex);
+				removePending(shard, _key, _hash);
+			}
+			promise.set_exception(std::current_exception());
+			throw;
+		}
+
+		{
+			std::unique_lock lock(shard.mutex);
+			shard.map.add(K(_key), *value, _hash);
+			removePending(shard, _key, _hash);
+		}
+		promise.set_value(*value);
+		return std::move(*value);
+	}
+
+	// Call _func(key, data) for all elements. Locks one shard at a time, so the
+	// result is not a consistent snapshot if other threads modify the map concurrently.
+	template<typename Func>
+	void forEach(Func&& _func) const
+	{
+		for(const Shard& shard : m_shards)
+		{
+			std::shared_lock lock(shard.mutex);
+			for(auto it : shard.map)
+				_func(it.key(), it.data());
+		}
+	}
+
+	void clear()
+	{
+		for(Shard& shard : m_shards)
+		{
+			std::unique_lock lock(shard.mutex);
+			shard.map.clear();
+		}
+	}
+
+	// The current number of elements. Only a snapshot if other threads modify the map.
+	uint32_t size() const
+	{
+		uint32_t count = 0;
+		for(const Shard& shard : m_shards)
+		{
+			std::shared_lock lock(shard.mutex);
+			count += shard.map.size();
+		}
+		return count;
+	}
+
+private:
+	// A key whose element is currently created by findOrAdd().
+	struct Pending
+	{
+		K key;
+		size_t hash;
+		std::shared_future<T> result;
+	};
+
+	// Each shard gets its own cache lines to avoid false sharing between the locks.
+	struct alignas(64) Shard
+	{
+		mutable std::shared_mutex mutex;
+		Map map;
+		std::vector<Pending> pending;
+	};
+
+	// The shard has to be locked exclusively.
+	template<typename KeyT>
+	void removePending(Shard& _shard, const KeyT& _key, size_t _hash)
+	{
+		std::erase_if(_shard.pending, [&](const Pending& _pending)
+			{
+				return _pending.hash == _hash && m_compare(_pending.key, _key);
+			});
+	}
+
+	// Fold the upper half into the shard index, so that keys which only differ in the
+	// upper bits of their hash are still distributed over all shards.
+	Shard& getShard(size_t _hash) { return m_shards[shardIndex(_hash)]; }
+	const Shard& getShard(size_t _hash) const { return m_shards[shardIndex(_hash)]; }
+	static uint32_t shardIndex(size_t _hash)
+	{
+		const uint32_t h = static_cast<uint32_t>(_hash);
+		return (h ^ (h >> 16)) & (NumShards - 1);
+	}
+
+	std::array<Shard, NumShards> m_shards;
+	Hash m_hash;
+	Compare m_compare;
+};
+
+} // namespace utils
@@ -0,0 +1,140 @@
+#pragma once
+
+#include "slotindex.hpp"
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <utility>
+#include <concepts>
+#include <span>
+#include <type_traits>
+#include <cstdint>
+
+namespace utils {
+
+	// Records structural changes (emplace, erase) of a SlotMap or WeakSlotMap to apply
+	// them later in one batch, e.g. while the map is being iterated. Recording is thread
+	// safe: every thread writes into its own buffer. The buffers keep their memory
+	// between batches, so recording does not allocate in the steady state.
+	// apply() removes all erased keys first (see eraseBatch()) and then adds the new
+	// elements after a single reserve(). Keys and values are recorded in separate arrays,
+	// so trivially copyable values are added with one emplaceRange() per thread without
+	// gathering them first. Emplaces of existing keys keep the existing value, as with a
+	// direct emplace(). If the same key is emplaced more than once, the first emplace of a
+	// thread wins over its later ones, but between different threads the order is unspecified.
+	template<std::integral Key, std::movable Value>
+	class DeferredCommands
+	{
+	public:
+		DeferredCommands() : m_id(s_nextId++) {}
+		DeferredCommands(const DeferredCommands&) = delete;
+		DeferredCommands& operator=(const DeferredCommands&) = delete;
+
+		template<typename... Args>
+		void emplace(Key _key, Args&&... _args)
+		{
+			Buffer& buffer = local();
+			buffer.emplaceKeys.push_back(_key);
+			buffer.emplaceValues.emplace_back(std::forward<Args>(_args)...);
+		}
+
+		void erase(Key _key)
+		{
+			local().erases.push_back(_key);
+		}
+
+		// Apply and clear all recorded commands.
+		// Must not run concurrently with any recording.
+		template<typename Map>
+		void apply(Map& _map)
+		{
+			// with a single recording thread its buffer can be sorted directly
+			if (m_buffers.size() == 1)
+				_map.eraseBatch(std::span<Key>(m_buffers.front()->erases));
+			else
+			{
+				m_erases.clear();
+				for (auto& buffer : m_buffers)
+					m_erases.insert(m_erases.end(), buffer->erases.begin(), buffer->erases.end());
+				_map.eraseBatch(std::span<Key>(m_erases));
+			}
+
+			size_t numEmplaces = 0;
+			for (auto& buffer : m_buffers)
+				numEmplaces += buffer->emplaceKeys.size();
+			_map.reserve(static_cast<decltype(_map.size())>(_map.size() + numEmplaces));
+			for (auto& buffer : m_buffers)
+			{
+				// emplaceRange() copies, other values are cheaper to move one by one
+				if constexpr (std::is_trivially_copyable_v<Value>)
+					_map.emplaceRange(std::span<const Key>(buffer->emplaceKeys), std::span<const Value>(buffer->emplaceValues));
+				else
+				{
+					for (size_t i = 0; i < buffer->emplaceKeys.size(); ++i)
+						_map.template emplace<Value>(buffer->emplaceKeys[i], std::move(buffer->emplaceValues[i]));
+				}
+				buffer->erases.clear();
+				buffer->emplaceKeys.clear();
+				buffer->emplaceValues.clear();
+			}
+		}
+
+		// Number of recorded commands.
+		// Must not run concurrently with any recording.
+		size_t size() const
+		{
+			size_t num = 0;
+			for (const auto& buffer : m_buffers)
+				num += buffer->erases.size() + buffer->emplaceKeys.size();
+			return num;
+		}
+		bool empty() const { return size() == 0; }
+
+	private:
+		struct Buffer
+		{
+			std::thread::id thread;
+			std::vector<Key> erases;
+			std::vector<Key> emplaceKeys;
+			std::vector<Value> emplaceValues;
+		};
+
+		// Buffer of the calling thread. The last used buffer is cached per thread,
+		// so the lock is only taken when a thread switches between command buffers.
+		Buffer& local()
+		{
+			struct Cache
+			{
+				uint64_t owner = 0;
+				Buffer* buffer = nullptr;
+			};
+			thread_local Cache cache;
+			if (cache.owner == m_id) return *cache.buffer;
+
+			std::lock_guard lock(m_mutex);
+			const std::thread::id thread = std::this_thread::get_id();
+			auto it = std::find_if(m_buffers.begin(), m_buffers.end(),
+				[&](const std::unique_ptr<Buffer>& _buffer) { return _buffer->thread == thread; });
+			if (it == m_buffers.end())
+			{
+				m_buffers.push_back(std::make_unique<Buffer>());
+				m_buffers.back()->thread = thread;
+				it = m_buffers.end() - 1;
+			}
+			cache = Cache{ m_id, it->get() };
+			return **it;
+		}
+
+		// unique id instead of the address which could be reused by another instance
+		inline static std::atomic<uint64_t> s_nextId = 1;
+		const uint64_t m_id;
+
+		std::mutex m_mutex;
+		std::vector<std::unique_ptr<Buffer>> m_buffers;
+		// gathered erases of all threads
+		std::vector<Key> m_erases;
+	};
+}
@@ -0,0 +1,384 @@
+#pragma once
+
+#include "hashmap.hpp"
+#include <vector>
+#include <span>
+#include <utility>
+#include <memory>
+#include <new>
+
+namespace utils {
+
+namespace details {
+	// Growable array like std::vector<T>, but without the packed specialization for bool,
+	// so references and spans to the elements work for every T.
+	template<typename T>
+	class DenseArray
+	{
+	public:
+		DenseArray() = default;
+		DenseArray(const DenseArray& _other)
+		{
+			reserve(_other.m_size);
+			for(uint32_t i = 0; i < _other.m_size; ++i)
+				emplace_back(_other.m_data[i]);
+		}
+		DenseArray(DenseArray&& _other) noexcept :
+			m_data(std::exchange(_other.m_data, nullptr)),
+			m_size(std::exchange(_other.m_size, 0)),
+			m_capacity(std::exchange(_other.m_capacity, 0))
+		{}
+		DenseArray& operator=(DenseArray _other) noexcept
+		{
+			std::swap(m_data, _other.m_data);
+			std::swap(m_size, _other.m_size);
+			std::swap(m_capacity, _other.m_capacity);
+			return *this;
+		}
+		~DenseArray()
+		{
+			clear();
+			deallocate(m_data);
+		}
+
+		T& operator[](uint32_t _idx) { return m_data[_idx]; }
+		const T& operator[](uint32_t _idx) const { return m_data[_idx]; }
+		T* data() { return m_data; }
+		const T* data() const { return m_data; }
+		uint32_t size() const { return m_size; }
+
+		void reserve(uint32_t _capacity)
+		{
+			if(_capacity <= m_capacity) return;
+			T* data = static_cast<T*>(::operator new(sizeof(T) * _capacity, std::align_val_t(alignof(T))));
+			std::uninitialized_move_n(m_data, m_size, data);
+			std::destroy_n(m_data, m_size);
+			deallocate(m_data);
+			m_data = data;
+			m_capacity = _capacity;
+		}
+
+		template<typename... Args>
+		void emplace_back(Args&&... _args)
+		{
+			if(m_size == m_capacity)
+				reserve(m_capacity ? m_capacity * 2 : 4);
+			std::construct_at(m_data + m_size, std::forward<Args>(_args)...);
+			++m_size;
+		}
+
+		void pop_back() { std::destroy_at(m_data + --m_size); }
+
+		void clear()
+		{
+			std::destroy_n(m_data, m_size);
+			m_size = 0;
+		}
+
+	private:
+		static void deallocate(T* _data)
+		{
+			if(_data) ::operator delete(_data, std::align_val_t(alignof(T)));
+		}
+
+		T* m_data = nullptr;
+		uint32_t m_size = 0;
+		uint32_t m_capacity = 0;
+	};
+}
+
+/// Hash map with the HashMap interface which stores keys and values densely.
+/// \details Elements live in insertion order in contiguous arrays. A separate power of
+///		two index table with robin hood probing maps hashes to positions in these arrays.
+///		Iteration only touches live elements and values() can be processed in bulk.
+///		remove() moves the last element into the gap (swap-remove), so it changes the
+///		order of the remaining elements and invalidates handles to the last element.
+template<typename K, typename T, typename Hash = std::hash<K>, typename Compare = std::equal_to<K>>
+class DenseHashMap
+{
+public:
+	/// Handles are indices into the dense arrays.
+	/// Any add or remove in the map may invalidate the handle without notification.
+	template<typename MapT, typename DataT>
+	class HandleT
+	{
+		MapT* map;
+		uint32_t idx;
+
+		HandleT(MapT* _map, uint32_t _idx = 0) :
+			map(_map && _idx < _map->size() ? _map : nullptr),
+			idx(map ? _idx : 0)
+		{}
+
+		friend DenseHashMap;
+	public:
+		const K& key() const { return map->m_keys[idx]; }
+
+		DataT& data() const { return map->m_values[idx]; }
+
+		operator bool () const { return map != nullptr; }
+
+		HandleT& operator ++ ()
+		{
+			if(++idx >= map->size()) { idx = 0; map = nullptr; }
+			return *this;
+		}
+
+		bool operator == (const HandleT& _other) const { return map == _other.map && idx == _other.idx; }
+		bool operator != (const HandleT& _other) const { return map != _other.map || idx != _other.idx; }
+
+		// The dereference operator has no function other than making this handle compatible
+		// for range based loops.
+		const HandleT& operator * () const { return *this; }
+	};
+
+	typedef HandleT<DenseHashMap, T> Handle;
+	typedef HandleT<const DenseHashMap, const T> ConstHandle;
+
+	explicit DenseHashMap(uint32_t _expectedElementCount = 15)
+	{
+		reserve(_expectedElementCount);
+	}
+
+	// Add an element to the map.
+	// Overwrites the current value if the key already exists.
+	template<class KeyT, class DataT>
+		requires (std::is_same_v<std::remove_cvref_t<KeyT>, K>)
+	Handle add(KeyT&& _key, DataT&& _data)
+	{
+		const size_t h = m_hash(_key);
+		return add(std::forward<KeyT>(_key), std::forward<DataT>(_data), h);
+	}
+
+	// Version of add() with a precomputed hash _hash == Hash()(_key).
+	template<class KeyT, class DataT>
+		requires (std::is_same_v<std::remove_cvref_t<KeyT>, K>)
+	Handle add(KeyT&& _key, DataT&& _data, size_t _hash)
+	{
+		const uint32_t h = static_cast<uint32_t>(_hash);
+		const uint32_t idx = findIndex(_key, h);
+		if(idx != INVALID_INDEX)
+		{
+			m_values[idx] = std::forward<DataT>(_data);
+			return Handle(this, idx);
+		}
+
+		return Handle(this, insertNew(std::forward<KeyT>(_key), std::forward<DataT>(_data), h));
+	}
+
+	// Remove an element if it exists
+	void remove(const K& _key)
+	{
+		remove(find(_key));
+	}
+
+	// Remove an existing element. The last element is moved into its place.
+	void remove(const Handle& _element)
+	{
+		if(!_element) return;
+
+		const uint32_t idx = _element.idx;
+		eraseSlot(findSlot(m_hashes[idx], idx));
+
+		const uint32_t last = size() - 1;
+		if(idx != last)
+		{
+			// Redirect the slot of the last element to its new position.
+			m_slots[findSlot(m_hashes[last], last)].index = idx;
+			m_keys[idx] = std::move(m_keys[last]);
+			m_values[idx] = std::move(m_values[last]);
+			m_hashes[idx] = m_hashes[last];
+		}
+		m_keys.pop_back();
+		m_values.pop_back();
+		m_hashes.pop_back();
+	}
+
+	Handle find(const K& _key) noexcept
+	{
+		return Handle(this, findIndex(_key, static_cast<uint32_t>(m_hash(_key))));
+	}
+	ConstHandle find(const K& _key) const noexcept
+	{
+		return ConstHandle(this, findIndex(_key, static_cast<uint32_t>(m_hash(_key))));
+	}
+
+	// Heterogeneous lookup, e.g. with a std::string_view for std::string keys.
+	// Requires that Hash and Compare both define is_transparent and accept KeyT.
+	template<typename KeyT>
+		requires transparent_lookup<Hash, Compare>
+	Handle find(const KeyT& _key) noexcept
+	{
+		return find(_key, m_hash(_key));
+	}
+	template<typename KeyT>
+		requires transparent_lookup<Hash, Compare>
+	ConstHandle find(const KeyT& _key) const noexcept
+	{
+		return find(_key, m_hash(_key));
+	}
+
+	// Lookup with a precomputed hash _hash == Hash()(_key).
+	template<typename KeyT>
+		requires (std::is_same_v<KeyT, K> || transparent_lookup<Hash, Compare>)
+	Handle find(const KeyT& _key, size_t _hash) noexcept
+	{
+		return Handle(this, findIndex(_key, static_cast<uint32_t>(_hash)));
+	}
+	template<typename KeyT>
+		requires (std::is_same_v<KeyT, K> || transparent_lookup<Hash, Compare>)
+	ConstHandle find(const KeyT& _key, size_t _hash) const noexcept
+	{
+		return ConstHandle(this, findIndex(_key, static_cast<uint32_t>(_hash)));
+	}
+
+	/// Get access to an element. If it was not in the map before it will be added with default construction.
+	T& operator [] (const K& _key)
+		requires std::is_default_constructible_v<T>
+	{
+		const uint32_t h = static_cast<uint32_t>(m_hash(_key));
+		uint32_t idx = findIndex(_key, h);
+		if(idx == INVALID_INDEX)
+			idx = insertNew(_key, T(), h);
+		return m_values[idx];
+	}
+
+	// Reserve space for _exptectedElementCount elements in the dense arrays and the index table.
+	void reserve(uint32_t _exptectedElementCount)
+	{
+		m_keys.reserve(_exptectedElementCount);
+		m_values.reserve(_exptectedElementCount);
+		m_hashes.reserve(_exptectedElementCount);
+		const uint32_t capacity = PowerOfTwoLayout::capacity(_exptectedElementCount + _exptectedElementCount / 4 + 1);
+		if(capacity > m_slots.size())
+			rebuildSlots(capacity);
+	}
+
+	/// Remove all elements from the map but keep the capacity.
+	void clear()
+	{
+		m_keys.clear();
+		m_values.clear();
+		m_hashes.clear();
+		for(Slot& slot : m_slots)
+			slot.index = INVALID_INDEX;
+	}
+
+	uint32_t size() const { return static_cast<uint32_t>(m_keys.size()); }
+
+	// Direct access to the dense arrays. Element i of both belongs together.
+	std::span<const K> keys() const { return m_keys; }
+	std::span<T> values() { return { m_values.data(), m_values.size() }; }
+	std::span<const T> values() const { return { m_values.data(), m_values.size() }; }
+
+	/// Iteration in insertion order (as long as nothing was removed).
+	Handle begin() { return Handle(this, 0); }
+	ConstHandle begin() const { return ConstHandle(this, 0); }
+
+	/// Return the invalid handle for range based for loops
+	Handle end() { return Handle(nullptr); }
+	ConstHandle end() const { return ConstHandle(nullptr); }
+
+private:
+	static constexpr uint32_t INVALID_INDEX = ~0u;
+
+	// Entry of the index table. The hash is duplicated to skip key compares
+	// and to compute the probing distance without touching the dense arrays.
+	struct Slot
+	{
+		uint32_t index;
+		uint32_t hash;
+	};
+
+	std::vector<Slot> m_slots;
+	std::vector<K> m_keys;
+	details::DenseArray<T> m_values;
+	std::vector<uint32_t> m_hashes;
+	Hash m_hash;
+	Compare m_keyCompare;
+
+	uint32_t mask() const { return static_cast<uint32_t>(m_slots.size()) - 1; }
+	uint32_t homeSlot(uint32_t _hash) const { return PowerOfTwoLayout::index(_hash, static_cast<uint32_t>(m_slots.size())); }
+	uint32_t distance(uint32_t _slot) const { return (_slot - homeSlot(m_slots[_slot].hash)) & mask(); }
+
+	template<typename KeyT>
+	uint32_t findIndex(const KeyT& _key, uint32_t _hash) const noexcept
+	{
+		uint32_t pos = homeSlot(_hash);
+		for(uint32_t d = 0; m_slots[pos].index != INVALID_INDEX && d <= distance(pos); ++d)
+		{
+			const Slot& slot = m_slots[pos];
+			if(slot.hash == _hash && m_keyCompare(m_keys[slot.index], _key))
+				return slot.index;
+			pos = (pos + 1) & mask();
+		}
+		return INVALID_INDEX;
+	}
+
+	// Slot which refers to the element _index.
+	uint32_t findSlot(uint32_t _hash, uint32_t _index) const
+	{
+		uint32_t pos = homeSlot(_hash);
+		while(m_slots[pos].index != _index)
+			pos = (pos + 1) & mask();
+		return pos;
+	}
+
+	// Append an element which is known not to be in the map yet.
+	template<class KeyT, class DataT>
+	uint32_t insertNew(KeyT&& _key, DataT&& _data, uint32_t _hash)
+	{
+		// keep the load factor of the index table below 7/8
+		if((size() + 1) * 8 > m_slots.size() * 7)
+			rebuildSlots(static_cast<uint32_t>(m_slots.size()) * 2);
+
+		const uint32_t idx = size();
+		m_keys.emplace_back(std::forward<KeyT>(_key));
+		m_values.emplace_back(std::forward<DataT>(_data));
+		m_hashes.push_back(_hash);
+		insertSlot({idx, _hash});
+		return idx;
+	}
+
+	void insertSlot(Slot _slot)
+	{
+		uint32_t pos = homeSlot(_slot.hash);
+		uint32_t d = 0;
+		while(m_slots[pos].index != INVALID_INDEX)
+		{
+			// robin hood: take the place of elements which are closer to their home
+			const uint32_t otherDist = distance(pos);
+			if(otherDist < d)
+			{
+				std::swap(_slot, m_slots[pos]);
+				d = otherDist;
+			}
+			pos = (pos + 1) & mask();
+			++d;
+		}
+		m_slots[pos] = _slot;
+	}
+
+	// Backward shift deletion, no tombstones required.
+	void eraseSlot(uint32_t _pos)
+	{
+		uint32_t next = (_pos + 1) & mask();
+		while(m_slots[next].index != INVALID_INDEX && distance(next) != 0)
+		{
+			m_slots[_pos] = m_slots[next];
+			_pos = next;
+			next = (next + 1) & mask();
+		}
+		m_slots[_pos].index = INVALID_INDEX;
+	}
+
+	// Recreate the index table from the stored hashes without calling the hash function.
+	void rebuildSlots(uint32_t _capacity)
+	{
+		m_slots.assign(PowerOfTwoLayout::capacity(_capacity), Slot{INVALID_INDEX, 0});
+		for(uint32_t i = 0; i < size(); ++i)
+			insertSlot({i, m_hashes[i]});
+	}
+};
+
+} // namespace utils
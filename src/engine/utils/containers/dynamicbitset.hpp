@@ -0,0 +1,111 @@
+#pragma once
+
+#include "../../utils/assert.hpp"
+#include <vector>
+#include <algorithm>
+#include <span>
+#include <bit>
+#include <cstdint>
+#include <cstddef>
+
+namespace utils {
+
+	/// Resizable bitset which can enumerate the set bits one word at a time.
+	class DynamicBitset
+	{
+	public:
+		using Word = uint64_t;
+		constexpr static size_t BITS_PER_WORD = 64;
+
+		DynamicBitset() = default;
+		explicit DynamicBitset(size_t _size, bool _value = false) { resize(_size, _value); }
+
+		size_t size() const { return m_size; }
+
+		// New bits are initialized with _value.
+		void resize(size_t _size, bool _value = false)
+		{
+			const size_t oldSize = m_size;
+			m_words.resize((_size + BITS_PER_WORD - 1) / BITS_PER_WORD, _value ? ~Word(0) : 0);
+			m_size = _size;
+			// remaining bits in the previously last word
+			for (size_t i = oldSize; i < std::min(_size, numFullBits(oldSize)); ++i)
+				set(i, _value);
+			clearUnusedBits();
+		}
+
+		void pushBack(bool _value)
+		{
+			if (m_size % BITS_PER_WORD == 0) m_words.push_back(0);
+			++m_size;
+			set(m_size - 1, _value);
+		}
+
+		void popBack()
+		{
+			ASSERT(m_size > 0, "Trying to remove a bit from an empty bitset.");
+			reset(--m_size);
+			if (m_size % BITS_PER_WORD == 0) m_words.pop_back();
+		}
+
+		bool test(size_t _ind) const { return (m_words[_ind / BITS_PER_WORD] >> (_ind % BITS_PER_WORD)) & 1; }
+		void set(size_t _ind) { m_words[_ind / BITS_PER_WORD] |= Word(1) << (_ind % BITS_PER_WORD); }
+		void reset(size_t _ind) { m_words[_ind / BITS_PER_WORD] &= ~(Word(1) << (_ind % BITS_PER_WORD)); }
+		void set(size_t _ind, bool _value) { _value ? set(_ind) : reset(_ind); }
+
+		// Set all bits to _value without changing the size.
+		void fill(bool _value)
+		{
+			std::fill(m_words.begin(), m_words.end(), _value ? ~Word(0) : 0);
+			clearUnusedBits();
+		}
+
+		size_t count() const
+		{
+			size_t num = 0;
+			for (Word word : m_words)
+				num += std::popcount(word);
+			return num;
+		}
+
+		bool any() const
+		{
+			for (Word word : m_words)
+				if (word) return true;
+			return false;
+		}
+
+		// Call _func(size_t) for the index of every set bit in ascending order.
+		// Empty words are skipped with a single compare.
+		template<typename Func>
+		void forEachSet(Func&& _func) const
+		{
+			for (size_t w = 0; w < m_words.size(); ++w)
+			{
+				for (Word word = m_words[w]; word; word &= word - 1)
+					_func(w * BITS_PER_WORD + std::countr_zero(word));
+			}
+		}
+
+		std::span<const Word> words() const { return m_words; }
+		// Bulk access to the words, bits beyond size() have to stay 0.
+		std::span<Word> words() { return m_words; }
+	private:
+		static size_t numFullBits(size_t _size) { return (_size + BITS_PER_WORD - 1) / BITS_PER_WORD * BITS_PER_WORD; }
+
+		// Bits beyond size() are always 0 so that whole words can be processed.
+		void clearUnusedBits()
+		{
+			if (m_size % BITS_PER_WORD)
+				m_words.back() &= (Word(1) << (m_size % BITS_PER_WORD)) - 1;
+		}
+
+		std::vector<Word> m_words;
+		size_t m_size = 0;
+	};
+
+	namespace details {
+		// Placeholder for the change tracking bits of containers which do not track changes.
+		struct NoChangeTracking {};
+	}
+}
@@ -0,0 +1,515 @@
+#pragma once
+
+#include "hashmap.hpp"
+#include <cinttypes>
+#include <cstdlib>
+#include <cstring>
+#include <type_traits>
+#include <functional>
+#include <concepts>
+#include <bit>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define ACA_CONTROL_GROUP_SSE2
+#endif
+
+namespace utils {
+
+namespace details {
+	// States of a control byte in the FlatHashMap.
+	// Full slots store the 7 bit hash fragment instead, so the sign bit marks free slots.
+	enum ControlByte : int8_t
+	{
+		CTRL_EMPTY = -128,
+		CTRL_DELETED = -2
+	};
+
+	// A window of consecutive control bytes which is tested with a single compare.
+	// All match functions return a bitmask with one bit per slot in the window.
+	struct ControlGroup
+	{
+#if defined(__AVX2__)
+		static constexpr uint32_t WIDTH = 32;
+
+		explicit ControlGroup(const int8_t* _ctrl)
+			: ctrl(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(_ctrl)))
+		{}
+
+		uint32_t match(int8_t _h2) const
+		{
+			return static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_set1_epi8(_h2), ctrl)));
+		}
+		uint32_t matchEmpty() const { return match(CTRL_EMPTY); }
+		uint32_t matchEmptyOrDeleted() const { return static_cast<uint32_t>(_mm256_movemask_epi8(ctrl)); }
+
+		__m256i ctrl;
+#elif defined(ACA_CONTROL_GROUP_SSE2)
+		static constexpr uint32_t WIDTH = 16;
+
+		explicit ControlGroup(const int8_t* _ctrl)
+			: ctrl(_mm_loadu_si128(reinterpret_cast<const __m128i*>(_ctrl)))
+		{}
+
+		uint32_t match(int8_t _h2) const
+		{
+			return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(_h2), ctrl)));
+		}
+		uint32_t matchEmpty() const { return match(CTRL_EMPTY); }
+		uint32_t matchEmptyOrDeleted() const { return static_cast<uint32_t>(_mm_movemask_epi8(ctrl)); }
+
+		__m128i ctrl;
+#else
+		// Portable fallback with the same interface.
+		static constexpr uint32_t WIDTH = 16;
+
+		explicit ControlGroup(const int8_t* _ctrl) : ctrl(_ctrl) {}
+
+		uint32_t match(int8_t _h2) const
+		{
+			uint32_t mask = 0;
+			for (uint32_t i = 0; i < WIDTH; ++i)
+				mask |= static_cast<uint32_t>(ctrl[i] == _h2) << i;
+			return mask;
+		}
+		uint32_t matchEmpty() const { return match(CTRL_EMPTY); }
+		uint32_t matchEmptyOrDeleted() const
+		{
+			uint32_t mask = 0;
+			for (uint32_t i = 0; i < WIDTH; ++i)
+				mask |= static_cast<uint32_t>(ctrl[i] < 0) << i;
+			return mask;
+		}
+
+		const int8_t* ctrl;
+#endif
+	};
+}
+
+/// Hash map with the same interface as HashMap but a different probing engine.
+/// \details Next to the key/data slots a separate array of 1-byte control tags is kept.
+///		Each tag holds 7 bits of the hash or an empty/deleted marker. Lookups test
+///		a whole ControlGroup of tags with one SIMD compare and only call the key comparator
+///		on tag matches. Prefer this map for lookup heavy workloads, in particular
+///		with expensive key compares (e.g. strings).
+template<typename K, typename T, typename Hash = std::hash<K>, typename Compare = std::equal_to<K>>
+class FlatHashMap
+{
+	using Group = details::ControlGroup;
+public:
+	/// Handles are direct accesses into a specific hashmap.
+	/// Any add or remove in the HM will invalidate the handle without notification.
+	/// A handle might be usable afterwards, but there is no guaranty.
+	template<typename MapT, typename DataT>
+	class HandleT
+	{
+		MapT* map;
+		uint32_t idx;
+
+		HandleT(MapT* _map, uint32_t _idx = 0) :
+			map(_map),
+			idx(_idx)
+		{
+			if(_map)
+			{
+				if(_map->m_size == 0)
+					map = nullptr;
+				else {
+					// Find a valid start value.
+					while(idx < _map->m_capacity && _map->m_ctrl[idx] < 0)
+						++idx;
+				}
+			}
+		}
+
+		friend FlatHashMap;
+	public:
+		const K& key() const { return map->m_slots[idx].key; }
+
+		DataT& data() const { return map->m_slots[idx].data; }
+
+		operator bool () const { return map != nullptr; }
+
+		HandleT& operator ++ ()
+		{
+			++idx;
+			// Move forward while the element is empty or deleted.
+			while((idx < map->m_capacity) && (map->m_ctrl[idx] < 0))
+				++idx;
+			// Set to invalid handle?
+			if(idx >= map->m_capacity) { idx = 0; map = nullptr; }
+			return *this;
+		}
+
+		bool operator == (const HandleT& _other) const { return map == _other.map && idx == _other.idx; }
+		bool operator != (const HandleT& _other) const { return map != _other.map || idx != _other.idx; }
+
+		// The dereference operator has no function other than making this handle compatible
+		// for range based loops.
+		const HandleT& operator * () const { return *this; }
+	};
+
+	typedef HandleT<FlatHashMap, T> Handle;
+	typedef HandleT<const FlatHashMap, const T> ConstHandle;
+
+	explicit FlatHashMap(uint32_t _expectedElementCount = 15) :
+		m_size(0)
+	{
+		allocate(estimateCapacity(_expectedElementCount));
+	}
+
+	FlatHashMap(FlatHashMap&& _other) noexcept :
+		m_capacity(_other.m_capacity),
+		m_size(_other.m_size),
+		m_growthLeft(_other.m_growthLeft),
+		m_ctrl(_other.m_ctrl),
+		m_slots(_other.m_slots)
+	{
+		_other.m_ctrl = nullptr;
+		_other.m_slots = nullptr;
+	}
+
+	FlatHashMap& operator = (FlatHashMap&& _rhs) noexcept
+	{
+		this->~FlatHashMap();
+		m_capacity = _rhs.m_capacity;
+		m_size = _rhs.m_size;
+		m_growthLeft = _rhs.m_growthLeft;
+		m_ctrl = _rhs.m_ctrl;
+		m_slots = _rhs.m_slots;
+		_rhs.m_ctrl = nullptr;
+		_rhs.m_slots = nullptr;
+		return *this;
+	}
+
+	~FlatHashMap()
+	{
+		if(m_ctrl)
+		{
+			destroyElements();
+			AllocTracker::deallocate(AllocTag::HASH_MAP, allocationSize(m_capacity));
+		}
+		free(m_ctrl);
+		free(m_slots);
+	}
+
+	// Add an element to the map.
+	// Overwrites the current value if the key already exists.
+	// KeyT is a template parameter to capture a forwarding reference.
+	template<class KeyT, class DataT>
+		requires (std::is_same_v<std::remove_cvref_t<KeyT>, K>)
+	Handle add(KeyT&& _key, DataT&& _data)
+	{
+		const size_t h = m_hash(_key);
+		return add(std::forward<KeyT>(_key), std::forward<DataT>(_data), h);
+	}
+
+	// Version of add() with a precomputed hash _hash == Hash()(_key).
+	template<class KeyT, class DataT>
+		requires (std::is_same_v<std::remove_cvref_t<KeyT>, K>)
+	Handle add(KeyT&& _key, DataT&& _data, size_t _hash)
+	{
+		const uint64_t h = mix(_hash);
+		uint32_t idx = findIndex(_key, h);
+		if(idx != INVALID_INDEX)
+		{
+			m_slots[idx].data = std::forward<DataT>(_data);
+			return Handle(this, idx);
+		}
+
+		idx = prepareInsert(h);
+		new (&m_slots[idx].key)(K)(std::forward<KeyT>(_key));
+		new (&m_slots[idx].data)(T)(std::forward<DataT>(_data));
+		return Handle(this, idx);
+	}
+
+	// Remove an element if it exists
+	void remove(const K& _key)
+	{
+		remove(find(_key));
+	}
+
+	// Remove an existing element
+	void remove(const Handle& _element)
+	{
+		if(_element)
+		{
+			const uint32_t idx = _element.idx;
+			m_slots[idx].data.~T();
+			m_slots[idx].key.~K();
+			--m_size;
+
+			// If the slot was never part of a full window no probe sequence can have passed
+			// it and it can become empty again. Otherwise a tombstone is required.
+			const uint32_t emptyBefore = Group(m_ctrl + ((idx - Group::WIDTH) & (m_capacity - 1))).matchEmpty();
+			const uint32_t emptyAfter = Group(m_ctrl + idx).matchEmpty();
+			const bool wasNeverFull = emptyBefore && emptyAfter
+				&& static_cast<uint32_t>(std::countr_zero(emptyAfter) + std::countl_zero(emptyBefore) - (32 - Group::WIDTH)) < Group::WIDTH;
+			setCtrl(idx, wasNeverFull ? details::CTRL_EMPTY : details::CTRL_DELETED);
+			if(wasNeverFull) ++m_growthLeft;
+		}
+	}
+
+	Handle find(const K& _key) noexcept
+	{
+		const uint32_t idx = findIndex(_key, hash(_key));
+		return idx != INVALID_INDEX ? Handle(this, idx) : Handle(nullptr, 0);
+	}
+	ConstHandle find(const K& _key) const noexcept
+	{
+		const uint32_t idx = findIndex(_key, hash(_key));
+		return idx != INVALID_INDEX ? ConstHandle(this, idx) : ConstHandle(nullptr, 0);
+	}
+
+	// Heterogeneous lookup, e.g. with a std::string_view for std::string keys.
+	// Requires that Hash and Compare both define is_transparent and accept KeyT.
+	template<typename KeyT>
+		requires transparent_lookup<Hash, Compare>
+	Handle find(const KeyT& _key) noexcept
+	{
+		return find(_key, m_hash(_key));
+	}
+	template<typename KeyT>
+		requires transparent_lookup<Hash, Compare>
+	ConstHandle find(const KeyT& _key) const noexcept
+	{
+		return find(_key, m_hash(_key));
+	}
+
+	// Lookup with a precomputed hash _hash == Hash()(_key).
+	template<typename KeyT>
+		requires (std::is_same_v<KeyT, K> || transparent_lookup<Hash, Compare>)
+	Handle find(const KeyT& _key, size_t _hash) noexcept
+	{
+		const uint32_t idx = findIndex(_key, mix(_hash));
+		return idx != INVALID_INDEX ? Handle(this, idx) : Handle(nullptr, 0);
+	}
+	template<typename KeyT>
+		requires (std::is_same_v<KeyT, K> || transparent_lookup<Hash, Compare>)
+	ConstHandle find(const KeyT& _key, size_t _hash) const noexcept
+	{
+		const uint32_t idx = findIndex(_key, mix(_hash));
+		return idx != INVALID_INDEX ? ConstHandle(this, idx) : ConstHandle(nullptr, 0);
+	}
+
+	/// Get access to an element. If it was not in the map before it will be added with default construction.
+	T& operator [] (const K& _key)
+		requires std::is_default_constructible_v<T>
+	{
+		const uint64_t h = hash(_key);
+		uint32_t idx = findIndex(_key, h);
+		if(idx == INVALID_INDEX)
+		{
+			idx = prepareInsert(h);
+			new (&m_slots[idx].key)(K)(_key);
+			new (&m_slots[idx].data)(T)(); // New default element
+		}
+		return m_slots[idx].data;
+	}
+
+	// Change the capacity if possible. It cannot be decreased below what is required for 'size'.
+	// The capacity is always rounded up to a power of two.
+	void resize(uint32_t _newCapacity)
+	{
+		const uint32_t minCapacity = estimateCapacity(m_size);
+		uint32_t capacity = Group::WIDTH;
+		while(capacity < _newCapacity || capacity < minCapacity)
+			capacity *= 2;
+
+		int8_t* oldCtrl = m_ctrl;
+		Slot* oldSlots = m_slots;
+		const uint32_t oldCapacity = m_capacity;
+		allocate(capacity);
+
+		// Elements are unique and there are no tombstones in the new arrays,
+		// so only a free slot has to be found.
+		for(uint32_t i = 0; i < oldCapacity; ++i)
+		{
+			if(oldCtrl[i] >= 0)
+			{
+				const uint64_t h = hash(oldSlots[i].key);
+				const uint32_t idx = findFirstNonFull(h);
+				setCtrl(idx, H2(h));
+				new (&m_slots[idx].key)(K)(std::move(oldSlots[i].key));
+				new (&m_slots[idx].data)(T)(std::move(oldSlots[i].data));
+				oldSlots[i].key.~K();
+				oldSlots[i].data.~T();
+			}
+		}
+		m_growthLeft -= m_size;
+
+		if(oldCtrl)
+			AllocTracker::deallocate(AllocTag::HASH_MAP, allocationSize(oldCapacity));
+		free(oldCtrl);
+		free(oldSlots);
+	}
+
+	void reserve(uint32_t _exptectedElementCount)
+	{
+		resize(estimateCapacity(_exptectedElementCount));
+	}
+
+	/// Remove all elements from the set but keep the capacity.
+	void clear()
+	{
+		if(m_size > 0)
+			destroyElements();
+		std::memset(m_ctrl, details::CTRL_EMPTY, m_capacity + Group::WIDTH);
+		m_size = 0;
+		m_growthLeft = maxLoad(m_capacity);
+	}
+
+	uint32_t size() const { return m_size; }
+
+	/// Returns the first element found in the map or an invalid handle when the map is empty.
+	Handle begin()
+	{
+		return Handle(this);
+	}
+	ConstHandle begin() const
+	{
+		return ConstHandle(this);
+	}
+
+	/// Return the invalid handle for range based for loops
+	Handle end()
+	{
+		return Handle(nullptr);
+	}
+	ConstHandle end() const
+	{
+		return ConstHandle(nullptr);
+	}
+
+private:
+	static constexpr uint32_t INVALID_INDEX = ~0u;
+
+	uint32_t m_capacity;
+	uint32_t m_size;
+	uint32_t m_growthLeft; // number of empty slots which may still be filled before a resize
+
+	// m_capacity + Group::WIDTH control bytes. The last WIDTH bytes mirror the first ones
+	// so that a group can be loaded at any position without wrapping.
+	int8_t* m_ctrl;
+
+	// Key and data are stored together, since after a tag match both are accessed.
+	struct Slot
+	{
+		K key;
+		T data;
+	};
+
+	Slot* m_slots;
+	Hash m_hash;
+	Compare m_keyCompare;
+
+	// Keep a maximum load factor of 7/8.
+	static uint32_t maxLoad(uint32_t _capacity) { return _capacity - _capacity / 8; }
+
+	static uint32_t estimateCapacity(uint32_t _exptectedElementCount)
+	{
+		uint32_t capacity = Group::WIDTH;
+		while(maxLoad(capacity) < _exptectedElementCount)
+			capacity *= 2;
+		return capacity;
+	}
+
+	// Mix the hash since the probe start (H1) and tag (H2) use different bits and
+	// std::hash is the identity for integers.
+	static uint64_t mix(size_t _hash)
+	{
+		const uint64_t h = static_cast<uint64_t>(_hash) * 0x9e3779b97f4a7c15ull;
+		return h ^ (h >> 32);
+	}
+	uint64_t hash(const K& _key) const { return mix(m_hash(_key)); }
+	static uint32_t H1(uint64_t _hash) { return static_cast<uint32_t>(_hash >> 7); }
+	static int8_t H2(uint64_t _hash) { return static_cast<int8_t>(_hash & 0x7f); }
+
+	void allocate(uint32_t _capacity)
+	{
+		m_capacity = _capacity;
+		m_growthLeft = maxLoad(_capacity);
+		m_ctrl = static_cast<int8_t*>(malloc(m_capacity + Group::WIDTH));
+		m_slots = static_cast<Slot*>(malloc(sizeof(Slot) * m_capacity));
+		std::memset(m_ctrl, details::CTRL_EMPTY, m_capacity + Group::WIDTH);
+		AllocTracker::allocate(AllocTag::HASH_MAP, allocationSize(m_capacity));
+	}
+
+	static size_t allocationSize(uint32_t _capacity) { return _capacity + Group::WIDTH + sizeof(Slot) * _capacity; }
+
+	void destroyElements()
+	{
+		for(uint32_t i = 0; i < m_capacity; ++i)
+			if(m_ctrl[i] >= 0)
+			{
+				m_slots[i].data.~T();
+				m_slots[i].key.~K();
+			}
+	}
+
+	void setCtrl(uint32_t _idx, int8_t _value)
+	{
+		m_ctrl[_idx] = _value;
+		if(_idx < Group::WIDTH)
+			m_ctrl[m_capacity + _idx] = _value;
+	}
+
+	// Probe sequence over groups with triangular steps. Since the capacity is a power of
+	// two multiple of the group width this visits every group.
+	template<typename KeyT>
+	uint32_t findIndex(const KeyT& _key, uint64_t _hash) const
+	{
+		const uint32_t mask = m_capacity - 1;
+		const int8_t h2 = H2(_hash);
+		uint32_t pos = H1(_hash) & mask;
+		for(uint32_t step = Group::WIDTH;; step += Group::WIDTH)
+		{
+			const Group group(m_ctrl + pos);
+			for(uint32_t match = group.match(h2); match; match &= match - 1)
+			{
+				const uint32_t idx = (pos + std::countr_zero(match)) & mask;
+				if(m_keyCompare(m_slots[idx].key, _key))
+					return idx;
+			}
+			// An empty slot terminates every probe sequence that reached it.
+			if(group.matchEmpty())
+				return INVALID_INDEX;
+			pos = (pos + step) & mask;
+		}
+	}
+
+	uint32_t findFirstNonFull(uint64_t _hash) const
+	{
+		const uint32_t mask = m_capacity - 1;
+		uint32_t pos = H1(_hash) & mask;
+		for(uint32_t step = Group::WIDTH;; step += Group::WIDTH)
+		{
+			const uint32_t freeSlots = Group(m_ctrl + pos).matchEmptyOrDeleted();
+			if(freeSlots)
+				return (pos + std::countr_zero(freeSlots)) & mask;
+			pos = (pos + step) & mask;
+		}
+	}
+
+	/// Find a slot for a new element and mark it as full. Resizes if necessary.
+	/// \returns The index of a slot with uninitialized key and data.
+	uint32_t prepareInsert(uint64_t _hash)
+	{
+		uint32_t idx = findFirstNonFull(_hash);
+		if(m_growthLeft == 0 && m_ctrl[idx] == details::CTRL_EMPTY)
+		{
+			// Many tombstones -> cleanup is sufficient, otherwise grow.
+			resize(m_size * 2 < maxLoad(m_capacity) ? m_capacity : m_capacity * 2);
+			idx = findFirstNonFull(_hash);
+		}
+		if(m_ctrl[idx] == details::CTRL_EMPTY)
+			--m_growthLeft;
+		setCtrl(idx, H2(_hash));
+		++m_size;
+		return idx;
+	}
+};
+
+} // namespace utils
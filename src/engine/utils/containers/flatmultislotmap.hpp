@@ -0,0 +1,238 @@
+#pragma once
+
+#include "../../utils/assert.hpp"
+#include "slotindex.hpp"
+#include <vector>
+#include <memory>
+#include <span>
+#include <utility>
+#include <concepts>
+#include <limits>
+
+namespace utils {
+
+	// Allows multiple values for the same Key to be stored like MultiSlotMap, but keeps
+	// all values of a key contiguous. Each key owns a range [begin, begin + capacity) of
+	// one shared buffer. When a range is full it grows in place if it is the last one,
+	// otherwise it is moved to the end with twice the capacity. The holes left behind
+	// are removed by compact(), which also runs automatically when the buffer is full.
+	// Adding values to a key invalidates references to values of this key only,
+	// unless the buffer itself has to grow or is compacted.
+	template<std::integral Key, std::movable Value, typename SlotIndex = DenseSlotIndex<Key>>
+	class FlatMultiSlotMap
+	{
+		constexpr static Key INVALID_SLOT = std::numeric_limits<Key>::max();
+	public:
+		FlatMultiSlotMap() = default;
+		FlatMultiSlotMap(FlatMultiSlotMap&& _oth) noexcept
+			: m_slots(std::move(_oth.m_slots)),
+			m_ranges(std::move(_oth.m_ranges)),
+			m_rangesToSlots(std::move(_oth.m_rangesToSlots)),
+			m_values(std::exchange(_oth.m_values, nullptr)),
+			m_capacity(std::exchange(_oth.m_capacity, 0)),
+			m_end(std::exchange(_oth.m_end, 0)),
+			m_size(std::exchange(_oth.m_size, 0))
+		{}
+
+		FlatMultiSlotMap& operator=(FlatMultiSlotMap&& _oth) noexcept
+		{
+			this->~FlatMultiSlotMap();
+			return *new (this) FlatMultiSlotMap(std::move(_oth));
+		}
+
+		~FlatMultiSlotMap()
+		{
+			clear();
+			std::allocator<Value>().deallocate(m_values, m_capacity);
+		}
+
+		template<typename... Args>
+		Value& emplace(Key _key, Args&&... _args)
+		{
+			Key ind = m_slots.get(_key);
+			if (ind == INVALID_SLOT)
+			{
+				ind = static_cast<Key>(m_ranges.size());
+				reserveBack(1);
+				m_ranges.push_back({ m_end, 0, 1 });
+				m_rangesToSlots.push_back(_key);
+				m_slots.set(_key, ind);
+				m_end += 1;
+			}
+			else if (m_ranges[ind].size == m_ranges[ind].capacity)
+				ind = growRange(_key, ind);
+
+			Range& range = m_ranges[ind];
+			Value* value = new (&m_values[range.begin + range.size]) Value(std::forward<Args>(_args)...);
+			++range.size;
+			++m_size;
+			return *value;
+		}
+
+		// erases all values associated with this key
+		void erase(Key _key)
+		{
+			ASSERT(contains(_key), "Trying to delete a not existing element.");
+
+			const Key ind = m_slots.get(_key);
+			const Range& range = m_ranges[ind];
+			std::destroy_n(&m_values[range.begin], range.size);
+			m_size -= range.size;
+			if (range.begin + range.capacity == m_end) m_end = range.begin;
+
+			m_slots.reset(_key);
+			if (ind + 1u < m_ranges.size())
+			{
+				m_ranges[ind] = m_ranges.back();
+				m_rangesToSlots[ind] = m_rangesToSlots.back();
+				m_slots.set(m_rangesToSlots[ind], ind);
+			}
+			m_ranges.pop_back();
+			m_rangesToSlots.pop_back();
+		}
+
+		void clear()
+		{
+			for (const Range& range : m_ranges)
+				std::destroy_n(&m_values[range.begin], range.size);
+			m_slots.clear();
+			m_ranges.clear();
+			m_rangesToSlots.clear();
+			m_end = 0;
+			m_size = 0;
+		}
+
+		// Remove the holes left by moved or erased ranges. The ranges are placed in
+		// ascending key order and keep their capacity.
+		void compact()
+		{
+			relocate(m_capacity);
+		}
+
+		// access operations
+		bool contains(Key _key) const { return m_slots.get(_key) != INVALID_SLOT; }
+
+		// All values of _key as one contiguous range, empty if the key does not exist.
+		std::span<Value> span(Key _key)
+		{
+			const Key ind = m_slots.get(_key);
+			if (ind == INVALID_SLOT) return {};
+			return std::span<Value>(&m_values[m_ranges[ind].begin], m_ranges[ind].size);
+		}
+		std::span<const Value> span(Key _key) const
+		{
+			const Key ind = m_slots.get(_key);
+			if (ind == INVALID_SLOT) return {};
+			return std::span<const Value>(&m_values[m_ranges[ind].begin], m_ranges[ind].size);
+		}
+
+		// Call _func(Value&) for all values of _key in insertion order.
+		template<typename Func>
+		void forEach(Key _key, Func&& _func)
+		{
+			for (Value& value : span(_key))
+				_func(value);
+		}
+
+		// Call _func(Key, std::span<Value>) once for every key.
+		template<typename Func>
+		void forEachKey(Func&& _func)
+		{
+			for (size_t i = 0; i < m_ranges.size(); ++i)
+				_func(m_rangesToSlots[i], std::span<Value>(&m_values[m_ranges[i].begin], m_ranges[i].size));
+		}
+
+		// number of values
+		std::size_t size() const { return m_size; }
+		// number of keys
+		std::size_t numKeys() const { return m_ranges.size(); }
+		bool empty() const { return m_size == 0; }
+	private:
+		struct Range
+		{
+			Key begin;
+			Key size;
+			Key capacity;
+		};
+
+		// Make sure that _count more values fit behind m_end.
+		void reserveBack(Key _count)
+		{
+			if (m_end + _count <= m_capacity) return;
+
+			// Compacting alone frees enough space if more than half are holes.
+			const Key used = usedCapacity();
+			if (used + _count <= m_capacity / 2) relocate(m_capacity);
+			else relocate(std::max<Key>(16, static_cast<Key>((used + _count) * 2)));
+		}
+
+		// Double the capacity of a full range. Returns the new index of the range.
+		Key growRange(Key _key, Key _ind)
+		{
+			const Key capacity = m_ranges[_ind].capacity;
+			// enough space to move the range to the end, reserveBack() may compact the buffer
+			// which reorders the ranges
+			reserveBack(2 * capacity);
+			_ind = m_slots.get(_key);
+			Range& range = m_ranges[_ind];
+			if (range.begin + capacity == m_end)
+			{
+				// last range, extend in place
+				range.capacity += capacity;
+				m_end += capacity;
+				return _ind;
+			}
+
+			std::uninitialized_move_n(&m_values[range.begin], range.size, &m_values[m_end]);
+			std::destroy_n(&m_values[range.begin], range.size);
+			range.begin = m_end;
+			range.capacity = 2 * capacity;
+			m_end += range.capacity;
+			return _ind;
+		}
+
+		Key usedCapacity() const
+		{
+			Key used = 0;
+			for (const Range& range : m_ranges)
+				used += range.capacity;
+			return used;
+		}
+
+		// Move all ranges in key order into a buffer of size _capacity without holes.
+		// The range descriptors are sorted as well, so that iteration by key is linear.
+		void relocate(Key _capacity)
+		{
+			Value* values = std::allocator<Value>().allocate(_capacity);
+			std::vector<Range> ranges;
+			std::vector<Key> rangesToSlots;
+			ranges.reserve(m_ranges.size());
+			rangesToSlots.reserve(m_ranges.size());
+			Key end = 0;
+			for (Key ind : details::keyPermutation(m_rangesToSlots))
+			{
+				const Range& range = m_ranges[ind];
+				std::uninitialized_move_n(&m_values[range.begin], range.size, &values[end]);
+				std::destroy_n(&m_values[range.begin], range.size);
+				m_slots.set(m_rangesToSlots[ind], static_cast<Key>(ranges.size()));
+				ranges.push_back({ end, range.size, range.capacity });
+				rangesToSlots.push_back(m_rangesToSlots[ind]);
+				end += range.capacity;
+			}
+			m_ranges = std::move(ranges);
+			m_rangesToSlots = std::move(rangesToSlots);
+			std::allocator<Value>().deallocate(m_values, m_capacity);
+			m_values = values;
+			m_capacity = _capacity;
+			m_end = end;
+		}
+
+		SlotIndex m_slots;
+		std::vector<Range> m_ranges;
+		std::vector<Key> m_rangesToSlots;
+		Value* m_values = nullptr;
+		Key m_capacity = 0;
+		Key m_end = 0;
+		std::size_t m_size = 0;
+	};
+}
@@ -1,14 +1,52 @@
 #pragma once
 
+#include "snapshot.hpp"
+#include "../alloctracker.hpp"
+#include <spdlog/spdlog.h>
 #include <cinttypes>
 #include <type_traits>
 #include <cstring>
 #include <functional>
 #include <concepts>
+#include <algorithm>
+#include <bit>
 
 namespace utils {
 
-template<typename K, typename T, typename Hash = std::hash<K>, typename Compare = std::equal_to<K>>
+// Hash and compare functors which support lookups with other types than the key type.
+template<typename Hash, typename Compare>
+concept transparent_lookup = requires {
+	typename Hash::is_transparent;
+	typename Compare::is_transparent;
+};
+
+/// Layout policies for the HashMap.
+/// The default keeps the capacity odd and maps hashes to slots with a modulo.
+struct OddCapacityLayout
+{
+	static constexpr bool STORE_HASH = false;
+
+	static uint32_t capacity(uint32_t _minCapacity) { return _minCapacity | 1; }
+	static uint32_t index(uint32_t _hash, uint32_t _capacity) { return _hash % _capacity; }
+};
+
+/// Power of two capacities with multiplicative (Fibonacci) hashing for the start slot.
+/// The 32-bit hash is stored next to the probing distance, so resizes and removes never
+/// call the hash function again and key compares are skipped if the hashes differ.
+/// Recommended for keys with expensive hash or compare functions (e.g. strings).
+struct PowerOfTwoLayout
+{
+	static constexpr bool STORE_HASH = true;
+
+	static uint32_t capacity(uint32_t _minCapacity) { return std::bit_ceil(std::max(_minCapacity, 2u)); }
+	static uint32_t index(uint32_t _hash, uint32_t _capacity)
+	{
+		return (_hash * 2654435769u) >> (32 - std::countr_zero(_capacity));
+	}
+};
+
+template<typename K, typename T, typename Hash = std::hash<K>, typename Compare = std::equal_to<K>,
+	typename Layout = OddCapacityLayout>
 class HashMap
 {
 public:
@@ -71,14 +109,8 @@ public:
 	typedef HandleT<const HashMap, const T> ConstHandle;
 
 	explicit HashMap(uint32_t _expectedElementCount = 15) :
-		m_capacity(estimateCapacity(_expectedElementCount)),
-		m_size(0)
+		HashMap(estimateCapacity(_expectedElementCount), ExactCapacity{})
 	{
-		m_keys = static_cast<Key*>(malloc(sizeof(Key) * m_capacity));
-		m_data = static_cast<T*>(malloc(sizeof(T) * m_capacity));
-		
-		for(uint32_t i = 0; i < m_capacity; ++i)
-			m_keys[i].dist = 0xffffffff;
 	}
 
 	HashMap(HashMap&& _other) noexcept :
@@ -115,6 +147,8 @@ public:
 					m_keys[i].key.~K();
 				}
 		}
+		if(m_keys)
+			AllocTracker::deallocate(AllocTag::HASH_MAP, (sizeof(Key) + sizeof(T)) * m_capacity);
 		free(m_keys);
 		free(m_data);
 	}
@@ -125,26 +159,38 @@ public:
 	template<class KeyT, class DataT>
 		requires (std::is_same_v<std::remove_cvref_t<KeyT>, K>)
 	Handle add(KeyT&& _key, DataT&& _data)
+	{
+		const uint32_t h = static_cast<uint32_t>(m_hash(_key));
+		return add(std::forward<KeyT>(_key), std::forward<DataT>(_data), h);
+	}
+
+	// Version of add() with a precomputed hash _hash == Hash()(_key).
+	template<class KeyT, class DataT>
+		requires (std::is_same_v<std::remove_cvref_t<KeyT>, K>)
+	Handle add(KeyT&& _key, DataT&& _data, size_t _hash)
 	{
 		using namespace std;
 
 		// in case a const key is captured at KeyT we need a copy
 		K key(std::forward<KeyT>(_key));
-		uint32_t h = static_cast<uint32_t>(m_hash(key));
+		// same for the data, which may be swapped into the map during probing
+		T data(std::forward<DataT>(_data));
+		uint32_t h = static_cast<uint32_t>(_hash);
 	restartAdd:
 		uint32_t insertIdx = ~0;
 		uint32_t d = 0;
-		uint32_t idx = h % m_capacity;
+		uint32_t idx = Layout::index(h, m_capacity);
 		while(m_keys[idx].dist != 0xffffffff) // while not empty cell
 		{
-			if(m_keyCompare(m_keys[idx].key, key)) // overwrite if keys are identically
+			if(isEqual(m_keys[idx], key, h)) // overwrite if keys are identically
 			{
-				m_data[idx] = std::forward<DataT>(_data);
+				m_data[idx] = std::move(data);
 				return Handle(this, idx);
 			}
 			// probing (collision)
 			// Since we have encountered a collision: should we resize?
-			if(m_size > 0.77 * m_capacity) {
+			// Only before the first swap, afterwards key and h belong to another element.
+			if(insertIdx == ~0u && m_size > 0.77 * m_capacity) {
 				reserve(m_size * 2);
 				// The resize changed everything beginning from the index
 				// to the content of the target cell. Restart the search.
@@ -155,7 +201,8 @@ public:
 			{
 				swap(key, m_keys[idx].key);
 				swap(d, m_keys[idx].dist);
-				swap(_data, m_data[idx]);
+				swapHash(h, m_keys[idx]);
+				swap(data, m_data[idx]);
 				if(insertIdx == ~0u) insertIdx = idx;
 			}
 			++d;
@@ -164,7 +211,8 @@ public:
 		}
 		new (&m_keys[idx].key)(K)(std::move(key));
 		m_keys[idx].dist = d;
-		new (&m_data[idx])(T)(std::forward<DataT>(_data));
+		setHash(m_keys[idx], h);
+		new (&m_data[idx])(T)(std::move(data));
 		++m_size;
 		if(insertIdx == ~0u) insertIdx = idx;
 		return Handle(this, insertIdx);
@@ -193,6 +241,7 @@ public:
 				new (&m_keys[i].key)(K)( move(m_keys[next].key) );
 				new (&m_data[i])(T)( move(m_data[next]) );
 				m_keys[i].dist = m_keys[next].dist - 1;
+				if constexpr (Layout::STORE_HASH) m_keys[i].hash = m_keys[next].hash;
 				m_keys[next].dist = 0xffffffff;
 				i = next;
 				if(++next >= m_capacity) next = 0;
@@ -202,32 +251,44 @@ public:
 
 	Handle find(const K& _key) noexcept
 	{
-		uint32_t d = 0;
-		uint32_t h = (uint32_t)m_hash(_key);
-		uint32_t idx = h % m_capacity;
-		while(m_keys[idx].dist != 0xffffffff && d <= m_keys[idx].dist)
-		{
-			if(m_keyCompare(m_keys[idx].key, _key))
-				return Handle(this, idx);
-			if(++idx >= m_capacity) idx = 0;
-			++d;
-		}
-		return Handle(nullptr, 0);
+		const uint32_t idx = findIndex(_key, static_cast<uint32_t>(m_hash(_key)));
+		return idx != INVALID_INDEX ? Handle(this, idx) : Handle(nullptr, 0);
 	}
 	ConstHandle find(const K& _key) const noexcept
 	{
-		// COPY OF find() <noconst>
-		uint32_t d = 0;
-		uint32_t h = (uint32_t)m_hash(_key);
-		uint32_t idx = h % m_capacity;
-		while(m_keys[idx].dist != 0xffffffff && d <= m_keys[idx].dist)
-		{
-			if(m_keyCompare(m_keys[idx].key, _key))
-				return ConstHandle(this, idx);
-			if(++idx >= m_capacity) idx = 0;
-			++d;
-		}
-		return ConstHandle(nullptr, 0);
+		const uint32_t idx = findIndex(_key, static_cast<uint32_t>(m_hash(_key)));
+		return idx != INVALID_INDEX ? ConstHandle(this, idx) : ConstHandle(nullptr, 0);
+	}
+
+	// Heterogeneous lookup, e.g. with a std::string_view for std::string keys.
+	// Requires that Hash and Compare both define is_transparent and accept KeyT.
+	template<typename KeyT>
+		requires transparent_lookup<Hash, Compare>
+	Handle find(const KeyT& _key) noexcept
+	{
+		return find(_key, m_hash(_key));
+	}
+	template<typename KeyT>
+		requires transparent_lookup<Hash, Compare>
+	ConstHandle find(const KeyT& _key) const noexcept
+	{
+		return find(_key, m_hash(_key));
+	}
+
+	// Lookup with a precomputed hash _hash == Hash()(_key).
+	template<typename KeyT>
+		requires (std::is_same_v<KeyT, K> || transparent_lookup<Hash, Compare>)
+	Handle find(const KeyT& _key, size_t _hash) noexcept
+	{
+		const uint32_t idx = findIndex(_key, static_cast<uint32_t>(_hash));
+		return idx != INVALID_INDEX ? Handle(this, idx) : Handle(nullptr, 0);
+	}
+	template<typename KeyT>
+		requires (std::is_same_v<KeyT, K> || transparent_lookup<Hash, Compare>)
+	ConstHandle find(const KeyT& _key, size_t _hash) const noexcept
+	{
+		const uint32_t idx = findIndex(_key, static_cast<uint32_t>(_hash));
+		return idx != INVALID_INDEX ? ConstHandle(this, idx) : ConstHandle(nullptr, 0);
 	}
 
 	/// Get access to an element. If it was not in the map before it will be added with default construction.
@@ -236,10 +297,10 @@ public:
 	{
 		uint32_t d = 0;
 		uint32_t h = (uint32_t)m_hash(_key);
-		uint32_t idx = h % m_capacity;
+		uint32_t idx = Layout::index(h, m_capacity);
 		while(m_keys[idx].dist != 0xffffffff && d <= m_keys[idx].dist)
 		{
-			if(m_keyCompare(m_keys[idx].key, _key))
+			if(isEqual(m_keys[idx], _key, h))
 				return m_data[idx];
 			if(++idx >= m_capacity) idx = 0;
 			++d;
@@ -250,6 +311,7 @@ public:
 			new (&m_keys[idx].key)(K)(_key);
 			new (&m_data[idx])(T)(); // New default element
 			m_keys[idx].dist = d;
+			setHash(m_keys[idx], h);
 			++m_size;
 		} else { // Stopped because of a collision.
 			if(m_size > 0.77 * m_capacity)
@@ -259,14 +321,16 @@ public:
 		return m_data[idx];
 	}
 
-	// Change the capacity if possible. It cannot be decreased below 'size'.
+	// Change the capacity if possible. It cannot be decreased below what is required for 'size'.
+	// The Layout may round the capacity up.
 	void resize(uint32_t _newCapacity)
 	{
 		using namespace std;
 		//if(_newCapacity == m_capacity) return;
-		if(_newCapacity < m_size) _newCapacity = m_size;
+		const uint32_t minCapacity = estimateCapacity(m_size);
+		if(_newCapacity < minCapacity) _newCapacity = minCapacity;
 
-		HashMap tmp(_newCapacity);
+		HashMap tmp(Layout::capacity(_newCapacity), ExactCapacity{});
 		// Find all data sets and readd them to the new temporary hm
 		for(uint32_t i = 0; i < m_capacity; ++i)
 		{
@@ -274,7 +338,9 @@ public:
 			{
 				// We can use a reduced version of add, since we know the element is unique
 				// and will not cause a resize.
-				uint32_t h = (uint32_t)m_hash(m_keys[i].key);
+				uint32_t h;
+				if constexpr (Layout::STORE_HASH) h = m_keys[i].hash;
+				else h = (uint32_t)m_hash(m_keys[i].key);
 				tmp.reinsertUnique(move(m_keys[i].key), move(m_data[i]), h);
 				// destructor still needs to be called
 				// todo: compare performance with destructor call here
@@ -309,6 +375,46 @@ public:
 
 	uint32_t size() const { return m_size; }
 
+	/// Write all elements to _writer, see snapshot.hpp.
+	/// If keys and values are trivially copyable the whole table is stored, so the
+	/// snapshot can only be restored into a map with the same Hash and Layout. Both
+	/// are recorded in the header and restoring checks the position of every element.
+	/// Otherwise the elements are written one by one with Serializer<K> and Serializer<T>.
+	void snapshot(BinaryWriter& _writer) const
+	{
+		details::writeSnapshotHeader(_writer, details::SnapshotKind::HashMap,
+			BULK_SNAPSHOT ? sizeof(Key) : sizeof(K), sizeof(T), BULK_SNAPSHOT, m_size, snapshotPolicy());
+		if constexpr(BULK_SNAPSHOT)
+		{
+			_writer.write(m_capacity);
+			_writer.write(m_keys, sizeof(Key) * m_capacity);
+			_writer.write(m_data, sizeof(T) * m_capacity);
+		}
+		else
+		{
+			for(auto it : *this)
+			{
+				Serializer<K>::write(_writer, it.key());
+				Serializer<T>::write(_writer, it.data());
+			}
+		}
+	}
+
+	/// Replace the content with a snapshot of a map with the same types.
+	/// On failure the map is empty afterwards.
+	bool restore(BinaryReader& _reader)
+		requires ((std::is_trivially_copyable_v<K> && std::is_trivially_copyable_v<T>)
+			|| (std::default_initializable<K> && std::default_initializable<T>))
+	{
+		if(!restoreElements(_reader))
+		{
+			spdlog::error("[utils] Invalid or incompatible HashMap snapshot.");
+			*this = HashMap();
+			return false;
+		}
+		return true;
+	}
+
 	/// Returns the first element found in the map or an invalid handle when the map is empty.
 	Handle begin()
 	{
@@ -331,14 +437,25 @@ public:
 	}
 
 private:
+	static constexpr uint32_t INVALID_INDEX = ~0u;
+	// snapshots store the whole table instead of element by element
+	static constexpr bool BULK_SNAPSHOT = std::is_trivially_copyable_v<K> && std::is_trivially_copyable_v<T>;
+
 	uint32_t m_capacity;
 	uint32_t m_size;
 
-	struct Key
+	struct KeyDist
+	{
+		K key;
+		uint32_t dist; // robin hood cashing offset
+	};
+	struct KeyDistHash
 	{
 		K key;
 		uint32_t dist; // robin hood cashing offset
+		uint32_t hash;
 	};
+	using Key = std::conditional_t<Layout::STORE_HASH, KeyDistHash, KeyDist>;
 
 	Key* m_keys;
 	T* m_data;
@@ -347,8 +464,111 @@ private:
 	
 	static uint32_t estimateCapacity(uint32_t _exptectedElementCount)
 	{
-		 // Try to keep the capacity odd (prime would be even better)
-		return (uint32_t(_exptectedElementCount * 1.3) | 1) + 2;
+		return Layout::capacity(uint32_t(_exptectedElementCount * 1.3) + 2);
+	}
+
+	struct ExactCapacity {};
+	HashMap(uint32_t _capacity, ExactCapacity) :
+		m_capacity(_capacity),
+		m_size(0)
+	{
+		// zeroed memory, so that snapshots of the whole table contain no uninitialized bytes
+		if constexpr(BULK_SNAPSHOT)
+		{
+			m_keys = static_cast<Key*>(calloc(m_capacity, sizeof(Key)));
+			m_data = static_cast<T*>(calloc(m_capacity, sizeof(T)));
+		}
+		else
+		{
+			m_keys = static_cast<Key*>(malloc(sizeof(Key) * m_capacity));
+			m_data = static_cast<T*>(malloc(sizeof(T) * m_capacity));
+		}
+		AllocTracker::allocate(AllocTag::HASH_MAP, (sizeof(Key) + sizeof(T)) * m_capacity);
+		
+		for(uint32_t i = 0; i < m_capacity; ++i)
+			m_keys[i].dist = 0xffffffff;
+	}
+
+	// Compare the stored hashes first if available to skip expensive key compares.
+	template<typename KeyT>
+	bool isEqual(const Key& _stored, const KeyT& _key, [[maybe_unused]] uint32_t _hash) const
+	{
+		if constexpr (Layout::STORE_HASH)
+			if(_stored.hash != _hash) return false;
+		return m_keyCompare(_stored.key, _key);
+	}
+	static void setHash([[maybe_unused]] Key& _stored, [[maybe_unused]] uint32_t _hash)
+	{
+		if constexpr (Layout::STORE_HASH) _stored.hash = _hash;
+	}
+	static void swapHash([[maybe_unused]] uint32_t& _hash, [[maybe_unused]] Key& _stored)
+	{
+		if constexpr (Layout::STORE_HASH) std::swap(_hash, _stored.hash);
+	}
+
+	bool restoreElements(BinaryReader& _reader)
+	{
+		const int64_t size = details::readSnapshotHeader(_reader, details::SnapshotKind::HashMap,
+			BULK_SNAPSHOT ? sizeof(Key) : sizeof(K), sizeof(T), BULK_SNAPSHOT, snapshotPolicy());
+		if(size < 0 || size > UINT32_MAX) return false;
+
+		if constexpr(BULK_SNAPSHOT)
+		{
+			uint32_t capacity = 0;
+			if(!_reader.read(capacity) || capacity == 0 || Layout::capacity(capacity) != capacity
+				|| capacity > _reader.remaining() / (sizeof(Key) + sizeof(T)))
+				return false;
+			HashMap map(capacity, ExactCapacity{});
+			if(!_reader.read(map.m_keys, sizeof(Key) * capacity) || !_reader.read(map.m_data, sizeof(T) * capacity))
+				return false;
+			map.m_size = static_cast<uint32_t>(size);
+			if(!map.isValidTable()) return false;
+			*this = std::move(map);
+		}
+		else
+		{
+			clear();
+			reserve(static_cast<uint32_t>(std::min<uint64_t>(size, _reader.remaining())));
+			for(int64_t i = 0; i < size; ++i)
+			{
+				K key;
+				T data;
+				if(!Serializer<K>::read(_reader, key) || !Serializer<T>::read(_reader, data) || find(key))
+					return false;
+				add(std::move(key), std::move(data));
+			}
+		}
+		return true;
+	}
+
+	// Only the table of bulk snapshots depends on Hash and Layout.
+	static uint64_t snapshotPolicy()
+	{
+		if constexpr(BULK_SNAPSHOT) return details::typeFingerprint<Hash, Layout>();
+		else return 0;
+	}
+
+	// Check a table from a snapshot: every element has to sit at the start index of its
+	// hash plus its distance and the probe sequence leading to it has no gaps. This
+	// bounds the probing of lookups and rejects tables built with another Hash.
+	bool isValidTable() const
+	{
+		uint32_t numUsed = 0;
+		for(uint32_t i = 0; i < m_capacity; ++i)
+		{
+			const Key& stored = m_keys[i];
+			if(stored.dist == 0xffffffff) continue;
+			++numUsed;
+			const uint32_t h = static_cast<uint32_t>(m_hash(stored.key));
+			if constexpr(Layout::STORE_HASH)
+				if(stored.hash != h) return false;
+			if(stored.dist >= m_capacity || (Layout::index(h, m_capacity) + uint64_t(stored.dist)) % m_capacity != i)
+				return false;
+			const Key& prev = m_keys[i == 0 ? m_capacity - 1 : i - 1];
+			if(stored.dist > 0 && (prev.dist == 0xffffffff || prev.dist + 1 < stored.dist))
+				return false;
+		}
+		return numUsed == m_size;
 	}
 
 	/*uint32_t hash(const uint32_t* _key, unsigned _numWords)
@@ -357,6 +577,23 @@ private:
 		return *_key;
 	}*/
 
+	/// Kernel of all lookups.
+	/// \returns The internal index of the element or INVALID_INDEX.
+	template<typename KeyT>
+	uint32_t findIndex(const KeyT& _key, uint32_t h) const noexcept
+	{
+		uint32_t d = 0;
+		uint32_t idx = Layout::index(h, m_capacity);
+		while(m_keys[idx].dist != 0xffffffff && d <= m_keys[idx].dist)
+		{
+			if(isEqual(m_keys[idx], _key, h))
+				return idx;
+			if(++idx >= m_capacity) idx = 0;
+			++d;
+		}
+		return INVALID_INDEX;
+	}
+
 	/// Kernel of the Add method, but without resizing,  hash computation and
 	/// key compares. I.e. this method assumes that the element is not contained, but
 	/// space is available.
@@ -367,13 +604,14 @@ private:
 		using namespace std;
 		uint32_t insertIdx = ~0;
 		uint32_t d = 0;
-		uint32_t idx = h % m_capacity;
+		uint32_t idx = Layout::index(h, m_capacity);
 		while(m_keys[idx].dist != 0xffffffff) // while not empty cell
 		{
 			if(m_keys[idx].dist < d) // Swap and then insert the element from this location instead
 			{
 				swap(_key, m_keys[idx].key);
 				swap(d, m_keys[idx].dist);
+				swapHash(h, m_keys[idx]);
 				swap(_data, m_data[idx]);
 				if(insertIdx == ~0u) insertIdx = idx;
 			}
@@ -383,6 +621,7 @@ private:
 		}
 		new (&m_keys[idx].key)(K)(move(_key));
 		m_keys[idx].dist = d;
+		setHash(m_keys[idx], h);
 		new (&m_data[idx])(T)(move(_data));
 		++m_size;
 		if(insertIdx == ~0u) insertIdx = idx;
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "parallelchunks.hpp"
 #include <utility>
 
 namespace utils {
@@ -50,7 +51,39 @@ namespace utils {
 		Iterator begin() const { return Iterator(m_target, 0); }
 		Iterator end() const { return Iterator(m_target, m_target.size()); }
 
+		// Call _func(Key, Value&) for all elements in parallel chunks on _pool.
+		template<typename Func>
+		void parallelForEach(Func&& _func, ThreadPool& _pool = ThreadPool::global()) const
+		{
+			details::parallelChunks(data(), m_target.size(), sizeof(Value), _pool, [&](size_t _begin, size_t _end)
+				{
+					for (size_t i = _begin; i < _end; ++i)
+					{
+						const SizeType ind = static_cast<SizeType>(i);
+						_func(Accessor::key(m_target, ind), Accessor::value(m_target, ind));
+					}
+				});
+		}
+
+		// Parallel reduction with _func(T&, Key, const Value&), see SlotMap::parallelReduce().
+		template<typename T, typename Func, typename Combine>
+		T parallelReduce(const T& _init, Func&& _func, Combine&& _combine, ThreadPool& _pool = ThreadPool::global()) const
+		{
+			return details::parallelReduceChunks(data(), m_target.size(), sizeof(Value), _pool, _init,
+				[&](T& _accumulator, size_t _begin, size_t _end)
+				{
+					for (size_t i = _begin; i < _end; ++i)
+					{
+						const SizeType ind = static_cast<SizeType>(i);
+						_func(_accumulator, Accessor::key(m_target, ind), std::as_const(Accessor::value(m_target, ind)));
+					}
+				}, _combine);
+		}
+
 	private:
+		// start of the values, only used to align the parallel chunks
+		const void* data() const { return m_target.size() ? &Accessor::value(m_target, 0) : nullptr; }
+
 		Container& m_target;
 	};
 
@@ -86,7 +119,38 @@ namespace utils {
 		Iterator begin() const { return Iterator(m_target, 0); }
 		Iterator end() const { return Iterator(m_target, m_target.size()); }
 
+		// Call _func(Key, const Value&) for all elements in parallel chunks on _pool.
+		template<typename Func>
+		void parallelForEach(Func&& _func, ThreadPool& _pool = ThreadPool::global()) const
+		{
+			details::parallelChunks(data(), m_target.size(), sizeof(Value), _pool, [&](size_t _begin, size_t _end)
+				{
+					for (size_t i = _begin; i < _end; ++i)
+					{
+						const SizeType ind = static_cast<SizeType>(i);
+						_func(Accessor::key(m_target, ind), Accessor::value(m_target, ind));
+					}
+				});
+		}
+
+		// Parallel reduction with _func(T&, Key, const Value&), see SlotMap::parallelReduce().
+		template<typename T, typename Func, typename Combine>
+		T parallelReduce(const T& _init, Func&& _func, Combine&& _combine, ThreadPool& _pool = ThreadPool::global()) const
+		{
+			return details::parallelReduceChunks(data(), m_target.size(), sizeof(Value), _pool, _init,
+				[&](T& _accumulator, size_t _begin, size_t _end)
+				{
+					for (size_t i = _begin; i < _end; ++i)
+					{
+						const SizeType ind = static_cast<SizeType>(i);
+						_func(_accumulator, Accessor::key(m_target, ind), Accessor::value(m_target, ind));
+					}
+				}, _combine);
+		}
+
 	private:
+		const void* data() const { return m_target.size() ? &Accessor::value(m_target, 0) : nullptr; }
+
 		const Container& m_target;
 	};
 }
\ No newline at end of file
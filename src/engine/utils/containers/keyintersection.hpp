@@ -0,0 +1,189 @@
+#pragma once
+
+#include "dynamicbitset.hpp"
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include <concepts>
+#include <type_traits>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define ACA_KEY_INTERSECTION_SSE2
+#endif
+
+namespace utils {
+
+	namespace details {
+		using BitsetWord = DynamicBitset::Word;
+
+		// Number of words which are combined at once (256 bits).
+		constexpr size_t INTERSECTION_BLOCK = 4;
+
+		/// AND the words [_begin, _begin + INTERSECTION_BLOCK) of all bitmaps into _out.
+		/// \returns Whether any bit of the result is set.
+		template<size_t N>
+		bool intersectBlock(const std::array<const BitsetWord*, N>& _bitmaps, size_t _begin, BitsetWord* _out)
+		{
+#if defined(__AVX2__)
+			__m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(_bitmaps[0] + _begin));
+			for (size_t i = 1; i < N; ++i)
+				block = _mm256_and_si256(block, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(_bitmaps[i] + _begin)));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(_out), block);
+			return !_mm256_testz_si256(block, block);
+#elif defined(ACA_KEY_INTERSECTION_SSE2)
+			__m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(_bitmaps[0] + _begin));
+			__m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(_bitmaps[0] + _begin + 2));
+			for (size_t i = 1; i < N; ++i)
+			{
+				lo = _mm_and_si128(lo, _mm_loadu_si128(reinterpret_cast<const __m128i*>(_bitmaps[i] + _begin)));
+				hi = _mm_and_si128(hi, _mm_loadu_si128(reinterpret_cast<const __m128i*>(_bitmaps[i] + _begin + 2)));
+			}
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(_out), lo);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(_out + 2), hi);
+			return _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_or_si128(lo, hi), _mm_setzero_si128())) != 0xffff;
+#else
+			BitsetWord any = 0;
+			for (size_t w = 0; w < INTERSECTION_BLOCK; ++w)
+			{
+				BitsetWord word = _bitmaps[0][_begin + w];
+				for (size_t i = 1; i < N; ++i)
+					word &= _bitmaps[i][_begin + w];
+				_out[w] = word;
+				any |= word;
+			}
+			return any != 0;
+#endif
+		}
+	}
+
+	/// Keys which are present in all of N presence bitmaps, in ascending order.
+	/// \details The bitmaps are combined 256 bits at a time with AVX2 or SSE2 and empty
+	///		blocks are skipped with one test. The cost is proportional to the largest
+	///		common key / 256 * N plus the number of matches, independent of the number
+	///		of elements in each map. Use commonKeys() to create it from maps with a
+	///		PresenceSlotIndex. The maps must not change while the intersection is used.
+	template<std::integral Key, size_t N>
+	class KeyIntersection
+	{
+	public:
+		explicit KeyIntersection(const std::array<const DynamicBitset*, N>& _bitmaps)
+		{
+			static_assert(N > 0, "At least one bitmap is required.");
+			m_numWords = _bitmaps[0]->words().size();
+			for (size_t i = 0; i < N; ++i)
+			{
+				m_bitmaps[i] = _bitmaps[i]->words().data();
+				m_numWords = std::min(m_numWords, _bitmaps[i]->words().size());
+			}
+		}
+
+		class Iterator
+		{
+		public:
+			Key operator*() const
+			{
+				return static_cast<Key>(m_word * DynamicBitset::BITS_PER_WORD + std::countr_zero(m_bits));
+			}
+
+			Iterator& operator++()
+			{
+				m_bits &= m_bits - 1;
+				if (!m_bits) advance();
+				return *this;
+			}
+
+			bool operator==(const Iterator& _oth) const { return m_word == _oth.m_word && m_bits == _oth.m_bits; }
+			bool operator!=(const Iterator& _oth) const { return !(*this == _oth); }
+		private:
+			friend KeyIntersection;
+			Iterator(const KeyIntersection& _target, size_t _word) : m_target(&_target), m_word(_word) {}
+
+			// Move to the next word with set bits or to the end.
+			void advance()
+			{
+				while (++m_word < m_target->m_numWords)
+				{
+					const size_t offset = m_word % details::INTERSECTION_BLOCK;
+					if (offset == 0 && !m_target->loadBlock(m_word, m_block.data()))
+					{
+						m_word += details::INTERSECTION_BLOCK - 1;
+						continue;
+					}
+					m_bits = m_block[offset];
+					if (m_bits) return;
+				}
+				m_word = m_target->m_numWords;
+				m_bits = 0;
+			}
+
+			const KeyIntersection* m_target;
+			size_t m_word;
+			details::BitsetWord m_bits = 0;
+			std::array<details::BitsetWord, details::INTERSECTION_BLOCK> m_block{};
+		};
+
+		Iterator begin() const
+		{
+			Iterator it(*this, static_cast<size_t>(-1));
+			it.advance();
+			return it;
+		}
+		Iterator end() const { return Iterator(*this, m_numWords); }
+
+		// Call _func(Key) for all common keys; faster than the iterators.
+		template<typename Func>
+		void forEach(Func&& _func) const
+		{
+			std::array<details::BitsetWord, details::INTERSECTION_BLOCK> block;
+			for (size_t begin = 0; begin < m_numWords; begin += details::INTERSECTION_BLOCK)
+			{
+				if (!loadBlock(begin, block.data())) continue;
+				for (size_t w = 0; w < details::INTERSECTION_BLOCK; ++w)
+				{
+					const size_t base = (begin + w) * DynamicBitset::BITS_PER_WORD;
+					for (details::BitsetWord bits = block[w]; bits; bits &= bits - 1)
+						_func(static_cast<Key>(base + std::countr_zero(bits)));
+				}
+			}
+		}
+	private:
+		// Intersection of the block starting at word _begin, the words beyond the end are 0.
+		bool loadBlock(size_t _begin, details::BitsetWord* _out) const
+		{
+			if (_begin + details::INTERSECTION_BLOCK <= m_numWords)
+				return details::intersectBlock(m_bitmaps, _begin, _out);
+
+			details::BitsetWord any = 0;
+			for (size_t w = 0; w < details::INTERSECTION_BLOCK; ++w)
+			{
+				details::BitsetWord word = 0;
+				if (_begin + w < m_numWords)
+				{
+					word = m_bitmaps[0][_begin + w];
+					for (size_t i = 1; i < N; ++i)
+						word &= m_bitmaps[i][_begin + w];
+				}
+				_out[w] = word;
+				any |= word;
+			}
+			return any != 0;
+		}
+
+		std::array<const details::BitsetWord*, N> m_bitmaps;
+		size_t m_numWords;
+	};
+
+	/// Keys contained in all _maps, which have to use a PresenceSlotIndex.
+	/// Example: for (uint32_t key : commonKeys(positions, velocities, tags)) {...}
+	template<typename Map, typename... Maps>
+	auto commonKeys(const Map& _map, const Maps&... _maps)
+	{
+		using Key = typename std::remove_cvref_t<decltype(_map.slotIndex())>::KeyType;
+		return KeyIntersection<Key, 1 + sizeof...(Maps)>({ &_map.slotIndex().presence(), &_maps.slotIndex().presence()... });
+	}
+}
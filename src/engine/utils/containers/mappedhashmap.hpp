@@ -0,0 +1,271 @@
+#pragma once
+
+#include "hashmap.hpp"
+#include "../mappedfile.hpp"
+#include <spdlog/spdlog.h>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <span>
+#include <fstream>
+#include <cstdint>
+
+namespace utils {
+
+/// Hash function which gives the same results in every build and on every run,
+/// as required for hashes which are stored in files (FNV-1a).
+struct StableHash
+{
+	using is_transparent = void;
+
+	uint32_t operator () (std::string_view _string) const
+	{
+		return hashBytes(_string.data(), _string.size());
+	}
+
+	template<typename KeyT>
+		requires (std::has_unique_object_representations_v<KeyT>)
+	uint32_t operator () (const KeyT& _key) const
+	{
+		return hashBytes(reinterpret_cast<const char*>(&_key), sizeof(KeyT));
+	}
+
+	static uint32_t hashBytes(const char* _data, size_t _size)
+	{
+		uint32_t h = 2166136261u;
+		for(size_t i = 0; i < _size; ++i)
+			h = (h ^ static_cast<uint8_t>(_data[i])) * 16777619u;
+		return h;
+	}
+};
+
+namespace details {
+	struct MappedImageHeader
+	{
+		static constexpr uint32_t MAGIC = 0x494d4841; // "AHMI" in little endian
+		static constexpr uint32_t VERSION = 1;
+
+		uint32_t magic;
+		uint32_t version;
+		uint32_t entrySize;   // detects images written with other key/value types
+		uint32_t capacity;    // number of entries, power of two
+		uint32_t size;        // number of used entries
+		uint32_t entriesOffset;
+		uint64_t stringPoolOffset;
+		uint64_t stringPoolSize;
+	};
+
+	// Reference into the string pool of an image.
+	struct PooledString
+	{
+		uint32_t offset;
+		uint32_t length;
+	};
+}
+
+/// Read-only hash map which works directly on a flat binary image.
+/// \details Use write() or serialize() to store the content of any map with the HashMap
+///		interface. Opening the image is free of any deserialization: with a file
+///		name the image is memory mapped and lookups probe the mapped pages directly.
+///		Keys and values must be trivially copyable. std::string keys are supported by
+///		storing them in a string pool, lookups are then done with a std::string_view.
+///		The image uses the native byte order. Opening only validates the header, so it
+///		does not touch the entries. Lookups stop after capacity probes and ignore keys
+///		outside of the string pool, so corrupt files cannot cause endless probing or
+///		reads outside of the image.
+/// \tparam Hash Must give the same results when writing and reading an image.
+template<typename K, typename T, typename Hash = StableHash>
+class MappedHashMap
+{
+	static constexpr bool POOLED_KEYS = std::is_same_v<K, std::string>;
+	using StoredKey = std::conditional_t<POOLED_KEYS, details::PooledString, K>;
+	// Key type passed to find() and returned by key().
+	using LookupKey = std::conditional_t<POOLED_KEYS, std::string_view, K>;
+
+	static_assert(std::is_trivially_copyable_v<StoredKey>, "Keys must be trivially copyable or std::string.");
+	static_assert(std::is_trivially_copyable_v<T>, "Values must be trivially copyable.");
+
+	struct Entry
+	{
+		uint32_t hash;
+		uint32_t used;
+		StoredKey key;
+		T data;
+	};
+	using Header = details::MappedImageHeader;
+
+public:
+	class ConstHandle
+	{
+		const MappedHashMap* map;
+		const Entry* entry;
+
+		ConstHandle(const MappedHashMap* _map, const Entry* _entry) : map(_map), entry(_entry) {}
+
+		friend MappedHashMap;
+	public:
+		LookupKey key() const { return map->getKey(entry->key); }
+		const T& data() const { return entry->data; }
+
+		operator bool () const { return entry != nullptr; }
+	};
+
+	/// Memory map the image file _fileName. Check isValid() afterwards.
+	explicit MappedHashMap(const char* _fileName) :
+		m_file(_fileName)
+	{
+		if(m_file.isOpen())
+			open(std::span<const char>(m_file.data(), m_file.size()));
+	}
+
+	/// Use an image which is already in memory. The image has to outlive this map and
+	/// has to be aligned at least as strict as the keys and values.
+	explicit MappedHashMap(std::span<const char> _image)
+	{
+		open(_image);
+	}
+
+	bool isValid() const { return m_entries != nullptr; }
+	uint32_t size() const { return m_header ? m_header->size : 0; }
+
+	ConstHandle find(const LookupKey& _key) const noexcept
+	{
+		return find(_key, m_hash(_key));
+	}
+
+	// Lookup with a precomputed hash _hash == Hash()(_key).
+	ConstHandle find(const LookupKey& _key, size_t _hash) const noexcept
+	{
+		if(!m_entries) return ConstHandle(this, nullptr);
+
+		const uint32_t h = static_cast<uint32_t>(_hash);
+		const uint32_t mask = m_header->capacity - 1;
+		uint32_t idx = PowerOfTwoLayout::index(h, m_header->capacity);
+		// valid images always have a free entry, the limit only guards against corrupt ones
+		for(uint32_t probe = 0; probe < m_header->capacity && m_entries[idx].used; ++probe, idx = (idx + 1) & mask)
+		{
+			const Entry& entry = m_entries[idx];
+			if(entry.hash == h && getKey(entry.key) == _key)
+				return ConstHandle(this, &entry);
+		}
+		return ConstHandle(this, nullptr);
+	}
+
+	/// Create an image of _map which can be any map with the HashMap interface.
+	template<typename MapT>
+	static std::vector<char> serialize(const MapT& _map)
+	{
+		Header header{};
+		header.magic = Header::MAGIC;
+		header.version = Header::VERSION;
+		header.entrySize = sizeof(Entry);
+		// Linear probing with a load factor of at most 1/2 keeps the probe sequences short.
+		header.capacity = PowerOfTwoLayout::capacity(_map.size() * 2);
+		header.size = _map.size();
+		header.entriesOffset = alignUp(sizeof(Header), alignof(Entry));
+		header.stringPoolOffset = header.entriesOffset + uint64_t(header.capacity) * sizeof(Entry);
+
+		// zeroed, so that the padding bytes in images are deterministic
+		std::vector<Entry> entries(header.capacity);
+		std::memset(entries.data(), 0, entries.size() * sizeof(Entry));
+		std::vector<char> pool;
+		Hash hash;
+		const uint32_t mask = header.capacity - 1;
+		for(auto it : _map)
+		{
+			Entry entry;
+			std::memset(&entry, 0, sizeof(Entry));
+			entry.used = 1;
+			entry.data = it.data();
+			if constexpr(POOLED_KEYS)
+			{
+				const std::string_view key = it.key();
+				entry.key = details::PooledString{ static_cast<uint32_t>(pool.size()), static_cast<uint32_t>(key.size()) };
+				pool.insert(pool.end(), key.begin(), key.end());
+				entry.hash = hash(key);
+			}
+			else
+			{
+				entry.key = it.key();
+				entry.hash = hash(it.key());
+			}
+
+			uint32_t idx = PowerOfTwoLayout::index(entry.hash, header.capacity);
+			while(entries[idx].used) idx = (idx + 1) & mask;
+			std::memcpy(&entries[idx], &entry, sizeof(Entry));
+		}
+		header.stringPoolSize = pool.size();
+
+		std::vector<char> image(header.stringPoolOffset + pool.size());
+		std::memcpy(image.data(), &header, sizeof(Header));
+		std::memcpy(image.data() + header.entriesOffset, entries.data(), entries.size() * sizeof(Entry));
+		if(!pool.empty())
+			std::memcpy(image.data() + header.stringPoolOffset, pool.data(), pool.size());
+		return image;
+	}
+
+	/// Write an image of _map to the file _fileName.
+	template<typename MapT>
+	static bool write(const char* _fileName, const MapT& _map)
+	{
+		const std::vector<char> image = serialize(_map);
+		std::ofstream file(_fileName, std::ios::binary);
+		if(!file)
+		{
+			spdlog::error("[utils] Cannot open file '{}' for writing!", _fileName);
+			return false;
+		}
+		file.write(image.data(), image.size());
+		return static_cast<bool>(file);
+	}
+
+private:
+	MappedFile m_file;
+	const Header* m_header = nullptr;
+	const Entry* m_entries = nullptr;
+	const char* m_stringPool = nullptr;
+	Hash m_hash;
+
+	static uint32_t alignUp(uint32_t _offset, uint32_t _alignment)
+	{
+		return (_offset + _alignment - 1) / _alignment * _alignment;
+	}
+
+	// Keys outside of the string pool of a corrupt image are returned as empty strings.
+	LookupKey getKey(const StoredKey& _key) const
+	{
+		if constexpr(POOLED_KEYS)
+		{
+			if(uint64_t(_key.offset) + _key.length > m_header->stringPoolSize) return std::string_view();
+			return std::string_view(m_stringPool + _key.offset, _key.length);
+		}
+		else return _key;
+	}
+
+	void open(std::span<const char> _image)
+	{
+		if(_image.size() < sizeof(Header))
+		{
+			spdlog::error("[utils] Hash map image is too small.");
+			return;
+		}
+		const Header* header = reinterpret_cast<const Header*>(_image.data());
+		if(header->magic != Header::MAGIC || header->version != Header::VERSION
+			|| header->entrySize != sizeof(Entry) || !std::has_single_bit(header->capacity)
+			|| header->entriesOffset % alignof(Entry) != 0
+			|| reinterpret_cast<uintptr_t>(_image.data()) % alignof(Entry) != 0
+			|| header->stringPoolOffset != header->entriesOffset + uint64_t(header->capacity) * sizeof(Entry)
+			|| header->stringPoolOffset > _image.size()
+			|| header->stringPoolSize > _image.size() - header->stringPoolOffset)
+		{
+			spdlog::error("[utils] Invalid or incompatible hash map image.");
+			return;
+		}
+
+		m_header = header;
+		m_entries = reinterpret_cast<const Entry*>(_image.data() + header->entriesOffset);
+		m_stringPool = _image.data() + header->stringPoolOffset;
+	}
+};
+
+} // namespace utils
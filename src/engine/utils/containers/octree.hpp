@@ -5,6 +5,8 @@
 #include <glm/glm.hpp>
 #include <memory>
 #include <vector>
+#include <memory_resource>
+#include <algorithm>
 #include <concepts>
 #include <array>
 
@@ -20,7 +22,8 @@ namespace utils {
 		
 		/// @brief Construct a sparse octree with a single node.
 		/// @param _rootSize The initial size of the outer bounding box.
-		SparseOctree(FloatT _rootSize = 1.f) : m_size(_rootSize) { initRoot(_rootSize); }
+		///		The root is not shrunk below this size automatically.
+		SparseOctree(FloatT _rootSize = 1.f) : m_size(_rootSize) { initRoot(VecT(0), _rootSize); }
 
 		/// @brief Insert a new element into the tree. Does not check for duplicates.
 		/// @details If the box lies outside the current tree the root is expanded first.
@@ -29,6 +32,9 @@ namespace utils {
 		void insert(const AABB& _boundingBox, const T& _el);
 
 		/// @brief Remove an element from the tree.
+		/// @details Nodes which become empty are freed. A root without elements and
+		///		only a single child is replaced by the child as long as its size does
+		///		not drop below the initial root size.
 		/// @param _boundingBox The box used to search for the element.
 		/// @param _el The element to remove.
 		/// @return True if the element was found.
@@ -38,9 +44,19 @@ namespace utils {
 		void clear()
 		{
 			m_allocator.reset();
-			initRoot(m_size);
+			initRoot(VecT(0), m_size);
 		}
 
+		/// @brief Rebuild the tree with a root which tightly encloses the current elements.
+		/// @details Automatic shrinking keeps the root on the grid of the expanded root
+		///		and at least at the initial size. After elements have moved far, the
+		///		remaining elements may still be spread over a few large nodes. This
+		///		reinserts all elements and also releases the memory of freed nodes.
+		void compact();
+
+		/// @brief Memory of all nodes including the freed ones, which are reused.
+		size_t memoryUsage() const { return m_allocator.memoryUsage(); }
+
 		/* Interface of the Processor
 			struct TreeProcessor
 			{
@@ -54,12 +70,14 @@ namespace utils {
 			m_rootNode->traverse(proc);
 		}
 		/// @brief Processor which retrieves all elements which overlap with the given AABB.
+		/// @param _resource Memory for the hits, e.g. a FrameArena for per-frame queries.
 		struct AABBQuery
 		{
-			AABBQuery(const AABB& _aabb) : aabb(_aabb) {}
+			AABBQuery(const AABB& _aabb, std::pmr::memory_resource* _resource = std::pmr::get_default_resource())
+				: aabb(_aabb), hits(_resource) {}
 
 			AABB aabb;
-			std::vector<T> hits;
+			std::pmr::vector<T> hits;
 
 			bool descend(const AABB& currentBox) const
 			{
@@ -76,18 +94,21 @@ namespace utils {
 	private:
 		constexpr static FloatT MIN_SIZE = 1.0 / (2 << 3);
 
-		void initRoot(FloatT _size)
+		void initRoot(const VecT& _min, FloatT _size)
 		{
 			AABB box;
 			for (int i = 0; i < Dim; ++i)
 			{
-				box.min[i] = 0;
-				box.max[i] = _size;
+				box.min[i] = _min[i];
+				box.max[i] = _min[i] + _size;
 			}
 
 			m_rootNode = m_allocator.create(box);
 		}
 
+		// Replace the root by its only child while the root holds no elements.
+		void shrinkRoot();
+
 		struct Node
 		{
 			explicit Node(const AABB& _box) noexcept
@@ -133,7 +154,9 @@ namespace utils {
 			}
 
 			// Search in the tree rooted at this node and remove the element if found.
-			bool remove(const AABB& _boundingBox, const T& el)
+			// Children which become empty are destroyed.
+			template<typename Alloc>
+			bool remove(const AABB& _boundingBox, const T& el, Alloc& _allocator)
 			{
 				if (box.max[0] - box.min[0] <= MIN_SIZE)
 				{
@@ -144,7 +167,8 @@ namespace utils {
 				int index = 0;
 				for (int i = 0; i < Dim; ++i)
 				{
-					if (_boundingBox.min[i] < center[i] && _boundingBox.max[i] >= center[i])
+					// same condition as in insert()
+					if (_boundingBox.min[i] < center[i] && _boundingBox.max[i] > center[i])
 					{
 						return remove(el);
 					}
@@ -155,10 +179,16 @@ namespace utils {
 					}
 				}
 
-				if (childs[index]) 
-					return childs[index]->remove(_boundingBox, el);
+				Node* child = childs[index];
+				if (!child || !child->remove(_boundingBox, el, _allocator))
+					return false;
 
-				return false;
+				if (child->isEmpty())
+				{
+					_allocator.destroy(child);
+					childs[index] = nullptr;
+				}
+				return true;
 			}
 
 			// Remove element from this node.
@@ -176,6 +206,25 @@ namespace utils {
 				return true;
 			}
 
+			// No elements in the subtree. Empty children are always freed, so it
+			// suffices to check this node.
+			bool isEmpty() const
+			{
+				if (!elements.empty()) return false;
+				for (Node* child : childs)
+					if (child) return false;
+				return true;
+			}
+
+			// Move all elements of the subtree into _elements.
+			void collect(std::vector<std::pair<AABB, T>>& _elements)
+			{
+				for (auto& el : elements)
+					_elements.push_back(std::move(el));
+				for (Node* child : childs)
+					if (child) child->collect(_elements);
+			}
+
 			template<typename Proc>
 			void traverse(Proc& _proc) const
 			{
@@ -240,7 +289,74 @@ namespace utils {
 	template<typename T, int Dim, typename FloatT>
 	bool SparseOctree<T, Dim, FloatT>::remove(const AABB& _boundingBox, const T& el)
 	{
-		return m_rootNode->remove(_boundingBox, el);
+		if (!m_rootNode->remove(_boundingBox, el, m_allocator))
+			return false;
+
+		shrinkRoot();
+		return true;
+	}
+
+	template<typename T, int Dim, typename FloatT>
+	void SparseOctree<T, Dim, FloatT>::compact()
+	{
+		std::vector<std::pair<AABB, T>> elements;
+		m_rootNode->collect(elements);
+		m_allocator.reset();
+		if (elements.empty())
+		{
+			initRoot(VecT(0), m_size);
+			return;
+		}
+
+		AABB bounds = elements.front().first;
+		for (const auto& [box, el] : elements)
+		{
+			bounds.min = glm::min(bounds.min, box.min);
+			bounds.max = glm::max(bounds.max, box.max);
+		}
+		FloatT size = 0;
+		for (int i = 0; i < Dim; ++i)
+			size = std::max(size, bounds.max[i] - bounds.min[i]);
+
+		// isIn() requires the maximum to be strictly inside the root
+		initRoot(bounds.min, size + MIN_SIZE);
+		for (const auto& [box, el] : elements)
+			insert(box, el);
+	}
+
+	template<typename T, int Dim, typename FloatT>
+	void SparseOctree<T, Dim, FloatT>::shrinkRoot()
+	{
+		while (m_rootNode->elements.empty())
+		{
+			Node* child = nullptr;
+			int numChilds = 0;
+			for (Node* node : m_rootNode->childs)
+			{
+				if (node)
+				{
+					child = node;
+					++numChilds;
+				}
+			}
+
+			if (numChilds == 0)
+			{
+				// the tree is empty, start over with the initial root
+				const AABB initialBox(VecT(0), VecT(m_size));
+				if (m_rootNode->box != initialBox)
+				{
+					m_allocator.destroy(m_rootNode);
+					initRoot(VecT(0), m_size);
+				}
+				return;
+			}
+			if (numChilds > 1 || child->box.max[0] - child->box.min[0] < m_size)
+				return;
+
+			m_allocator.destroy(m_rootNode);
+			m_rootNode = child;
+		}
 	}
 
 
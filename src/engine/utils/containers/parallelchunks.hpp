@@ -0,0 +1,95 @@
+#pragma once
+
+#include "../threadpool.hpp"
+#include <memory>
+#include <numeric>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+namespace utils {
+
+	/// Splitting of dense arrays into chunks for parallel processing.
+	/// The chunks only depend on the array, not on the number of threads, so reductions
+	/// give the same result for any pool.
+	namespace details {
+		constexpr size_t CACHE_LINE_SIZE = 64;
+		constexpr size_t CHUNK_BYTES = 4096;
+
+		/// Number of elements per chunk. It is a multiple of the number of elements
+		/// after which the offset within a cache line repeats, so if one chunk starts
+		/// on a cache line all following chunks do as well.
+		constexpr size_t chunkSize(size_t _elementSize)
+		{
+			const size_t elementsPerLine = CACHE_LINE_SIZE / std::gcd(_elementSize, CACHE_LINE_SIZE);
+			const size_t elements = std::max<size_t>(1, CHUNK_BYTES / _elementSize);
+			return (elements + elementsPerLine - 1) / elementsPerLine * elementsPerLine;
+		}
+
+		/// Chunks of [0, _numElements) for an array starting at _data. The first chunk
+		/// is shortened up to the first element on a cache line boundary, so neighbouring
+		/// chunks do not share cache lines. If no element is aligned all chunks are full.
+		class ChunkGrid
+		{
+		public:
+			ChunkGrid(const void* _data, size_t _numElements, size_t _elementSize)
+				: m_numElements(_numElements),
+				m_size(chunkSize(_elementSize)),
+				m_shift(0)
+			{
+				const size_t elementsPerLine = CACHE_LINE_SIZE / std::gcd(_elementSize, CACHE_LINE_SIZE);
+				const uintptr_t address = reinterpret_cast<uintptr_t>(_data);
+				for (size_t i = 1; i < elementsPerLine; ++i)
+					if ((address + i * _elementSize) % CACHE_LINE_SIZE == 0)
+					{
+						m_shift = m_size - i;
+						break;
+					}
+			}
+
+			size_t numChunks() const { return (m_numElements + m_shift + m_size - 1) / m_size; }
+			size_t begin(size_t _chunk) const { return std::max(_chunk * m_size, m_shift) - m_shift; }
+			size_t end(size_t _chunk) const { return std::min((_chunk + 1) * m_size - m_shift, m_numElements); }
+		private:
+			size_t m_numElements;
+			size_t m_size;
+			size_t m_shift;
+		};
+
+		/// Call _func(begin, end) for all chunks of [0, _numElements) in parallel.
+		template<typename Func>
+		void parallelChunks(const void* _data, size_t _numElements, size_t _elementSize, ThreadPool& _pool, Func&& _func)
+		{
+			const ChunkGrid chunks(_data, _numElements, _elementSize);
+			_pool.run(chunks.numChunks(), [&](size_t _chunk)
+				{
+					_func(chunks.begin(_chunk), chunks.end(_chunk));
+				});
+		}
+
+		/// Reduce each chunk with _func(T& accumulator, begin, end) starting from _init and
+		/// combine the chunk results in chunk order with _combine(T, T) -> T.
+		/// _init has to be the identity of _combine.
+		template<typename T, typename Func, typename Combine>
+		T parallelReduceChunks(const void* _data, size_t _numElements, size_t _elementSize, ThreadPool& _pool,
+			const T& _init, Func&& _func, Combine&& _combine)
+		{
+			const ChunkGrid chunks(_data, _numElements, _elementSize);
+			const size_t numChunks = chunks.numChunks();
+			// not a std::vector, which would pack bool results into shared words
+			std::unique_ptr<T[]> results = std::make_unique<T[]>(numChunks);
+			_pool.run(numChunks, [&](size_t _chunk)
+				{
+					// accumulate locally to avoid false sharing of the results
+					T accumulator = _init;
+					_func(accumulator, chunks.begin(_chunk), chunks.end(_chunk));
+					results[_chunk] = std::move(accumulator);
+				});
+
+			T result = _init;
+			for (size_t i = 0; i < numChunks; ++i)
+				result = _combine(std::move(result), std::move(results[i]));
+			return result;
+		}
+	}
+}
@@ -0,0 +1,415 @@
+#pragma once
+
+#include "snapshot.hpp"
+#include "dynamicbitset.hpp"
+#include <vector>
+#include <algorithm>
+#include <limits>
+#include <concepts>
+#include <cstdint>
+#include <type_traits>
+#include <span>
+
+namespace utils {
+
+	namespace details {
+		/// Indices [0, _size) in the order defined by _less(indexA, indexB).
+		/// Equivalent elements keep their relative order.
+		template<std::integral Key, typename Less>
+		std::vector<Key> sortedPermutation(Key _size, Less&& _less)
+		{
+			std::vector<Key> permutation(_size);
+			for (Key i = 0; i < _size; ++i)
+				permutation[i] = i;
+			std::stable_sort(permutation.begin(), permutation.end(), _less);
+			return permutation;
+		}
+
+		/// Indices into _keys in ascending key order. Equal keys keep their relative order.
+		/// LSD radix sort over the bytes which are actually used by the keys (compared as unsigned).
+		template<std::integral Key>
+		std::vector<Key> keyPermutation(std::span<const Key> _keys)
+		{
+			using UKey = std::make_unsigned_t<Key>;
+			const size_t n = _keys.size();
+			std::vector<Key> permutation(n);
+			for (size_t i = 0; i < n; ++i)
+				permutation[i] = static_cast<Key>(i);
+
+			UKey maxKey = 0;
+			for (Key key : _keys)
+				maxKey = std::max(maxKey, static_cast<UKey>(key));
+
+			std::vector<Key> buffer(n);
+			for (unsigned shift = 0; shift < sizeof(Key) * 8 && (maxKey >> shift) != 0; shift += 8)
+			{
+				size_t offsets[257] = {};
+				for (Key key : _keys)
+					++offsets[((static_cast<UKey>(key) >> shift) & 0xff) + 1];
+				for (int i = 1; i < 257; ++i)
+					offsets[i] += offsets[i - 1];
+				for (Key ind : permutation)
+					buffer[offsets[(static_cast<UKey>(_keys[ind]) >> shift) & 0xff]++] = ind;
+				permutation.swap(buffer);
+			}
+			return permutation;
+		}
+		template<std::integral Key>
+		std::vector<Key> keyPermutation(const std::vector<Key>& _keys)
+		{
+			return keyPermutation(std::span<const Key>(_keys));
+		}
+
+		/// Sort _values ascending with an LSD radix sort (compared as unsigned).
+		template<std::integral Key>
+		void radixSort(std::span<Key> _values)
+		{
+			using UKey = std::make_unsigned_t<Key>;
+			UKey maxValue = 0;
+			for (Key value : _values)
+				maxValue = std::max(maxValue, static_cast<UKey>(value));
+
+			std::vector<Key> buffer(_values.size());
+			std::span<Key> src = _values;
+			std::span<Key> dst = buffer;
+			for (unsigned shift = 0; shift < sizeof(Key) * 8 && (maxValue >> shift) != 0; shift += 8)
+			{
+				size_t offsets[257] = {};
+				for (Key value : src)
+					++offsets[((static_cast<UKey>(value) >> shift) & 0xff) + 1];
+				for (int i = 1; i < 257; ++i)
+					offsets[i] += offsets[i - 1];
+				for (Key value : src)
+					dst[offsets[(static_cast<UKey>(value) >> shift) & 0xff]++] = value;
+				std::swap(src, dst);
+			}
+			if (src.data() != _values.data())
+				std::copy(src.begin(), src.end(), _values.begin());
+		}
+
+		/// Reorder elements in place such that element _permutation[i] ends up at position i.
+		/// Every cycle of the permutation is walked once: _save(i) moves element i into a
+		/// temporary, _move(dst, src) moves between positions and _restore(i) moves the
+		/// temporary to position i. The permutation is consumed.
+		template<std::integral Key, typename Save, typename Move, typename Restore>
+		void applyPermutation(std::vector<Key>& _permutation, Save&& _save, Move&& _move, Restore&& _restore)
+		{
+			for (Key start = 0; start < static_cast<Key>(_permutation.size()); ++start)
+			{
+				if (_permutation[start] == start) continue;
+
+				_save(start);
+				Key cur = start;
+				while (_permutation[cur] != start)
+				{
+					const Key next = _permutation[cur];
+					_move(cur, next);
+					_permutation[cur] = cur;
+					cur = next;
+				}
+				_restore(cur);
+				_permutation[cur] = cur;
+			}
+		}
+
+		/// Replace _keys by their indices in _slots, reset their slots and return the existing
+		/// ones in descending order. Resetting while looking up drops duplicates and touches
+		/// every slot only once. Removing elements in this order with swap-remove moves
+		/// every remaining element at most once.
+		template<std::integral Key, typename SlotIndex>
+		std::span<Key> eraseOrder(std::span<Key> _keys, SlotIndex& _slots)
+		{
+			for (Key& key : _keys)
+			{
+				const Key ind = _slots.get(key);
+				if (ind != SlotIndex::INVALID) _slots.reset(key);
+				key = ind;
+			}
+			// remove not existing keys first, so that the sort only has to look at the used bytes
+			const auto end = std::remove(_keys.begin(), _keys.end(), SlotIndex::INVALID);
+			std::span<Key> indices(_keys.begin(), end);
+			radixSort(indices);
+			std::reverse(indices.begin(), indices.end());
+			return indices;
+		}
+
+		/// Check that a restored slot index and key array describe the same elements: every
+		/// key maps back to its index and the slot index contains no further keys.
+		template<std::integral Key, typename SlotIndex>
+		bool isConsistent(const SlotIndex& _slots, std::span<const Key> _valuesToSlots)
+		{
+			if (_slots.numKeys() != _valuesToSlots.size()) return false;
+			for (size_t i = 0; i < _valuesToSlots.size(); ++i)
+				if (_slots.get(_valuesToSlots[i]) != static_cast<Key>(i)) return false;
+			return true;
+		}
+	}
+
+	/// Sparse part of the slot maps: maps keys to indices into the dense value arrays.
+	/// All implementations return INVALID for keys which have not been set.
+
+	/// One array entry for every key up to the largest key used.
+	/// Fastest access, but the memory is proportional to the largest key.
+	template<std::integral Key>
+	class DenseSlotIndex
+	{
+	public:
+		constexpr static Key INVALID = std::numeric_limits<Key>::max();
+
+		Key get(Key _key) const
+		{
+			return static_cast<size_t>(_key) < m_slots.size() ? m_slots[_key] : INVALID;
+		}
+
+		void set(Key _key, Key _index)
+		{
+			if (m_slots.size() <= static_cast<size_t>(_key))
+				m_slots.resize(static_cast<size_t>(_key) + 1, INVALID);
+			m_slots[_key] = _index;
+		}
+
+		void reset(Key _key) { m_slots[_key] = INVALID; }
+
+		// Make room for all keys up to _maxKey, so that set() does not grow the index.
+		void reserve(Key _maxKey)
+		{
+			if (m_slots.size() <= static_cast<size_t>(_maxKey))
+				m_slots.resize(static_cast<size_t>(_maxKey) + 1, INVALID);
+		}
+
+		void clear() { m_slots.clear(); }
+
+		// Number of keys which are set. Linear in the largest key.
+		size_t numKeys() const { return m_slots.size() - static_cast<size_t>(std::count(m_slots.begin(), m_slots.end(), INVALID)); }
+
+		size_t memoryUsage() const { return m_slots.capacity() * sizeof(Key); }
+
+		void snapshot(BinaryWriter& _writer) const { details::writeArray(_writer, std::span<const Key>(m_slots)); }
+		bool restore(BinaryReader& _reader) { return details::readArray(_reader, m_slots); }
+	private:
+		std::vector<Key> m_slots;
+	};
+
+	/// Splits the key range into pages of PageSize entries which are only allocated
+	/// when a key inside them is set. Unused pages point to a single shared page of
+	/// invalid entries, so get() needs no branch beyond the range check. Pages are
+	/// released once their last key is reset.
+	/// \tparam PageSize Number of keys per page, must be a power of two.
+	template<std::integral Key, size_t PageSize = 1024>
+	class PagedSlotIndex
+	{
+		static_assert((PageSize & (PageSize - 1)) == 0, "PageSize must be a power of two.");
+	public:
+		constexpr static Key INVALID = std::numeric_limits<Key>::max();
+
+		PagedSlotIndex() = default;
+		PagedSlotIndex(PagedSlotIndex&& _oth) noexcept = default;
+		PagedSlotIndex& operator=(PagedSlotIndex&& _oth) noexcept
+		{
+			clear();
+			m_pages = std::move(_oth.m_pages);
+			m_pageCounts = std::move(_oth.m_pageCounts);
+			return *this;
+		}
+
+		~PagedSlotIndex() { clear(); }
+
+		Key get(Key _key) const
+		{
+			const size_t page = static_cast<size_t>(_key) / PageSize;
+			return page < m_pages.size() ? m_pages[page][static_cast<size_t>(_key) % PageSize] : INVALID;
+		}
+
+		void set(Key _key, Key _index)
+		{
+			const size_t page = static_cast<size_t>(_key) / PageSize;
+			if (m_pages.size() <= page)
+			{
+				m_pages.resize(page + 1, emptyPage());
+				m_pageCounts.resize(page + 1, 0);
+			}
+			if (m_pages[page] == emptyPage())
+			{
+				m_pages[page] = new Key[PageSize];
+				std::fill_n(m_pages[page], PageSize, INVALID);
+			}
+
+			Key& slot = m_pages[page][static_cast<size_t>(_key) % PageSize];
+			if (slot == INVALID) ++m_pageCounts[page];
+			slot = _index;
+		}
+
+		void reset(Key _key)
+		{
+			const size_t page = static_cast<size_t>(_key) / PageSize;
+			m_pages[page][static_cast<size_t>(_key) % PageSize] = INVALID;
+			if (--m_pageCounts[page] == 0)
+			{
+				delete[] m_pages[page];
+				m_pages[page] = emptyPage();
+			}
+		}
+
+		// Make room for the page table up to _maxKey. Pages are still allocated on demand.
+		void reserve(Key _maxKey)
+		{
+			const size_t page = static_cast<size_t>(_maxKey) / PageSize;
+			if (m_pages.size() <= page)
+			{
+				m_pages.resize(page + 1, emptyPage());
+				m_pageCounts.resize(page + 1, 0);
+			}
+		}
+
+		void clear()
+		{
+			for (Key* page : m_pages)
+				if (page != emptyPage()) delete[] page;
+			m_pages.clear();
+			m_pageCounts.clear();
+		}
+
+		size_t numKeys() const
+		{
+			size_t num = 0;
+			for (uint32_t count : m_pageCounts) num += count;
+			return num;
+		}
+
+		size_t memoryUsage() const
+		{
+			size_t usage = m_pages.capacity() * sizeof(Key*) + m_pageCounts.capacity() * sizeof(uint32_t);
+			for (const Key* page : m_pages)
+				if (page != emptyPage()) usage += PageSize * sizeof(Key);
+			return usage;
+		}
+
+		// Only pages in use are stored, each preceded by its number of keys.
+		void snapshot(BinaryWriter& _writer) const
+		{
+			_writer.write(static_cast<uint64_t>(m_pages.size()));
+			for (size_t i = 0; i < m_pages.size(); ++i)
+			{
+				_writer.write(m_pageCounts[i]);
+				if (m_pageCounts[i]) _writer.write(m_pages[i], PageSize * sizeof(Key));
+			}
+		}
+
+		bool restore(BinaryReader& _reader)
+		{
+			clear();
+			uint64_t numPages = 0;
+			if (!_reader.read(numPages) || numPages > _reader.remaining() / sizeof(uint32_t)) return false;
+			m_pages.resize(numPages, emptyPage());
+			m_pageCounts.resize(numPages, 0);
+			for (size_t i = 0; i < numPages; ++i)
+			{
+				if (!_reader.read(m_pageCounts[i]) || m_pageCounts[i] > PageSize) return false;
+				if (m_pageCounts[i])
+				{
+					m_pages[i] = new Key[PageSize];
+					if (!_reader.read(m_pages[i], PageSize * sizeof(Key))) return false;
+					// reset() releases the page based on the count
+					const size_t numSet = PageSize - static_cast<size_t>(std::count(m_pages[i], m_pages[i] + PageSize, INVALID));
+					if (numSet != m_pageCounts[i]) return false;
+				}
+			}
+			return true;
+		}
+	private:
+		// Shared by all unused pages. It is intentionally never freed, so that indices
+		// destroyed during static destruction can still recognize it.
+		static Key* emptyPage()
+		{
+			static Key* const page = []()
+			{
+				Key* p = new Key[PageSize];
+				std::fill_n(p, PageSize, INVALID);
+				return p;
+			}();
+			return page;
+		}
+
+		std::vector<Key*> m_pages;
+		std::vector<uint32_t> m_pageCounts;
+	};
+
+	/// Wraps another slot index and additionally keeps one presence bit per key.
+	/// The keys of several maps can then be intersected with bitwise ANDs instead of
+	/// contains() calls, see keyintersection.hpp. Costs one bit per key up to the
+	/// largest key used.
+	template<std::integral Key, typename Base = DenseSlotIndex<Key>>
+	class PresenceSlotIndex
+	{
+	public:
+		using KeyType = Key;
+		constexpr static Key INVALID = Base::INVALID;
+
+		Key get(Key _key) const { return m_base.get(_key); }
+
+		void set(Key _key, Key _index)
+		{
+			m_base.set(_key, _index);
+			if (m_presence.size() <= static_cast<size_t>(_key))
+				m_presence.resize(static_cast<size_t>(_key) + 1);
+			m_presence.set(static_cast<size_t>(_key));
+		}
+
+		void reset(Key _key)
+		{
+			m_base.reset(_key);
+			m_presence.reset(static_cast<size_t>(_key));
+		}
+
+		void reserve(Key _maxKey)
+		{
+			m_base.reserve(_maxKey);
+			if (m_presence.size() <= static_cast<size_t>(_maxKey))
+				m_presence.resize(static_cast<size_t>(_maxKey) + 1);
+		}
+
+		void clear()
+		{
+			m_base.clear();
+			m_presence.resize(0);
+		}
+
+		size_t numKeys() const { return m_base.numKeys(); }
+
+		size_t memoryUsage() const { return m_base.memoryUsage() + m_presence.words().size() * sizeof(DynamicBitset::Word); }
+
+		void snapshot(BinaryWriter& _writer) const
+		{
+			m_base.snapshot(_writer);
+			_writer.write(static_cast<uint64_t>(m_presence.size()));
+			_writer.write(m_presence.words().data(), m_presence.words().size_bytes());
+		}
+
+		bool restore(BinaryReader& _reader)
+		{
+			m_presence.resize(0);
+			uint64_t size = 0;
+			if (!m_base.restore(_reader) || !_reader.read(size) || size / 8 > _reader.remaining()) return false;
+			m_presence.resize(size);
+			const std::span<DynamicBitset::Word> words = m_presence.words();
+			if (!_reader.read(words.data(), words.size_bytes())) return false;
+			// unused bits of the last word have to be 0
+			if (size % DynamicBitset::BITS_PER_WORD != 0
+				&& (words.back() >> (size % DynamicBitset::BITS_PER_WORD)) != 0)
+				return false;
+
+			// the bits have to match the keys of the base index
+			bool valid = m_presence.count() == m_base.numKeys();
+			m_presence.forEachSet([&](size_t _key)
+				{
+					valid = valid && m_base.get(static_cast<Key>(_key)) != INVALID;
+				});
+			return valid;
+		}
+
+		const DynamicBitset& presence() const { return m_presence; }
+	private:
+		Base m_base;
+		DynamicBitset m_presence;
+	};
+}
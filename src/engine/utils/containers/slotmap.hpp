@@ -1,48 +1,126 @@
 #pragma once
 
 #include "../../utils/assert.hpp"
+#include "slotindex.hpp"
+#include "parallelchunks.hpp"
+#include "dynamicbitset.hpp"
+#include "snapshot.hpp"
+#include <spdlog/spdlog.h>
 #include <vector>
+#include <span>
+#include <algorithm>
 #include <limits>
 #include <utility>
 #include <concepts>
+#include <optional>
+#include <type_traits>
 
 namespace utils {
-	template<std::integral Key, std::movable Value>
+	/// \tparam SlotIndex Maps keys to value indices, see slotindex.hpp.
+	///		Use PagedSlotIndex if the keys are large and sparse.
+	/// \tparam TrackChanges Keep a dirty flag per element. It is set by emplace(), the
+	///		non-const operator[] and markDirty(); iteration does not set it.
+	template<std::integral Key, std::movable Value, typename SlotIndex = DenseSlotIndex<Key>, bool TrackChanges = false>
 	class SlotMap
 	{
 	protected:
 		constexpr static Key INVALID_SLOT = std::numeric_limits<Key>::max();
+		// snapshots store the arrays as a whole instead of element by element
+		constexpr static bool BULK_SNAPSHOT = std::is_trivially_copyable_v<Value>;
 	public:
+		using KeyType = Key;
+
 		template<typename... Args>
 		Value& emplace(Key _key, Args&&... _args)
 		{
-			// increase slots if necessary
-			if (m_slots.size() <= _key)
-				m_slots.resize(_key + 1, INVALID_SLOT);
-			else if(m_slots[_key] != INVALID_SLOT) // already exists
-				return m_values[m_slots[_key]];
+			const Key slot = m_slots.get(_key);
+			if (slot != INVALID_SLOT) // already exists
+			{
+				if constexpr (TrackChanges) m_dirty.set(slot);
+				return m_values[slot];
+			}
 
-			m_slots[_key] = static_cast<Key>(m_values.size());
+			m_slots.set(_key, static_cast<Key>(m_values.size()));
 
 			m_valuesToSlots.emplace_back(_key);
+			if constexpr (TrackChanges) m_dirty.pushBack(true);
 			return m_values.emplace_back(std::forward<Args>(_args)...);
 		}
 
-		void erase(Key _key)
+		// Add _values[i] for each _keys[i]. Keys which exist already keep their value,
+		// of duplicate keys only the first is added. Makes room for all elements at once.
+		// If all keys are new, the values are copied as one block.
+		void emplaceRange(std::span<const Key> _keys, std::span<const Value> _values)
 		{
-			ASSERT(contains(_key), "Trying to delete a not existing element.");
+			ASSERT(_keys.size() == _values.size(), "Each key requires exactly one value.");
+			if (_keys.empty()) return;
 
-			const Key ind = m_slots[_key];
-			m_slots[_key] = INVALID_SLOT;
+			reserve(m_values.size() + _keys.size());
+			m_slots.reserve(*std::max_element(_keys.begin(), _keys.end()));
+			const std::size_t first = m_values.size();
+			for (Key key : _keys)
+			{
+				if (m_slots.get(key) != INVALID_SLOT) continue;
+				m_slots.set(key, static_cast<Key>(m_valuesToSlots.size()));
+				m_valuesToSlots.push_back(key);
+			}
 
-			if (ind+1 < m_values.size())
+			if (m_valuesToSlots.size() - first == _keys.size())
+				m_values.insert(m_values.end(), _values.begin(), _values.end());
+			else
 			{
-				m_values[ind] = std::move(m_values.back());
-				m_slots[m_valuesToSlots.back()] = ind;
-				m_valuesToSlots[ind] = m_valuesToSlots.back();
+				// new elements got their indices in the order of their first occurrence
+				for (std::size_t i = 0; i < _keys.size(); ++i)
+					if (m_slots.get(_keys[i]) == m_values.size()) m_values.push_back(_values[i]);
 			}
-			m_values.pop_back();
-			m_valuesToSlots.pop_back();
+			if constexpr (TrackChanges) m_dirty.resize(m_values.size(), true);
+		}
+
+		// Add the elements [_firstKey, _firstKey + _count) with the values _generator(Key).
+		// Keys which exist already keep their value and _generator is not called for them.
+		template<typename Generator>
+		void emplaceN(Key _firstKey, Key _count, Generator&& _generator)
+		{
+			if (_count == 0) return;
+
+			reserve(m_values.size() + _count);
+			m_slots.reserve(static_cast<Key>(_firstKey + _count - 1));
+			for (Key key = _firstKey; key != static_cast<Key>(_firstKey + _count); ++key)
+			{
+				if (m_slots.get(key) != INVALID_SLOT) continue;
+				m_slots.set(key, static_cast<Key>(m_values.size()));
+				m_valuesToSlots.push_back(key);
+				m_values.emplace_back(_generator(key));
+			}
+			if constexpr (TrackChanges) m_dirty.resize(m_values.size(), true);
+		}
+
+		void erase(Key _key)
+		{
+			ASSERT(contains(_key), "Trying to delete a not existing element.");
+
+			const Key ind = m_slots.get(_key);
+			m_slots.reset(_key);
+			removeIndex(ind);
+		}
+
+		// Erase all elements in _keys. Keys which do not exist or occur multiple times are
+		// ignored. The elements are removed in descending storage order, so each remaining
+		// element is moved at most once. _keys is used as scratch memory.
+		void eraseBatch(std::span<Key> _keys)
+		{
+			for (Key ind : details::eraseOrder(_keys, m_slots))
+				removeIndex(ind);
+		}
+
+		// Make room for _size elements. Grows at least geometrically, so that repeated
+		// calls with slightly larger sizes do not copy the elements every time.
+		void reserve(std::size_t _size)
+		{
+			if (_size <= m_values.capacity()) return;
+			_size = std::max(_size, 2 * m_values.capacity());
+			m_values.reserve(_size);
+			m_valuesToSlots.reserve(_size);
 		}
 
 		void clear()
@@ -50,6 +128,20 @@ namespace utils {
 			m_slots.clear();
 			m_valuesToSlots.clear();
 			m_values.clear();
+			if constexpr (TrackChanges) m_dirty.resize(0);
+		}
+
+		// Reorder the values by ascending key, so that iteration accesses keys in order.
+		void sort()
+		{
+			applyPermutation(keyOrder());
+		}
+
+		// Reorder the values with a custom order, _less(const Value&, const Value&).
+		template<typename Less>
+		void sortBy(Less&& _less)
+		{
+			applyPermutation(valueOrder(_less));
 		}
 
 		// iterators
@@ -69,63 +161,268 @@ namespace utils {
 			bool operator==(const Iterator& _oth) const { ASSERT(&m_target == &_oth.m_target, "Comparing iterators of different containers."); return m_index == _oth.m_index; }
 			bool operator!=(const Iterator& _oth) const { ASSERT(&m_target == &_oth.m_target, "Comparing iterators of different containers."); return m_index != _oth.m_index; }
 		private:
-			std::size_t m_index;
 			SlotMap& m_target;
+			std::size_t m_index;
 		};
 		auto begin() { return Iterator(*this, 0); }
 		auto end() { return Iterator(*this, m_values.size()); }
 
+		// Call _func(Key, Value&) for all elements. The dense values are split into chunks
+		// which are processed in parallel on _pool. _func must not add or remove elements.
+		template<typename Func>
+		void parallelForEach(Func&& _func, ThreadPool& _pool = ThreadPool::global())
+		{
+			details::parallelChunks(m_values.data(), m_values.size(), sizeof(Value), _pool, [&](size_t _begin, size_t _end)
+				{
+					for (size_t i = _begin; i < _end; ++i)
+						_func(m_valuesToSlots[i], m_values[i]);
+				});
+		}
+
+		// Each chunk accumulates its elements with _func(T&, Key, const Value&) starting from _init.
+		// The chunk results are combined with _combine(T, T) -> T in a fixed order, so the
+		// result does not depend on the number of threads.
+		template<typename T, typename Func, typename Combine>
+		T parallelReduce(const T& _init, Func&& _func, Combine&& _combine, ThreadPool& _pool = ThreadPool::global()) const
+		{
+			return details::parallelReduceChunks(m_values.data(), m_values.size(), sizeof(Value), _pool, _init,
+				[&](T& _accumulator, size_t _begin, size_t _end)
+				{
+					for (size_t i = _begin; i < _end; ++i)
+						_func(_accumulator, m_valuesToSlots[i], m_values[i]);
+				}, _combine);
+		}
+
 		// access operations
-		bool contains(Key _key) const { return _key < m_slots.size() && m_slots[_key] != INVALID_SLOT; }
+		bool contains(Key _key) const { return m_slots.get(_key) != INVALID_SLOT; }
 		
-		Value& operator[](Key _key) { return m_values[m_slots[_key]]; }
-		const Value& operator[](Key _key) const { return m_values[m_slots[_key]]; }
+		Value& operator[](Key _key)
+		{
+			if constexpr (TrackChanges) m_dirty.set(m_slots.get(_key));
+			return m_values[m_slots.get(_key)];
+		}
+		const Value& operator[](Key _key) const { return m_values[m_slots.get(_key)]; }
 
 		std::size_t size() const { return m_values.size(); }
+		const SlotIndex& slotIndex() const { return m_slots; }
 		bool empty() const { return m_values.empty(); }
+
+		// Write all elements to _writer, see snapshot.hpp. Trivially copyable values are
+		// stored as whole arrays together with the slot index, other values are written
+		// one by one with Serializer<Value>.
+		void snapshot(BinaryWriter& _writer) const
+		{
+			details::writeSnapshotHeader(_writer, details::SnapshotKind::SlotMap,
+				sizeof(Key), sizeof(Value), BULK_SNAPSHOT, m_values.size());
+			if constexpr (BULK_SNAPSHOT)
+			{
+				m_slots.snapshot(_writer);
+				_writer.write(m_valuesToSlots.data(), m_valuesToSlots.size() * sizeof(Key));
+				_writer.write(m_values.data(), m_values.size() * sizeof(Value));
+			}
+			else
+			{
+				for (std::size_t i = 0; i < m_values.size(); ++i)
+				{
+					_writer.write(m_valuesToSlots[i]);
+					Serializer<Value>::write(_writer, m_values[i]);
+				}
+			}
+		}
+
+		// Replace the content with a snapshot of a map with the same types.
+		// The order of the elements is preserved and all of them are marked as dirty.
+		// On failure the map is empty afterwards.
+		bool restore(BinaryReader& _reader) requires std::default_initializable<Value>
+		{
+			clear();
+			if (!restoreElements(_reader))
+			{
+				spdlog::error("[utils] Invalid or incompatible SlotMap snapshot.");
+				clear();
+				return false;
+			}
+			if constexpr (TrackChanges) m_dirty.resize(m_values.size(), true);
+			return true;
+		}
+
+		// change tracking
+		void markDirty(Key _key) requires TrackChanges
+		{
+			ASSERT(contains(_key), "Trying to mark a non existing element.");
+			m_dirty.set(m_slots.get(_key));
+		}
+		bool isDirty(Key _key) const requires TrackChanges { return m_dirty.test(m_slots.get(_key)); }
+		std::size_t numDirty() const requires TrackChanges { return m_dirty.count(); }
+		void clearDirty() requires TrackChanges { m_dirty.fill(false); }
+
+		// Call _func(Key, Value&) for all elements which are marked as dirty.
+		// The cost is proportional to size() / 64 plus the number of dirty elements.
+		template<typename Func>
+		void forEachDirty(Func&& _func) requires TrackChanges
+		{
+			m_dirty.forEachSet([&](size_t _ind) { _func(m_valuesToSlots[_ind], m_values[_ind]); });
+		}
 	protected:
+		bool restoreElements(BinaryReader& _reader)
+		{
+			const int64_t size = details::readSnapshotHeader(_reader, details::SnapshotKind::SlotMap,
+				sizeof(Key), sizeof(Value), BULK_SNAPSHOT);
+			if (size < 0 || static_cast<uint64_t>(size) >= static_cast<uint64_t>(INVALID_SLOT)
+				|| static_cast<uint64_t>(size) > _reader.remaining() / sizeof(Key))
+				return false;
+
+			if constexpr (BULK_SNAPSHOT)
+			{
+				if (!m_slots.restore(_reader)
+					|| static_cast<uint64_t>(size) > _reader.remaining() / (sizeof(Key) + sizeof(Value)))
+					return false;
+				m_valuesToSlots.resize(size);
+				m_values.resize(size);
+				return _reader.read(m_valuesToSlots.data(), size * sizeof(Key))
+					&& _reader.read(m_values.data(), size * sizeof(Value))
+					&& details::isConsistent(m_slots, std::span<const Key>(m_valuesToSlots));
+			}
+			else
+			{
+				reserve(size);
+				for (int64_t i = 0; i < size; ++i)
+				{
+					Key key;
+					Value value;
+					if (!_reader.read(key) || !Serializer<Value>::read(_reader, value) || contains(key))
+						return false;
+					emplace(key, std::move(value));
+				}
+				return true;
+			}
+		}
+
+		std::vector<Key> keyOrder() const
+		{
+			return details::keyPermutation(m_valuesToSlots);
+		}
+
+		template<typename Less>
+		std::vector<Key> valueOrder(Less&& _less) const
+		{
+			return details::sortedPermutation(static_cast<Key>(m_values.size()),
+				[&](Key a, Key b) { return _less(m_values[a], m_values[b]); });
+		}
+
+		// swap-remove of the element at _ind, the slot has to be reset already
+		void removeIndex(Key _ind)
+		{
+			if (_ind+1 < m_values.size())
+			{
+				m_values[_ind] = std::move(m_values.back());
+				m_slots.set(m_valuesToSlots.back(), _ind);
+				m_valuesToSlots[_ind] = m_valuesToSlots.back();
+				if constexpr (TrackChanges) m_dirty.set(_ind, m_dirty.test(m_values.size() - 1));
+			}
+			m_values.pop_back();
+			m_valuesToSlots.pop_back();
+			if constexpr (TrackChanges) m_dirty.popBack();
+		}
 
-		std::vector<Key> m_slots;
+		// Exchange the elements at _a and _b together with their keys and dirty flags.
+		void swapIndices(Key _a, Key _b)
+		{
+			if (_a == _b) return;
+			using std::swap;
+			swap(m_values[_a], m_values[_b]);
+			swap(m_valuesToSlots[_a], m_valuesToSlots[_b]);
+			m_slots.set(m_valuesToSlots[_a], _a);
+			m_slots.set(m_valuesToSlots[_b], _b);
+			if constexpr (TrackChanges)
+			{
+				const bool dirtyA = m_dirty.test(_a);
+				m_dirty.set(_a, m_dirty.test(_b));
+				m_dirty.set(_b, dirtyA);
+			}
+		}
+
+		// Move the value at _permutation[i] to i and update the slots.
+		void applyPermutation(std::vector<Key> _permutation)
+		{
+			std::optional<Value> tempValue;
+			Key tempKey = INVALID_SLOT;
+			// the dirty flags travel with the values
+			[[maybe_unused]] bool tempDirty = false;
+			details::applyPermutation(_permutation,
+				[&](Key _ind)
+				{
+					tempValue.emplace(std::move(m_values[_ind]));
+					tempKey = m_valuesToSlots[_ind];
+					if constexpr (TrackChanges) tempDirty = m_dirty.test(_ind);
+				},
+				[&](Key _dst, Key _src)
+				{
+					m_values[_dst] = std::move(m_values[_src]);
+					m_valuesToSlots[_dst] = m_valuesToSlots[_src];
+					if constexpr (TrackChanges) m_dirty.set(_dst, m_dirty.test(_src));
+				},
+				[&](Key _ind)
+				{
+					m_values[_ind] = std::move(*tempValue);
+					m_valuesToSlots[_ind] = tempKey;
+					if constexpr (TrackChanges) m_dirty.set(_ind, tempDirty);
+				});
+
+			for (Key i = 0; i < static_cast<Key>(m_values.size()); ++i)
+				m_slots.set(m_valuesToSlots[i], i);
+		}
+
+		template<typename... Maps>
+		friend class SlotMapGroup;
+
+		SlotIndex m_slots;
 		std::vector<Key> m_valuesToSlots;
 		std::vector<Value> m_values;
+		[[no_unique_address]] std::conditional_t<TrackChanges, DynamicBitset, details::NoChangeTracking> m_dirty;
 	};
 
 	// Allows multiple values for the same Key to be stored.
-	template<typename Key, typename Value>
-	class MultiSlotMap : public SlotMap<Key, Value>
+	template<typename Key, typename Value, typename SlotIndex = DenseSlotIndex<Key>>
+	class MultiSlotMap : public SlotMap<Key, Value, SlotIndex>
 	{
-		using Base = SlotMap<Key, Value>;
+		using Base = SlotMap<Key, Value, SlotIndex>;
 	public:
 		template<typename... Args>
 		Value& emplace(Key _key, Args&&... _args)
 		{
-			if (Base::contains(_key))
+			const Key ind = Base::m_slots.get(_key);
+			const Key newInd = static_cast<Key>(Base::m_values.size());
+			if (ind != Base::INVALID_SLOT)
 			{
-				const Key ind = Base::m_slots[_key];
 				m_links.push_back({ind, Base::INVALID_SLOT });
-				m_links[ind].next = static_cast<Key>(Base::m_values.size());
-				// Base::emplace will set this slot
-				Base::m_slots[_key] = Base::INVALID_SLOT; // m_links[ind].next;
+				m_links[ind].next = newInd;
 			}
 			else
 				m_links.push_back({ Base::INVALID_SLOT, Base::INVALID_SLOT });
 			
-			return Base::emplace(_key, std::forward<Args>(_args)...);
+			// the slot always refers to the last added value
+			Base::m_slots.set(_key, newInd);
+			Base::m_valuesToSlots.emplace_back(_key);
+			return Base::m_values.emplace_back(std::forward<Args>(_args)...);
 		}
 
 		// erases all components associated with this entity
 		void erase(Key _key)
 		{
-			const Key ind = Base::m_slots[_key];
+			const Key ind = Base::m_slots.get(_key);
 			Key cur = ind;
 			do{
 				Key temp = m_links[cur].prev;
+				// the last value is moved into the erased slot
+				const Key last = static_cast<Key>(Base::m_values.size() - 1);
 				eraseSlot(cur);
+				if (temp == last) temp = cur;
 				cur = temp;
 
 			} while (cur != Base::INVALID_SLOT);
 
-			Base::m_slots[_key] = Base::INVALID_SLOT;
+			Base::m_slots.reset(_key);
 		}
 
 		void clear()
@@ -133,7 +430,59 @@ namespace utils {
 			Base::clear();
 			m_links.clear();
 		}
+
+		// not supported, the links between the values of a key would be lost
+		void emplaceRange(std::span<const Key>, std::span<const Value>) = delete;
+		template<typename Generator>
+		void emplaceN(Key, Key, Generator&&) = delete;
+		void eraseBatch(std::span<Key>) = delete;
+		void snapshot(BinaryWriter&) const = delete;
+		bool restore(BinaryReader&) = delete;
+
+		// Call _func(Value&) for all values of _key, starting with the last added.
+		template<typename Func>
+		void forEach(Key _key, Func&& _func)
+		{
+			for (Key cur = Base::m_slots.get(_key); cur != Base::INVALID_SLOT; cur = m_links[cur].prev)
+				_func(Base::m_values[cur]);
+		}
+
+		// Reorder the values by ascending key. All values of a key become neighbours
+		// and keep their insertion order.
+		void sort()
+		{
+			applyPermutation(Base::keyOrder());
+		}
+
+		// Reorder the values with a custom order, _less(const Value&, const Value&).
+		template<typename Less>
+		void sortBy(Less&& _less)
+		{
+			applyPermutation(Base::valueOrder(_less));
+		}
 	private:
+		void applyPermutation(std::vector<Key> _permutation)
+		{
+			std::vector<Key> newIndex(_permutation.size());
+			for (Key i = 0; i < static_cast<Key>(_permutation.size()); ++i)
+				newIndex[_permutation[i]] = i;
+
+			std::vector<Link> links(m_links.size());
+			for (Key i = 0; i < static_cast<Key>(links.size()); ++i)
+			{
+				const Link& link = m_links[_permutation[i]];
+				links[i].prev = link.prev != Base::INVALID_SLOT ? newIndex[link.prev] : Base::INVALID_SLOT;
+				links[i].next = link.next != Base::INVALID_SLOT ? newIndex[link.next] : Base::INVALID_SLOT;
+			}
+			m_links = std::move(links);
+
+			Base::applyPermutation(std::move(_permutation));
+			// the slot has to refer to the last value of each key
+			for (Key i = 0; i < static_cast<Key>(m_links.size()); ++i)
+				if (m_links[i].next == Base::INVALID_SLOT)
+					Base::m_slots.set(Base::m_valuesToSlots[i], i);
+		}
+
 		void eraseSlot(Key _slot)
 		{
 			if (m_links[_slot].prev != Base::INVALID_SLOT) m_links[m_links[_slot].prev].next = Base::INVALID_SLOT;
@@ -147,7 +496,7 @@ namespace utils {
 				const Link& link = m_links.back();
 				if (link.prev != Base::INVALID_SLOT) m_links[link.prev].next = _slot;
 				if (link.next != Base::INVALID_SLOT) m_links[link.next].prev = _slot;
-				else Base::m_slots[Base::m_valuesToSlots.back()] = _slot;
+				else Base::m_slots.set(Base::m_valuesToSlots.back(), _slot);
 				m_links[_slot] = m_links.back();
 			}
 			Base::m_values.pop_back();
@@ -0,0 +1,171 @@
+#pragma once
+
+#include "slotmap.hpp"
+#include "weakslotmap.hpp"
+#include <tuple>
+#include <array>
+#include <span>
+#include <utility>
+#include <type_traits>
+
+namespace utils {
+
+	namespace details {
+		template<typename Map>
+		struct IsWeakSlotMap : std::false_type {};
+
+		template<typename Key, bool TrivialDestruct, typename SlotIndex, typename Storage, bool TrackChanges>
+		struct IsWeakSlotMap<WeakSlotMap<Key, TrivialDestruct, SlotIndex, Storage, TrackChanges>> : std::true_type {};
+	}
+
+	/// Keeps the keys which are present in all of 2 to 4 SlotMaps or WeakSlotMaps
+	/// at the front of each map in the same order. Joint iteration over these keys
+	/// is then a parallel linear scan without any lookups.
+	/// \details The group is maintained by swapping elements in and out of the front
+	///		range, which changes the iteration order of the maps. Elements have to be
+	///		added and erased through the group, or add() / remove() have to be called
+	///		after emplacing and before erasing directly. Operations which reorder a map
+	///		(sort(), eraseBatch(), restore(), clear()) invalidate the group; call
+	///		rebuild() afterwards. A map can be part of at most one group.
+	///		Example: SlotMapGroup group(transforms, velocities);
+	///		group.forEach<Transform, const Velocity>([](Key, Transform&, const Velocity&) {...});
+	template<typename... Maps>
+	class SlotMapGroup
+	{
+		static_assert(sizeof...(Maps) >= 2 && sizeof...(Maps) <= 4, "A group consists of 2 to 4 maps.");
+		using FirstMap = std::tuple_element_t<0, std::tuple<Maps...>>;
+	public:
+		using Key = typename FirstMap::KeyType;
+
+		explicit SlotMapGroup(Maps&... _maps) : m_maps(&_maps...), m_scratch{ scratch(_maps)... }
+		{
+			static_assert((std::is_same_v<typename Maps::KeyType, Key> && ...), "All maps need the same key type.");
+			rebuild();
+		}
+
+		// Add _key to map I and to the group if it is now present in all maps.
+		template<size_t I, typename Value, typename... Args>
+		Value& emplace(Key _key, Args&&... _args)
+		{
+			auto& map = *std::get<I>(m_maps);
+			if constexpr (details::IsWeakSlotMap<std::remove_cvref_t<decltype(map)>>::value)
+				map.template emplace<Value>(_key, std::forward<Args>(_args)...);
+			else
+				map.emplace(_key, std::forward<Args>(_args)...);
+			add(_key);
+			// joining the group moves the element
+			return element<Value>(map, map.m_slots.get(_key));
+		}
+
+		// Remove _key from the group and erase it from map I.
+		template<size_t I>
+		void erase(Key _key)
+		{
+			remove(_key);
+			std::get<I>(m_maps)->erase(_key);
+		}
+
+		// Notify the group that _key was added to one of the maps.
+		// Does nothing if _key is not present in all maps or already grouped.
+		void add(Key _key)
+		{
+			if (!std::apply([&](auto*... _map) { return (_map->contains(_key) && ...); }, m_maps)
+				|| std::get<0>(m_maps)->m_slots.get(_key) < m_size)
+				return;
+
+			swapElements(_key, m_size, std::index_sequence_for<Maps...>{});
+			++m_size;
+		}
+
+		// Notify the group that _key is about to be erased from one of the maps.
+		// Does nothing if _key is not grouped.
+		void remove(Key _key)
+		{
+			if (!contains(_key)) return;
+
+			--m_size;
+			swapElements(_key, m_size, std::index_sequence_for<Maps...>{});
+		}
+
+		// Recreate the group from the current content of the maps.
+		void rebuild()
+		{
+			m_size = 0;
+			auto& first = *std::get<0>(m_maps);
+			// elements before i are either grouped or not present in all maps
+			for (Key i = 0; i < static_cast<Key>(first.m_valuesToSlots.size()); ++i)
+				add(first.m_valuesToSlots[i]);
+		}
+
+		// Call _func(Key, Values&...) for all grouped keys with one value type per map.
+		// _func must not add or remove elements.
+		template<typename... Values, typename Func>
+		void forEach(Func&& _func)
+		{
+			static_assert(sizeof...(Values) == sizeof...(Maps), "One value type per map is required.");
+			forEachImpl<Values...>(_func, std::index_sequence_for<Maps...>{});
+		}
+
+		bool contains(Key _key) const
+		{
+			const auto& first = *std::get<0>(m_maps);
+			return first.contains(_key) && first.m_slots.get(_key) < m_size;
+		}
+
+		// The grouped keys in iteration order.
+		std::span<const Key> keys() const { return { std::get<0>(m_maps)->m_valuesToSlots.data(), m_size }; }
+		size_t size() const { return m_size; }
+		bool empty() const { return m_size == 0; }
+	private:
+		// Exchange the element of _key with the element at _ind in every map.
+		template<size_t... Is>
+		void swapElements(Key _key, Key _ind, std::index_sequence<Is...>)
+		{
+			(swapElement(*std::get<Is>(m_maps), _key, _ind, m_scratch[Is].get()), ...);
+		}
+
+		template<typename Map>
+		static void swapElement(Map& _map, Key _key, Key _ind, char* _scratch)
+		{
+			if constexpr (details::IsWeakSlotMap<Map>::value)
+				_map.swapIndices(_map.m_slots.get(_key), _ind, _scratch);
+			else
+				_map.swapIndices(_map.m_slots.get(_key), _ind);
+		}
+
+		// Type erased values are swapped through a buffer which is allocated only once.
+		template<typename Map>
+		static details::AlignedBuffer scratch(const Map& _map)
+		{
+			if constexpr (details::IsWeakSlotMap<Map>::value)
+				return _map.allocateScratch();
+			else
+				return details::AlignedBuffer(nullptr, details::AlignedDelete{});
+		}
+
+		template<typename... Values, typename Func, size_t... Is>
+		void forEachImpl(Func& _func, std::index_sequence<Is...>)
+		{
+			const Key* keys = std::get<0>(m_maps)->m_valuesToSlots.data();
+			for (Key i = 0; i < m_size; ++i)
+				_func(keys[i], element<Values>(*std::get<Is>(m_maps), i)...);
+		}
+
+		template<typename Value, typename Map>
+		static Value& element(Map& _map, Key _ind)
+		{
+			if constexpr (details::IsWeakSlotMap<Map>::value)
+				return _map.template get<std::remove_const_t<Value>>(_ind);
+			else
+			{
+				static_assert(std::is_same_v<std::remove_const_t<Value>, typename decltype(_map.m_values)::value_type>,
+					"The value type of the map is required.");
+				return _map.m_values[_ind];
+			}
+		}
+
+		std::tuple<Maps*...> m_maps;
+		std::array<details::AlignedBuffer, sizeof...(Maps)> m_scratch;
+		Key m_size = 0;
+	};
+}
@@ -0,0 +1,146 @@
+#pragma once
+
+#include "../alloctracker.hpp"
+#include <vector>
+#include <memory>
+#include <bit>
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <new>
+#include <type_traits>
+
+namespace utils {
+
+	/// Value storage policies for the type erased WeakSlotMap.
+	/// The element size is only known at runtime. Storages provide raw memory for
+	/// elements [0, capacity()) and never construct or destroy elements themselves.
+	/// Every element is aligned to the alignment passed to init().
+
+	namespace details {
+		struct AlignedDelete
+		{
+			std::align_val_t alignment;
+			size_t size;
+			void operator()(char* _ptr) const
+			{
+				AllocTracker::deallocate(AllocTag::SLOT_MAP, size);
+				::operator delete[](_ptr, alignment);
+			}
+		};
+		using AlignedBuffer = std::unique_ptr<char[], AlignedDelete>;
+
+		inline AlignedBuffer allocateAligned(size_t _size, size_t _alignment)
+		{
+			const std::align_val_t alignment{ _alignment };
+			AlignedBuffer buffer(static_cast<char*>(::operator new[](_size, alignment)), AlignedDelete{ alignment, _size });
+			AllocTracker::allocate(AllocTag::SLOT_MAP, _size);
+			return buffer;
+		}
+	}
+
+	/// All elements in one array. Growing relocates every element.
+	class ContiguousStorage
+	{
+	public:
+		// Elements are not stable, growing moves them.
+		constexpr static bool STABLE = false;
+
+		void init(size_t _elementSize, size_t _alignment, size_t _capacity)
+		{
+			m_elementSize = _elementSize;
+			m_alignment = _alignment;
+			m_capacity = _capacity;
+			m_data = details::allocateAligned(m_elementSize * m_capacity, m_alignment);
+		}
+
+		char* at(size_t _ind) const { return m_data.get() + _ind * m_elementSize; }
+
+		size_t capacity() const { return m_capacity; }
+
+		/// Call _func(char* begin, size_t count) for consecutive runs of the elements [_begin, _end).
+		template<typename Func>
+		void forEachRange(size_t _begin, size_t _end, Func&& _func) const
+		{
+			if (_begin < _end) _func(at(_begin), _end - _begin);
+		}
+
+		/// Make room for at least _capacity elements. The first _size elements are
+		/// moved with _relocate(dst, src) which has to move construct and destroy src.
+		/// Pass nullptr as _relocate for trivially relocatable elements to copy them bitwise.
+		template<typename Relocate>
+		void reserve(size_t _capacity, size_t _size, Relocate&& _relocate)
+		{
+			if (_capacity <= m_capacity) return;
+
+			_capacity = std::max(_capacity, m_capacity * 2);
+			details::AlignedBuffer data = details::allocateAligned(m_elementSize * _capacity, m_alignment);
+			if constexpr (std::is_null_pointer_v<std::remove_cvref_t<Relocate>>)
+			{
+				if (_size) std::memcpy(data.get(), m_data.get(), _size * m_elementSize);
+			}
+			else
+			{
+				for (size_t i = 0; i < _size; ++i)
+					_relocate(data.get() + i * m_elementSize, at(i));
+			}
+			m_data = std::move(data);
+			m_capacity = _capacity;
+		}
+	private:
+		size_t m_elementSize = 0;
+		size_t m_alignment = alignof(std::max_align_t);
+		size_t m_capacity = 0;
+		details::AlignedBuffer m_data;
+	};
+
+	/// Elements are stored in blocks of about BlockBytes. Growing only adds blocks,
+	/// so existing elements never move and pointers stay valid until erase.
+	/// Each block holds a power of two number of elements to keep the access cheap.
+	template<size_t BlockBytes = 16384>
+	class ChunkedStorage
+	{
+	public:
+		constexpr static bool STABLE = true;
+
+		void init(size_t _elementSize, size_t _alignment, size_t _capacity)
+		{
+			m_elementSize = _elementSize;
+			m_alignment = _alignment;
+			const size_t elementsPerBlock = std::bit_floor(std::max<size_t>(1, BlockBytes / _elementSize));
+			m_shift = std::countr_zero(elementsPerBlock);
+			m_mask = elementsPerBlock - 1;
+			m_blocks.clear();
+			reserve(_capacity, 0, nullptr);
+		}
+
+		char* at(size_t _ind) const { return m_blocks[_ind >> m_shift].get() + (_ind & m_mask) * m_elementSize; }
+
+		size_t capacity() const { return m_blocks.size() << m_shift; }
+
+		template<typename Func>
+		void forEachRange(size_t _begin, size_t _end, Func&& _func) const
+		{
+			while (_begin < _end)
+			{
+				// up to the end of the current block
+				const size_t count = std::min((_begin | m_mask) + 1, _end) - _begin;
+				_func(at(_begin), count);
+				_begin += count;
+			}
+		}
+
+		template<typename Relocate>
+		void reserve(size_t _capacity, size_t, Relocate&&)
+		{
+			while (capacity() < _capacity)
+				m_blocks.push_back(details::allocateAligned(m_elementSize << m_shift, m_alignment));
+		}
+	private:
+		size_t m_elementSize = 0;
+		size_t m_alignment = alignof(std::max_align_t);
+		size_t m_shift = 0;
+		size_t m_mask = 0;
+		std::vector<details::AlignedBuffer> m_blocks;
+	};
+}
@@ -0,0 +1,189 @@
+#pragma once
+
+#include <ostream>
+#include <string>
+#include <span>
+#include <typeinfo>
+#include <cstring>
+#include <cstdint>
+#include <type_traits>
+
+namespace utils {
+
+	/// Binary snapshots of containers for saving and fast reloads.
+	/// Containers with trivially copyable elements store their internal arrays as a
+	/// whole, so a snapshot consists of a few large writes and restoring is a few
+	/// memcpys, e.g. directly from a MappedFile. Other elements are written one by
+	/// one with a Serializer. All data is stored in the native byte order.
+
+	/// Sequential output of a snapshot into a stream.
+	class BinaryWriter
+	{
+	public:
+		explicit BinaryWriter(std::ostream& _stream) : m_stream(_stream) {}
+
+		void write(const void* _data, size_t _size)
+		{
+			m_stream.write(static_cast<const char*>(_data), static_cast<std::streamsize>(_size));
+		}
+
+		template<typename T>
+			requires std::is_trivially_copyable_v<T>
+		void write(const T& _value) { write(&_value, sizeof(T)); }
+
+		// False if any write failed.
+		bool good() const { return static_cast<bool>(m_stream); }
+	private:
+		std::ostream& m_stream;
+	};
+
+	/// Sequential input of a snapshot from memory.
+	/// Reading beyond the end fails without touching the destination, after that
+	/// all further reads fail as well.
+	class BinaryReader
+	{
+	public:
+		explicit BinaryReader(std::span<const char> _data) : m_data(_data) {}
+
+		bool read(void* _dst, size_t _size)
+		{
+			if (m_failed || _size > remaining())
+			{
+				m_failed = true;
+				return false;
+			}
+			if (_size) std::memcpy(_dst, m_data.data() + m_position, _size);
+			m_position += _size;
+			return true;
+		}
+
+		template<typename T>
+			requires std::is_trivially_copyable_v<T>
+		bool read(T& _value) { return read(&_value, sizeof(T)); }
+
+		size_t remaining() const { return m_data.size() - m_position; }
+		bool failed() const { return m_failed; }
+	private:
+		std::span<const char> m_data;
+		size_t m_position = 0;
+		bool m_failed = false;
+	};
+
+	/// Conversion of single elements which are not trivially copyable.
+	/// Specialize with static void write(BinaryWriter&, const T&) and
+	/// static bool read(BinaryReader&, T&) to restore containers of other types.
+	template<typename T>
+	struct Serializer;
+
+	template<typename T>
+		requires std::is_trivially_copyable_v<T>
+	struct Serializer<T>
+	{
+		static void write(BinaryWriter& _writer, const T& _value) { _writer.write(_value); }
+		static bool read(BinaryReader& _reader, T& _value) { return _reader.read(_value); }
+	};
+
+	template<>
+	struct Serializer<std::string>
+	{
+		static void write(BinaryWriter& _writer, const std::string& _value)
+		{
+			_writer.write(static_cast<uint64_t>(_value.size()));
+			_writer.write(_value.data(), _value.size());
+		}
+
+		static bool read(BinaryReader& _reader, std::string& _value)
+		{
+			uint64_t size = 0;
+			if (!_reader.read(size) || size > _reader.remaining()) return false;
+			_value.resize(size);
+			return _reader.read(_value.data(), size);
+		}
+	};
+
+	namespace details {
+		enum struct SnapshotKind : uint32_t
+		{
+			SlotMap,
+			WeakSlotMap,
+			HashMap
+		};
+
+		/// Leading block of every container snapshot to detect incompatible data.
+		struct SnapshotHeader
+		{
+			static constexpr uint32_t MAGIC = 0x504e5341; // "ASNP" in little endian
+			static constexpr uint32_t VERSION = 2;
+
+			uint32_t magic;
+			uint32_t version;
+			SnapshotKind kind;
+			uint32_t keySize;
+			uint32_t valueSize;
+			uint32_t bulk; // internal arrays are stored as a whole
+			uint64_t size;
+			uint64_t policy; // identifies policies the internal arrays depend on, see typeFingerprint()
+		};
+
+		/// Hash of the names of the types Ts. The names depend on the compiler, which is
+		/// fine for snapshots in the native byte order.
+		template<typename... Ts>
+		uint64_t typeFingerprint()
+		{
+			uint64_t hash = 14695981039346656037ull;
+			for (const char* name : { typeid(Ts).name()... })
+				for (; *name; ++name)
+					hash = (hash ^ static_cast<uint8_t>(*name)) * 1099511628211ull;
+			return hash;
+		}
+
+		inline void writeSnapshotHeader(BinaryWriter& _writer, SnapshotKind _kind,
+			size_t _keySize, size_t _valueSize, bool _bulk, size_t _size, uint64_t _policy = 0)
+		{
+			SnapshotHeader header{};
+			header.magic = SnapshotHeader::MAGIC;
+			header.version = SnapshotHeader::VERSION;
+			header.kind = _kind;
+			header.keySize = static_cast<uint32_t>(_keySize);
+			header.valueSize = static_cast<uint32_t>(_valueSize);
+			header.bulk = _bulk;
+			header.size = _size;
+			header.policy = _policy;
+			_writer.write(header);
+		}
+
+		/// Read the header and compare it with the expected layout.
+		/// \returns The number of stored elements or -1 if the snapshot does not fit.
+		inline int64_t readSnapshotHeader(BinaryReader& _reader, SnapshotKind _kind,
+			size_t _keySize, size_t _valueSize, bool _bulk, uint64_t _policy = 0)
+		{
+			SnapshotHeader header;
+			if (!_reader.read(header) || header.magic != SnapshotHeader::MAGIC
+				|| header.version != SnapshotHeader::VERSION || header.kind != _kind
+				|| header.keySize != _keySize || header.valueSize != _valueSize
+				|| header.bulk != static_cast<uint32_t>(_bulk) || header.size > INT64_MAX
+				|| header.policy != _policy)
+				return -1;
+			return static_cast<int64_t>(header.size);
+		}
+
+		/// Write an array with its length.
+		template<typename T>
+		void writeArray(BinaryWriter& _writer, std::span<const T> _data)
+		{
+			_writer.write(static_cast<uint64_t>(_data.size()));
+			_writer.write(_data.data(), _data.size_bytes());
+		}
+
+		/// Read an array written by writeArray() into _data which is resized accordingly.
+		template<typename Vector>
+		bool readArray(BinaryReader& _reader, Vector& _data)
+		{
+			using T = typename Vector::value_type;
+			uint64_t size = 0;
+			if (!_reader.read(size) || size > _reader.remaining() / sizeof(T)) return false;
+			_data.resize(size);
+			return _reader.read(_data.data(), size * sizeof(T));
+		}
+	}
+}
@@ -3,29 +3,51 @@
 #include "../../utils/assert.hpp"
 #include "../../utils/metaproghelpers.hpp"
 #include "iteratorrange.hpp"
+#include "slotindex.hpp"
+#include "slotstorage.hpp"
+#include "dynamicbitset.hpp"
+#include "snapshot.hpp"
+#include <spdlog/spdlog.h>
 #include <vector>
+#include <span>
+#include <algorithm>
 #include <limits>
 #include <utility>
 #include <concepts>
 #include <memory>
+#include <cstring>
+#include <type_traits>
 
 namespace utils {
-	template<std::integral Key, bool TrivialDestruct = false>
+	/// \tparam SlotIndex Maps keys to value indices, see slotindex.hpp.
+	///		Use PagedSlotIndex if the keys are large and sparse.
+	/// \tparam Storage Memory for the values, see slotstorage.hpp.
+	///		Use ChunkedStorage if references have to stay valid while adding elements.
+	/// \tparam TrackChanges Keep a dirty flag per element. It is set by emplace(), the
+	///		non-const at() and markDirty(); iteration does not set it.
+	/// Values are stored with their natural alignment. Trivially copyable values are
+	/// moved with memcpy instead of the type erased move operations.
+	template<std::integral Key, bool TrivialDestruct = false, typename SlotIndex = DenseSlotIndex<Key>,
+		typename Storage = ContiguousStorage, bool TrackChanges = false>
 	class WeakSlotMap
 	{
 	protected:
 		constexpr static Key INVALID_SLOT = std::numeric_limits<Key>::max();
 	public:
+		using KeyType = Key;
 		using SizeType = Key;
 
 		template<std::movable Value>
 		WeakSlotMap(utils::TypeHolder<Value>, SizeType _initialSize = 4)
 			: m_elementSize(sizeof(Value)),
+			m_alignment(alignof(Value)),
+			m_trivialRelocate(std::is_trivially_copyable_v<Value>),
 			m_destructor(destroyElement<Value>),
-			m_move(moveElement<Value>)
+			m_move(moveElement<Value>),
+			m_moveConstruct(moveConstructElement<Value>)
 		{
 			m_valuesToSlots.reserve(_initialSize);
-			m_values.reset(new char[index(capacity())]);
+			m_values.init(sizeof(Value), alignof(Value), _initialSize);
 
 			static_assert(std::is_trivially_destructible_v<Value> || !TrivialDestruct,
 				"Managed elements require a destructor call.");
@@ -33,22 +55,31 @@ namespace utils {
 
 		WeakSlotMap(WeakSlotMap&& _oth) noexcept
 			: m_elementSize(_oth.m_elementSize),
+			m_alignment(_oth.m_alignment),
+			m_trivialRelocate(_oth.m_trivialRelocate),
 			m_destructor(_oth.m_destructor),
 			m_move(_oth.m_move),
+			m_moveConstruct(_oth.m_moveConstruct),
 			m_values(std::move(_oth.m_values)),
 			m_slots(std::move(_oth.m_slots)),
-			m_valuesToSlots(std::move(_oth.m_valuesToSlots))
+			m_valuesToSlots(std::move(_oth.m_valuesToSlots)),
+			m_dirty(std::move(_oth.m_dirty))
 		{
 		}
 
 		WeakSlotMap& operator=(WeakSlotMap&& _oth) noexcept
 		{
+			destroyValues();
 			m_elementSize = _oth.m_elementSize;
+			m_alignment = _oth.m_alignment;
+			m_trivialRelocate = _oth.m_trivialRelocate;
 			m_destructor = _oth.m_destructor;
 			m_move = _oth.m_move;
+			m_moveConstruct = _oth.m_moveConstruct;
 			m_values = std::move(_oth.m_values);
 			m_slots = std::move(_oth.m_slots);
 			m_valuesToSlots = std::move(_oth.m_valuesToSlots);
+			m_dirty = std::move(_oth.m_dirty);
 
 			return *this;
 		}
@@ -62,50 +93,122 @@ namespace utils {
 		template<std::movable Value, typename... Args>
 		Value& emplace(Key _key, Args&&... _args)
 		{
-			// increase slots if necessary
-			if (static_cast<Key>(m_slots.size()) <= _key)
-				m_slots.resize(_key + 1, INVALID_SLOT);
-			else if(m_slots[_key] != INVALID_SLOT) // already exists
+			if (m_slots.get(_key) != INVALID_SLOT) // already exists
 				return at<Value>(_key);
 
-			const SizeType oldCapacity = static_cast<SizeType>(m_valuesToSlots.size());
-			m_slots[_key] = size();
+			const SizeType ind = size();
+			if constexpr (std::is_trivially_copyable_v<Value>)
+				m_values.reserve(ind + 1, ind, nullptr);
+			else
+			{
+				m_values.reserve(ind + 1, ind, [](char* _dst, char* _src)
+					{
+						Value& src = *reinterpret_cast<Value*>(_src);
+						new(_dst) Value(std::move(src));
+						src.~Value();
+					});
+			}
+			m_slots.set(_key, ind);
 			m_valuesToSlots.emplace_back(_key);
-			const SizeType newCapacity = static_cast<SizeType>(m_valuesToSlots.size());
+			if constexpr (TrackChanges) m_dirty.pushBack(true);
+			
+			return *new (m_values.at(ind)) Value (std::forward<Args>(_args)...);
+		}
 
-			if (oldCapacity != newCapacity)
+		// Add _values[i] for each _keys[i]. Keys which exist already keep their value,
+		// of duplicate keys only the first is added. Makes room for all elements at once.
+		// If all keys are new, trivially copyable values are copied with memcpy.
+		template<std::movable Value>
+		void emplaceRange(std::span<const Key> _keys, std::span<const Value> _values)
+		{
+			ASSERT(_keys.size() == _values.size(), "Each key requires exactly one value.");
+			if (_keys.empty()) return;
+
+			const SizeType first = size();
+			reserve(static_cast<SizeType>(first + _keys.size()));
+			m_slots.reserve(*std::max_element(_keys.begin(), _keys.end()));
+			for (Key key : _keys)
+			{
+				if (m_slots.get(key) != INVALID_SLOT) continue;
+				m_slots.set(key, size());
+				m_valuesToSlots.push_back(key);
+			}
+
+			if constexpr (std::is_trivially_copyable_v<Value>)
 			{
-				char* newBuf = new char[index(newCapacity)];
-				for (SizeType i = 0; i < oldCapacity; ++i)
+				if (size() - first == _keys.size())
 				{
-					new(&newBuf[index(i)]) Value(std::move(get<Value>(i)));
-					get<Value>(i).~Value();
+					const char* src = reinterpret_cast<const char*>(_values.data());
+					m_values.forEachRange(first, size(), [&](char* _dst, size_t _count)
+						{
+							std::memcpy(_dst, src, _count * sizeof(Value));
+							src += _count * sizeof(Value);
+						});
+					if constexpr (TrackChanges) m_dirty.resize(size(), true);
+					return;
 				}
+			}
+			// new elements got their indices in the order of their first occurrence
+			SizeType ind = first;
+			for (size_t i = 0; i < _keys.size() && ind < size(); ++i)
+				if (m_slots.get(_keys[i]) == ind) new (m_values.at(ind++)) Value(_values[i]);
+			if constexpr (TrackChanges) m_dirty.resize(size(), true);
+		}
 
-				m_values.reset(newBuf);
+		// Add the elements [_firstKey, _firstKey + _count) with the values _generator(Key).
+		// Keys which exist already keep their value and _generator is not called for them.
+		template<std::movable Value, typename Generator>
+		void emplaceN(Key _firstKey, Key _count, Generator&& _generator)
+		{
+			if (_count == 0) return;
+
+			reserve(static_cast<SizeType>(size() + _count));
+			m_slots.reserve(static_cast<Key>(_firstKey + _count - 1));
+			for (Key key = _firstKey; key != static_cast<Key>(_firstKey + _count); ++key)
+			{
+				if (m_slots.get(key) != INVALID_SLOT) continue;
+				const SizeType ind = size();
+				m_slots.set(key, ind);
+				m_valuesToSlots.push_back(key);
+				new (m_values.at(ind)) Value(_generator(key));
 			}
-			
-			return *new (&get<Value>(oldCapacity)) Value (std::forward<Args>(_args)...);
+			if constexpr (TrackChanges) m_dirty.resize(size(), true);
 		}
 
 		void erase(Key _key)
 		{
 			ASSERT(contains(_key), "Trying to delete a non existing element.");
 
-			const Key ind = m_slots[_key];
-			m_slots[_key] = INVALID_SLOT;
-			// effectively get() but without knowing the type
-			char* back = &m_values[index(size() - 1)];
+			const Key ind = m_slots.get(_key);
+			m_slots.reset(_key);
+			removeIndex(ind);
+		}
 
-			if (ind+1 < size())
+		// Erase all elements in _keys. Keys which do not exist or occur multiple times are
+		// ignored. The elements are removed in descending storage order, so each remaining
+		// element is moved at most once. _keys is used as scratch memory.
+		void eraseBatch(std::span<Key> _keys)
+		{
+			for (Key ind : details::eraseOrder(_keys, m_slots))
+				removeIndex(ind);
+		}
+
+		// Make room for _size elements with a single relocation.
+		// Grows at least geometrically like emplace().
+		void reserve(SizeType _size)
+		{
+			if (_size > m_valuesToSlots.capacity())
+				m_valuesToSlots.reserve(std::max<size_t>(_size, 2 * m_valuesToSlots.capacity()));
+			if (m_trivialRelocate)
+				m_values.reserve(_size, size(), nullptr);
+			else
 			{
-				m_move(&m_values[index(ind)], back);
-				m_slots[m_valuesToSlots.back()] = ind;
-				m_valuesToSlots[ind] = m_valuesToSlots.back();
+				m_values.reserve(_size, size(), [this](char* _dst, char* _src)
+					{
+						m_moveConstruct(_dst, _src);
+						m_destructor(_src);
+					});
 			}
-
-			if constexpr (!TrivialDestruct) m_destructor(back);
-			m_valuesToSlots.pop_back();
 		}
 
 		void clear()
@@ -113,6 +216,22 @@ namespace utils {
 			destroyValues();
 			m_slots.clear();
 			m_valuesToSlots.clear();
+			if constexpr (TrackChanges) m_dirty.resize(0);
+		}
+
+		// Reorder the values by ascending key, so that iteration accesses keys in order.
+		// Works without knowing the value type.
+		void sort()
+		{
+			applyPermutation(details::keyPermutation(m_valuesToSlots));
+		}
+
+		// Reorder the values with a custom order, _less(const Value&, const Value&).
+		template<typename Value, typename Less>
+		void sortBy(Less&& _less)
+		{
+			applyPermutation(details::sortedPermutation(size(),
+				[&](Key a, Key b) { return _less(get<Value>(a), get<Value>(b)); }));
 		}
 
 		// iterators
@@ -130,38 +249,249 @@ namespace utils {
 		auto iterate() const { return ConstIteratorRange<WeakSlotMap, Key, Value, Accessor<Value>>(*this); }
 
 		// access operations
-		bool contains(Key _key) const { return _key < static_cast<Key>(m_slots.size()) && m_slots[_key] != INVALID_SLOT; }
+		bool contains(Key _key) const { return m_slots.get(_key) != INVALID_SLOT; }
 		
 		template<typename Value>
 		Value& at(Key _key) 
 		{
 			ASSERT(contains(_key), "Trying to access a non existing element.");
-			return reinterpret_cast<Value&>(m_values[index(m_slots[_key])]); 
+			if constexpr (TrackChanges) m_dirty.set(m_slots.get(_key));
+			return reinterpret_cast<Value&>(*m_values.at(m_slots.get(_key))); 
 		}
 		template<typename Value>
 		const Value& at(Key _key) const 
 		{
 			ASSERT(contains(_key), "Trying to access a non existing element.");
-			return reinterpret_cast<const Value&>(m_values[index(m_slots[_key])]); 
+			return reinterpret_cast<const Value&>(*m_values.at(m_slots.get(_key))); 
 		}
 
 		SizeType size() const { return static_cast<SizeType>(m_valuesToSlots.size()); }
-		SizeType capacity() const { return static_cast<SizeType>(m_valuesToSlots.capacity()); }
+		const SlotIndex& slotIndex() const { return m_slots; }
+		SizeType capacity() const { return static_cast<SizeType>(m_values.capacity()); }
 		bool empty() const { return m_valuesToSlots.empty(); }
+
+		// Write all elements to _writer, see snapshot.hpp. Trivially copyable values are
+		// stored as whole arrays together with the slot index, other values are written
+		// one by one with Serializer<Value>.
+		template<typename Value>
+		void snapshot(BinaryWriter& _writer) const
+		{
+			ASSERT(sizeof(Value) == m_elementSize, "Snapshot with a different value type.");
+			constexpr bool bulk = std::is_trivially_copyable_v<Value>;
+			details::writeSnapshotHeader(_writer, details::SnapshotKind::WeakSlotMap,
+				sizeof(Key), sizeof(Value), bulk, size());
+			if constexpr (bulk)
+			{
+				m_slots.snapshot(_writer);
+				_writer.write(m_valuesToSlots.data(), m_valuesToSlots.size() * sizeof(Key));
+				m_values.forEachRange(0, size(), [&](const char* _begin, size_t _count)
+					{
+						_writer.write(_begin, _count * sizeof(Value));
+					});
+			}
+			else
+			{
+				for (SizeType i = 0; i < size(); ++i)
+				{
+					_writer.write(m_valuesToSlots[i]);
+					Serializer<Value>::write(_writer, get<Value>(i));
+				}
+			}
+		}
+
+		// Replace the content with a snapshot of a map with the same types.
+		// The order of the elements is preserved and all of them are marked as dirty.
+		// On failure the map is empty afterwards.
+		template<typename Value>
+			requires (std::is_trivially_copyable_v<Value> || std::default_initializable<Value>)
+		bool restore(BinaryReader& _reader)
+		{
+			ASSERT(sizeof(Value) == m_elementSize, "Restore with a different value type.");
+			clear();
+			if (!restoreElements<Value>(_reader))
+			{
+				spdlog::error("[utils] Invalid or incompatible WeakSlotMap snapshot.");
+				clear();
+				return false;
+			}
+			if constexpr (TrackChanges) m_dirty.resize(size(), true);
+			return true;
+		}
+
+		// change tracking
+		void markDirty(Key _key) requires TrackChanges
+		{
+			ASSERT(contains(_key), "Trying to mark a non existing element.");
+			m_dirty.set(m_slots.get(_key));
+		}
+		bool isDirty(Key _key) const requires TrackChanges { return m_dirty.test(m_slots.get(_key)); }
+		SizeType numDirty() const requires TrackChanges { return static_cast<SizeType>(m_dirty.count()); }
+		void clearDirty() requires TrackChanges { m_dirty.fill(false); }
+
+		// Call _func(Key, Value&) for all elements which are marked as dirty.
+		// The cost is proportional to size() / 64 plus the number of dirty elements.
+		template<typename Value, typename Func>
+		void forEachDirty(Func&& _func) requires TrackChanges
+		{
+			m_dirty.forEachSet([&](size_t _ind)
+				{
+					const SizeType ind = static_cast<SizeType>(_ind);
+					_func(m_valuesToSlots[ind], get<Value>(ind));
+				});
+		}
 	private:
 		// access through internal index
 		template<typename Value>
-		Value& get(SizeType _ind) { return reinterpret_cast<Value&>(m_values[index(_ind)]); }
+		Value& get(SizeType _ind) { return *reinterpret_cast<Value*>(m_values.at(_ind)); }
 		template<typename Value>
-		const Value& get(SizeType _ind) const { return reinterpret_cast<const Value&>(m_values[index(_ind)]); }
-		size_t index(SizeType _ind) const { return static_cast<size_t>(_ind) * m_elementSize; }
+		const Value& get(SizeType _ind) const { return *reinterpret_cast<const Value*>(m_values.at(_ind)); }
+
+		template<typename Value>
+		bool restoreElements(BinaryReader& _reader)
+		{
+			constexpr bool bulk = std::is_trivially_copyable_v<Value>;
+			const int64_t num = details::readSnapshotHeader(_reader, details::SnapshotKind::WeakSlotMap,
+				sizeof(Key), sizeof(Value), bulk);
+			if (num < 0 || static_cast<uint64_t>(num) >= static_cast<uint64_t>(INVALID_SLOT)
+				|| static_cast<uint64_t>(num) > _reader.remaining() / sizeof(Key))
+				return false;
+			const SizeType size = static_cast<SizeType>(num);
+
+			if constexpr (bulk)
+			{
+				if (!m_slots.restore(_reader)
+					|| static_cast<uint64_t>(size) > _reader.remaining() / (sizeof(Key) + sizeof(Value)))
+					return false;
+				reserve(size);
+				m_valuesToSlots.resize(size);
+				bool success = _reader.read(m_valuesToSlots.data(), size * sizeof(Key));
+				m_values.forEachRange(0, size, [&](char* _begin, size_t _count)
+					{
+						success = success && _reader.read(_begin, _count * sizeof(Value));
+					});
+				return success && details::isConsistent(m_slots, std::span<const Key>(m_valuesToSlots));
+			}
+			else
+			{
+				reserve(size);
+				for (SizeType i = 0; i < size; ++i)
+				{
+					Key key;
+					Value value;
+					if (!_reader.read(key) || !Serializer<Value>::read(_reader, value) || contains(key))
+						return false;
+					emplace<Value>(key, std::move(value));
+				}
+				return true;
+			}
+		}
+
+		// swap-remove of the element at _ind, the slot has to be reset already
+		void removeIndex(Key _ind)
+		{
+			// effectively get() but without knowing the type
+			char* back = m_values.at(size() - 1);
+
+			if (_ind+1 < size())
+			{
+				if (m_trivialRelocate) std::memcpy(m_values.at(_ind), back, m_elementSize);
+				else m_move(m_values.at(_ind), back);
+				m_slots.set(m_valuesToSlots.back(), _ind);
+				m_valuesToSlots[_ind] = m_valuesToSlots.back();
+				if constexpr (TrackChanges) m_dirty.set(_ind, m_dirty.test(size() - 1));
+			}
+
+			// trivially copyable values need no destructor call
+			if constexpr (!TrivialDestruct)
+				if (!m_trivialRelocate) m_destructor(back);
+			m_valuesToSlots.pop_back();
+			if constexpr (TrackChanges) m_dirty.popBack();
+		}
+
+		// Memory for one element as required by swapIndices().
+		// Empty if the elements can be swapped bytewise.
+		details::AlignedBuffer allocateScratch() const
+		{
+			if (m_trivialRelocate) return details::AlignedBuffer(nullptr, details::AlignedDelete{});
+			return details::allocateAligned(m_elementSize, m_alignment);
+		}
+
+		// Exchange the elements at _a and _b together with their keys and dirty flags.
+		// _scratch is the uninitialized memory from allocateScratch().
+		void swapIndices(Key _a, Key _b, char* _scratch)
+		{
+			if (_a == _b) return;
+			char* a = m_values.at(_a);
+			char* b = m_values.at(_b);
+			if (m_trivialRelocate) std::swap_ranges(a, a + m_elementSize, b);
+			else
+			{
+				m_moveConstruct(_scratch, a);
+				m_move(a, b);
+				m_move(b, _scratch);
+				m_destructor(_scratch);
+			}
+			std::swap(m_valuesToSlots[_a], m_valuesToSlots[_b]);
+			m_slots.set(m_valuesToSlots[_a], _a);
+			m_slots.set(m_valuesToSlots[_b], _b);
+			if constexpr (TrackChanges)
+			{
+				const bool dirtyA = m_dirty.test(_a);
+				m_dirty.set(_a, m_dirty.test(_b));
+				m_dirty.set(_b, dirtyA);
+			}
+		}
+
+		// Move the value at _permutation[i] to i with the type erased operations.
+		void applyPermutation(std::vector<Key> _permutation)
+		{
+			details::AlignedBuffer temp = details::allocateAligned(m_elementSize, m_alignment);
+			Key tempKey = INVALID_SLOT;
+			// keys and dirty flags travel with the values
+			[[maybe_unused]] bool tempDirty = false;
+			auto saveKey = [&](Key _ind)
+			{
+				tempKey = m_valuesToSlots[_ind];
+				if constexpr (TrackChanges) tempDirty = m_dirty.test(_ind);
+			};
+			auto moveKey = [&](Key _dst, Key _src)
+			{
+				m_valuesToSlots[_dst] = m_valuesToSlots[_src];
+				if constexpr (TrackChanges) m_dirty.set(_dst, m_dirty.test(_src));
+			};
+			auto restoreKey = [&](Key _ind)
+			{
+				m_valuesToSlots[_ind] = tempKey;
+				if constexpr (TrackChanges) m_dirty.set(_ind, tempDirty);
+			};
+			if (m_trivialRelocate)
+			{
+				details::applyPermutation(_permutation,
+					[&](Key _ind) { std::memcpy(temp.get(), m_values.at(_ind), m_elementSize); saveKey(_ind); },
+					[&](Key _dst, Key _src) { std::memcpy(m_values.at(_dst), m_values.at(_src), m_elementSize); moveKey(_dst, _src); },
+					[&](Key _ind) { std::memcpy(m_values.at(_ind), temp.get(), m_elementSize); restoreKey(_ind); });
+			}
+			else details::applyPermutation(_permutation,
+				[&](Key _ind) { m_moveConstruct(temp.get(), m_values.at(_ind)); saveKey(_ind); },
+				[&](Key _dst, Key _src) { m_move(m_values.at(_dst), m_values.at(_src)); moveKey(_dst, _src); },
+				[&](Key _ind)
+				{
+					m_move(m_values.at(_ind), temp.get());
+					m_destructor(temp.get());
+					restoreKey(_ind);
+				});
+
+			for (Key i = 0; i < size(); ++i)
+				m_slots.set(m_valuesToSlots[i], i);
+		}
 
 		void destroyValues()
 		{
 			if constexpr (TrivialDestruct) return;
+			if (m_trivialRelocate) return;
 
 			for (SizeType i = 0; i < size(); ++i)
-				m_destructor(&m_values[index(i)]);
+				m_destructor(m_values.at(i));
 		}
 
 		template<typename Value>
@@ -178,12 +508,25 @@ namespace utils {
 		}
 		using Move = void(*)(void*, void*);
 
+		template<typename Value>
+		static void moveConstructElement(void* dst, void* src)
+		{
+			new (dst) Value(std::move(*static_cast<Value*>(src)));
+		}
+
+		template<typename... Maps>
+		friend class SlotMapGroup;
+
 		int m_elementSize;
+		int m_alignment;
+		bool m_trivialRelocate;
 		Destructor m_destructor;
 		Move m_move;
+		Move m_moveConstruct;
 
-		std::unique_ptr<char[]> m_values;
-		std::vector<Key> m_slots;
+		Storage m_values;
+		SlotIndex m_slots;
 		std::vector<Key> m_valuesToSlots;
+		[[no_unique_address]] std::conditional_t<TrackChanges, DynamicBitset, details::NoChangeTracking> m_dirty;
 	};
 }
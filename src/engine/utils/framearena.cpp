@@ -0,0 +1,77 @@
+#include "framearena.hpp"
+#include <algorithm>
+#include <cstdint>
+
+namespace utils {
+
+	constexpr size_t BUFFER_ALIGNMENT = alignof(std::max_align_t);
+
+	FrameArena::FrameArena(size_t _initialSize, std::pmr::memory_resource* _upstream)
+		: m_upstream(_upstream)
+	{
+		for (Buffer& buffer : m_buffers)
+		{
+			buffer.size = std::max<size_t>(_initialSize, BUFFER_ALIGNMENT);
+			buffer.data = static_cast<char*>(m_upstream->allocate(buffer.size, BUFFER_ALIGNMENT));
+		}
+	}
+
+	FrameArena::~FrameArena()
+	{
+		for (Buffer& buffer : m_buffers)
+		{
+			releaseOverflow(buffer);
+			m_upstream->deallocate(buffer.data, buffer.size, BUFFER_ALIGNMENT);
+		}
+	}
+
+	void FrameArena::nextFrame()
+	{
+		m_current = (m_current + 1) % NUM_BUFFERS;
+		Buffer& buffer = m_buffers[m_current];
+		if (!buffer.overflow.empty())
+		{
+			// grow to the peak of the last frame which used this buffer
+			const size_t required = buffer.used + buffer.overflowBytes;
+			releaseOverflow(buffer);
+			m_upstream->deallocate(buffer.data, buffer.size, BUFFER_ALIGNMENT);
+			buffer.size = std::max(required, 2 * buffer.size);
+			buffer.data = static_cast<char*>(m_upstream->allocate(buffer.size, BUFFER_ALIGNMENT));
+			++m_numUpstreamAllocations;
+		}
+		buffer.used = 0;
+	}
+
+	size_t FrameArena::frameUsage() const
+	{
+		const Buffer& buffer = m_buffers[m_current];
+		return buffer.used + buffer.overflowBytes;
+	}
+
+	void* FrameArena::do_allocate(size_t _bytes, size_t _alignment)
+	{
+		Buffer& buffer = m_buffers[m_current];
+		const uintptr_t address = reinterpret_cast<uintptr_t>(buffer.data) + buffer.used;
+		const size_t begin = buffer.used + (((address + _alignment - 1) & ~(_alignment - 1)) - address);
+		if (begin + _bytes <= buffer.size)
+		{
+			buffer.used = begin + _bytes;
+			return buffer.data + begin;
+		}
+
+		// does not fit, the buffer grows when it is reset the next time
+		void* ptr = m_upstream->allocate(_bytes, _alignment);
+		buffer.overflow.push_back({ ptr, _bytes, _alignment });
+		buffer.overflowBytes += _bytes + _alignment;
+		++m_numUpstreamAllocations;
+		return ptr;
+	}
+
+	void FrameArena::releaseOverflow(Buffer& _buffer)
+	{
+		for (const Overflow& overflow : _buffer.overflow)
+			m_upstream->deallocate(overflow.ptr, overflow.size, overflow.alignment);
+		_buffer.overflow.clear();
+		_buffer.overflowBytes = 0;
+	}
+}
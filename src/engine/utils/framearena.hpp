@@ -0,0 +1,68 @@
+#pragma once
+
+#include <memory_resource>
+#include <vector>
+#include <array>
+#include <cstddef>
+
+namespace utils {
+
+	/// Linear allocator for data which is rebuilt every frame, as std::pmr::memory_resource.
+	/// \details Allocations bump a pointer in the buffer of the current frame and
+	///		deallocations do nothing. nextFrame() switches to the other of two buffers and
+	///		resets it, so memory from the previous frame stays valid for one more frame.
+	///		Allocations which do not fit are served by the upstream resource; the buffer
+	///		grows to the peak usage when it is reset the next time. Once the buffers are
+	///		large enough, frames do not allocate from the upstream resource at all.
+	///		Not thread-safe.
+	class FrameArena : public std::pmr::memory_resource
+	{
+	public:
+		constexpr static size_t NUM_BUFFERS = 2;
+
+		explicit FrameArena(size_t _initialSize = 1 << 16,
+			std::pmr::memory_resource* _upstream = std::pmr::get_default_resource());
+		~FrameArena() override;
+
+		FrameArena(const FrameArena&) = delete;
+		FrameArena& operator=(const FrameArena&) = delete;
+
+		/// Begin a new frame. Memory allocated two frames ago becomes invalid.
+		void nextFrame();
+
+		/// Bytes allocated in the current frame, including upstream allocations.
+		size_t frameUsage() const;
+		/// Size of the buffer of the current frame.
+		size_t capacity() const { return m_buffers[m_current].size; }
+		/// Number of allocations from the upstream resource since construction.
+		size_t numUpstreamAllocations() const { return m_numUpstreamAllocations; }
+
+	private:
+		void* do_allocate(size_t _bytes, size_t _alignment) override;
+		void do_deallocate(void*, size_t, size_t) override {}
+		bool do_is_equal(const std::pmr::memory_resource& _other) const noexcept override { return this == &_other; }
+
+		struct Overflow
+		{
+			void* ptr;
+			size_t size;
+			size_t alignment;
+		};
+
+		struct Buffer
+		{
+			char* data = nullptr;
+			size_t size = 0;
+			size_t used = 0;
+			size_t overflowBytes = 0;
+			std::vector<Overflow> overflow;
+		};
+
+		void releaseOverflow(Buffer& _buffer);
+
+		std::pmr::memory_resource* m_upstream;
+		std::array<Buffer, NUM_BUFFERS> m_buffers;
+		size_t m_current = 0;
+		size_t m_numUpstreamAllocations = 0;
+	};
+}
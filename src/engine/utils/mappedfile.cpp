@@ -0,0 +1,114 @@
+#include "mappedfile.hpp"
+#include <spdlog/spdlog.h>
+#include <utility>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace utils {
+
+#ifdef _WIN32
+	MappedFile::MappedFile(const char* _fileName)
+	{
+		m_file = CreateFileA(_fileName, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+			FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (m_file == INVALID_HANDLE_VALUE)
+		{
+			m_file = nullptr;
+			spdlog::error("[utils] Could not open file '{}' for mapping.", _fileName);
+			return;
+		}
+
+		LARGE_INTEGER fileSize;
+		if (!GetFileSizeEx(m_file, &fileSize) || fileSize.QuadPart == 0)
+		{
+			spdlog::error("[utils] Cannot map empty file '{}'.", _fileName);
+			close();
+			return;
+		}
+
+		m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (m_mapping)
+			m_data = static_cast<const char*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+		if (!m_data)
+		{
+			spdlog::error("[utils] Could not map file '{}'.", _fileName);
+			close();
+			return;
+		}
+		m_size = static_cast<size_t>(fileSize.QuadPart);
+	}
+
+	void MappedFile::close()
+	{
+		if (m_data) UnmapViewOfFile(m_data);
+		if (m_mapping) CloseHandle(m_mapping);
+		if (m_file) CloseHandle(m_file);
+		m_data = nullptr;
+		m_mapping = nullptr;
+		m_file = nullptr;
+		m_size = 0;
+	}
+#else
+	MappedFile::MappedFile(const char* _fileName)
+	{
+		const int file = open(_fileName, O_RDONLY);
+		if (file == -1)
+		{
+			spdlog::error("[utils] Could not open file '{}' for mapping.", _fileName);
+			return;
+		}
+
+		struct stat fileStat;
+		if (fstat(file, &fileStat) == 0 && fileStat.st_size > 0)
+		{
+			void* ptr = mmap(nullptr, static_cast<size_t>(fileStat.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+			if (ptr != MAP_FAILED)
+			{
+				m_data = static_cast<const char*>(ptr);
+				m_size = static_cast<size_t>(fileStat.st_size);
+			}
+			else spdlog::error("[utils] Could not map file '{}'.", _fileName);
+		}
+		else spdlog::error("[utils] Cannot map empty file '{}'.", _fileName);
+
+		// The mapping stays valid after closing the descriptor.
+		::close(file);
+	}
+
+	void MappedFile::close()
+	{
+		if (m_data) munmap(const_cast<char*>(m_data), m_size);
+		m_data = nullptr;
+		m_size = 0;
+	}
+#endif
+
+	MappedFile::~MappedFile()
+	{
+		close();
+	}
+
+	MappedFile::MappedFile(MappedFile&& _other) noexcept
+	{
+		*this = std::move(_other);
+	}
+
+	MappedFile& MappedFile::operator=(MappedFile&& _other) noexcept
+	{
+		close();
+		std::swap(m_data, _other.m_data);
+		std::swap(m_size, _other.m_size);
+#ifdef _WIN32
+		std::swap(m_file, _other.m_file);
+		std::swap(m_mapping, _other.m_mapping);
+#endif
+		return *this;
+	}
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+
+namespace utils {
+
+	/// Read-only memory mapping of a whole file.
+	/// \details The content is paged in lazily by the operating system, so opening is
+	///		cheap even for large files and repeated runs are served from the page cache.
+	class MappedFile
+	{
+	public:
+		/// Creates an empty mapping.
+		MappedFile() = default;
+		/// Map the file _fileName. Check isOpen() to find out whether this succeeded.
+		explicit MappedFile(const char* _fileName);
+		~MappedFile();
+
+		MappedFile(MappedFile&& _other) noexcept;
+		MappedFile& operator=(MappedFile&& _other) noexcept;
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		bool isOpen() const { return m_data != nullptr; }
+		const char* data() const { return m_data; }
+		size_t size() const { return m_size; }
+
+	private:
+		void close();
+
+		const char* m_data = nullptr;
+		size_t m_size = 0;
+#ifdef _WIN32
+		void* m_file = nullptr;
+		void* m_mapping = nullptr;
+#endif
+	};
+}
@@ -7,6 +7,8 @@
 #include <exception>
 #include <tuple>
 #include <cctype>
+#include <cstdlib>
+#include <stdexcept>
 
 #include <iostream>
 
@@ -26,13 +28,34 @@ void errorTypeNotSupported(std::string_view _fileName)
 }
 
 
+// std::stof and std::stoi on the rest of the line without creating a substring.
+float parseFloat(const std::string& line, std::string::size_type pos, std::string::size_type* diff)
+{
+	const char* begin = line.c_str() + pos;
+	char* end;
+	const float val = std::strtof(begin, &end);
+	if (end == begin) throw std::invalid_argument("parseFloat");
+	*diff = end - begin;
+	return val;
+}
+
+int parseInt(const std::string& line, std::string::size_type pos, std::string::size_type* diff)
+{
+	const char* begin = line.c_str() + pos;
+	char* end;
+	const long val = std::strtol(begin, &end, 10);
+	if (end == begin) throw std::invalid_argument("parseInt");
+	*diff = end - begin;
+	return static_cast<int>(val);
+}
+
 glm::vec3 parseVec3(const std::string& line, std::string::size_type begin)
 {
 	std::string::size_type pos = begin, diff;
 	glm::vec3 res;
 	for(int i = 0; i < 3; ++i)
 	{
-		float val = std::stof(line.substr(pos), &diff);
+		float val = parseFloat(line, pos, &diff);
 		if ( std::fabs(val) == 0 ) val = 0;
 		res[i] = val;
 		pos += diff;
@@ -46,7 +69,7 @@ glm::vec2 parseVec2(const std::string& line, std::string::size_type begin)
 	glm::vec2 res;
 	for(int i = 0; i < 2; ++i)
 	{
-		float val = std::stof(line.substr(pos), &diff);
+		float val = parseFloat(line, pos, &diff);
 		if ( std::fabs(val) == 0 ) val = 0;
 		res[i] = val;
 		pos += diff;
@@ -158,7 +181,7 @@ struct Face
 		utils::MeshData::FaceData f;
 		std::string::size_type pos = begin, diff;
 		for( auto& v : f.indices ) {
-			v.positionIdx = std::stoi(line.substr(pos), &diff);
+			v.positionIdx = parseInt(line, pos, &diff);
 			pos += diff;
 			if (line[pos] == '/')
 			{
@@ -166,18 +189,18 @@ struct Face
 				if (line[pos] == '/') // with normal, without texture
 				{
 					++pos;
-					v.normalIdx = std::stoi(line.substr(pos), &diff);
+					v.normalIdx = parseInt(line, pos, &diff);
 					v.textureCoordinateIdx = std::nullopt;
 					pos += diff;
 				}
 				else // with texture
 				{
-					v.textureCoordinateIdx = std::stoi(line.substr(pos), &diff);
+					v.textureCoordinateIdx = parseInt(line, pos, &diff);
 					pos += diff;
 					if (line[pos] == '/') // with normal
 					{
 						++pos;
-						v.normalIdx = std::stof(line.substr(pos), &diff);
+						v.normalIdx = parseInt(line, pos, &diff);
 						pos += diff;
 					}
 					else // without normal
@@ -288,7 +311,7 @@ void parseLine( const std::string& line, utils::MeshData& data)
 	{
 		parseLine(
 				{line.c_str() + begin, end - begin},
-				line.substr(begin), end, data);
+				line, end, data);
 	}
 }
 
@@ -1,8 +1,10 @@
 #pragma once
 
-#include "containers/hashmap.hpp"
+#include "containers/densehashmap.hpp"
+#include "containers/concurrenthashmap.hpp"
 #include <spdlog/spdlog.h>
 #include <string>
+#include <string_view>
 #include <cinttypes>
 #include <functional>
 #include <utility>
@@ -20,6 +22,8 @@ namespace utils {
 	///		TLoader::Handle.
 	/// \tparam Register A functor that is called with a wrapped clear() method of 
 	///		this manager on construction.
+	/// \tparam ThreadSafe Use a ConcurrentHashMap to allow get() from multiple threads.
+	///		Each resource is still loaded only once. clear() must not run concurrently to get().
 	
 	template<typename T>
 	concept resource_register = requires { T::registerResources(std::function<void()>{}); };
@@ -28,7 +32,7 @@ namespace utils {
 		struct ResourceRegisterDummy { static void registerResources(std::function<void()>) {}; };
 	}
 
-	template<typename TLoader, resource_register Register = details::ResourceRegisterDummy>
+	template<typename TLoader, resource_register Register = details::ResourceRegisterDummy, bool ThreadSafe = false>
 	class ResourceManager
 	{
 	public:
@@ -49,13 +53,19 @@ namespace utils {
 		/// Singleton access
 		static ResourceManager& inst();
 		
-		/// Compute a hash for a string
+		/// Compute a hash for a string.
+		/// Transparent to allow lookups with a std::string_view without allocations.
 		struct FastStringHash
 		{
-			uint32_t operator () (const std::string& _string);
+			using is_transparent = void;
+			uint32_t operator () (std::string_view _string) const;
 		};
 
-		utils::HashMap<std::string, typename TLoader::Handle, FastStringHash> m_resourceMap;
+		// Resources are stored by the name given to get(), i.e. without RESOURCE_PATH.
+		using MapType = std::conditional_t<ThreadSafe,
+			utils::ConcurrentHashMap<std::string, typename TLoader::Handle, FastStringHash, std::equal_to<>, PowerOfTwoLayout>,
+			utils::DenseHashMap<std::string, typename TLoader::Handle, FastStringHash, std::equal_to<>>>;
+		MapType m_resourceMap;
 	};
 
 #define RESOURCE_PATH "../resources/"s
@@ -63,61 +73,79 @@ namespace utils {
 	// ********************************************************************************************* //
 	// IMPLEMENTATION																				 //
 	// ********************************************************************************************* //
-	template<typename TLoader, resource_register Register>
-	ResourceManager<TLoader, Register>::ResourceManager()
+	template<typename TLoader, resource_register Register, bool ThreadSafe>
+	ResourceManager<TLoader, Register, ThreadSafe>::ResourceManager()
 	{
-		Register::registerResources([]() {ResourceManager<TLoader, Register>::clear(); });
+		Register::registerResources([]() {ResourceManager<TLoader, Register, ThreadSafe>::clear(); });
 	}
 
-	template<typename TLoader, resource_register Register>
-	ResourceManager<TLoader, Register>::~ResourceManager()
+	template<typename TLoader, resource_register Register, bool ThreadSafe>
+	ResourceManager<TLoader, Register, ThreadSafe>::~ResourceManager()
 	{
 		clear();
 	}
 
-	template<typename TLoader, resource_register Register>
-	ResourceManager<TLoader, Register>& ResourceManager<TLoader, Register>::inst()
+	template<typename TLoader, resource_register Register, bool ThreadSafe>
+	ResourceManager<TLoader, Register, ThreadSafe>& ResourceManager<TLoader, Register, ThreadSafe>::inst()
 	{
 		static ResourceManager theOnlyInstance;
 		return theOnlyInstance;
 	}
 
-	template<typename TLoader, resource_register Register>
+	template<typename TLoader, resource_register Register, bool ThreadSafe>
 	template<typename... Args>
-	typename TLoader::Handle ResourceManager<TLoader, Register>::get(const char* _name, Args&&... _args)
+	typename TLoader::Handle ResourceManager<TLoader, Register, ThreadSafe>::get(const char* _name, Args&&... _args)
 	{
 		using namespace std::string_literals;
-		std::string name(RESOURCE_PATH + _name);
-		// Search in hash map
-		auto handle = inst().m_resourceMap.find(name);
-		if(handle) {
-		//	pa::logPedantic("Reusing resource '", _name, "'.");
-			return handle.data();
+		const std::string_view name(_name);
+		const uint32_t hash = FastStringHash()(name);
+		if constexpr (ThreadSafe)
+		{
+			return inst().m_resourceMap.findOrAdd(name, hash, [&]()
+				{
+					const std::string path(RESOURCE_PATH + _name);
+					return TLoader::load(path.c_str(), std::forward<Args>(_args)...);
+				});
 		}
+		else
+		{
+			// Search in hash map
+			auto handle = inst().m_resourceMap.find(name, hash);
+			if(handle) {
+			//	pa::logPedantic("Reusing resource '", _name, "'.");
+				return handle.data();
+			}
 
-		// Add/Load new element
-		handle = inst().m_resourceMap.add(move(name), 
-			TLoader::load(name.c_str(), 
-				std::forward<Args>(_args)...));
-		return handle.data();
+			// Add/Load new element
+			const std::string path(RESOURCE_PATH + _name);
+			handle = inst().m_resourceMap.add(std::string(name),
+				TLoader::load(path.c_str(),
+					std::forward<Args>(_args)...), hash);
+			return handle.data();
+		}
 	}
 
-	template<typename TLoader, resource_register Register>
-	void ResourceManager<TLoader, Register>::clear()
+	template<typename TLoader, resource_register Register, bool ThreadSafe>
+	void ResourceManager<TLoader, Register, ThreadSafe>::clear()
 	{
-		for(auto it : inst().m_resourceMap)
-			TLoader::unload(it.data());
+		if constexpr (ThreadSafe)
+			inst().m_resourceMap.forEach([](const std::string&, const typename TLoader::Handle& _handle)
+				{
+					TLoader::unload(_handle);
+				});
+		else
+			for(auto it : inst().m_resourceMap)
+				TLoader::unload(it.data());
 		inst().m_resourceMap.clear();
 	}
 
-	template<typename TLoader, resource_register Register>
-	uint32_t ResourceManager<TLoader, Register>::FastStringHash::operator () (const std::string& _string)
+	template<typename TLoader, resource_register Register, bool ThreadSafe>
+	uint32_t ResourceManager<TLoader, Register, ThreadSafe>::FastStringHash::operator () (std::string_view _string) const
 	{
 		uint32_t hashvalue = 208357;
 
-		const char* string = _string.c_str();
-		while(int c = *string++)
-			hashvalue = ((hashvalue << 5) + (hashvalue << 1) + hashvalue) ^ c; 
+		for(const char c : _string)
+			hashvalue = ((hashvalue << 5) + (hashvalue << 1) + hashvalue) ^ c;
 
 		return hashvalue;
 	}
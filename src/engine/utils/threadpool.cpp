@@ -0,0 +1,92 @@
+#include "threadpool.hpp"
+#include <algorithm>
+
+namespace utils {
+
+	// Set while a thread executes tasks of any pool to detect nested calls.
+	static thread_local bool t_insideBatch = false;
+
+	ThreadPool::ThreadPool(unsigned _numWorkers)
+	{
+		m_workers.reserve(_numWorkers);
+		for (unsigned i = 0; i < _numWorkers; ++i)
+			m_workers.emplace_back(&ThreadPool::workerMain, this);
+	}
+
+	ThreadPool::~ThreadPool()
+	{
+		{
+			std::lock_guard lock(m_mutex);
+			m_stop = true;
+		}
+		m_wakeUp.notify_all();
+		for (std::thread& worker : m_workers)
+			worker.join();
+	}
+
+	ThreadPool& ThreadPool::global()
+	{
+		static ThreadPool pool(std::max(1u, std::thread::hardware_concurrency()) - 1);
+		return pool;
+	}
+
+	void ThreadPool::runBatch(size_t _numTasks, TaskFunction _function, void* _context)
+	{
+		if (m_workers.empty() || _numTasks <= 1 || t_insideBatch)
+		{
+			for (size_t i = 0; i < _numTasks; ++i)
+				_function(_context, i);
+			return;
+		}
+
+		std::lock_guard runLock(m_runMutex);
+		{
+			std::lock_guard lock(m_mutex);
+			m_function = _function;
+			m_context = _context;
+			m_numTasks = _numTasks;
+			m_nextTask = 0;
+			m_workersDone = 0;
+			++m_batch;
+		}
+		m_wakeUp.notify_all();
+
+		t_insideBatch = true;
+		work();
+		t_insideBatch = false;
+
+		// Every worker has to acknowledge the batch before its data can be reused.
+		std::unique_lock lock(m_mutex);
+		m_finished.wait(lock, [&]() { return m_workersDone == m_workers.size(); });
+	}
+
+	void ThreadPool::workerMain()
+	{
+		t_insideBatch = true;
+		uint64_t lastBatch = 0;
+		while (true)
+		{
+			{
+				std::unique_lock lock(m_mutex);
+				m_wakeUp.wait(lock, [&]() { return m_stop || m_batch != lastBatch; });
+				if (m_stop) return;
+				lastBatch = m_batch;
+			}
+
+			work();
+
+			bool allDone;
+			{
+				std::lock_guard lock(m_mutex);
+				allDone = ++m_workersDone == m_workers.size();
+			}
+			if (allDone) m_finished.notify_one();
+		}
+	}
+
+	void ThreadPool::work()
+	{
+		for (size_t i = m_nextTask.fetch_add(1); i < m_numTasks; i = m_nextTask.fetch_add(1))
+			m_function(m_context, i);
+	}
+}
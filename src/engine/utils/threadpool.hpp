@@ -0,0 +1,65 @@
+#pragma once
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+namespace utils {
+
+	/// Fixed set of worker threads which execute batches of independent tasks.
+	/// \details run() blocks until the whole batch is done and the calling thread
+	///		works on the batch as well. Calls from inside a task and concurrent calls
+	///		from other threads are safe; nested calls are executed serially.
+	class ThreadPool
+	{
+	public:
+		/// Create a pool with _numWorkers additional threads.
+		explicit ThreadPool(unsigned _numWorkers);
+		~ThreadPool();
+
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+
+		/// Shared pool with one worker per hardware thread besides the caller.
+		static ThreadPool& global();
+
+		/// Number of threads which work on a batch, including the caller.
+		unsigned numThreads() const { return static_cast<unsigned>(m_workers.size()) + 1; }
+
+		/// Call _task(i) for all i in [0, _numTasks) distributed over all threads.
+		template<typename Task>
+		void run(size_t _numTasks, Task&& _task)
+		{
+			using TaskT = std::remove_reference_t<Task>;
+			runBatch(_numTasks, [](void* _context, size_t _index) { (*static_cast<TaskT*>(_context))(_index); },
+				const_cast<void*>(static_cast<const void*>(&_task)));
+		}
+
+	private:
+		using TaskFunction = void(*)(void*, size_t);
+
+		void runBatch(size_t _numTasks, TaskFunction _function, void* _context);
+		void workerMain();
+		void work();
+
+		std::vector<std::thread> m_workers;
+		std::mutex m_runMutex; // one batch at a time
+		std::mutex m_mutex;
+		std::condition_variable m_wakeUp;
+		std::condition_variable m_finished;
+
+		// current batch, written under m_mutex before the workers are woken
+		TaskFunction m_function = nullptr;
+		void* m_context = nullptr;
+		size_t m_numTasks = 0;
+		std::atomic<size_t> m_nextTask = 0;
+		uint64_t m_batch = 0;
+		unsigned m_workersDone = 0;
+		bool m_stop = false;
+	};
+}
@@ -0,0 +1,5 @@
+#include "typeindex.hpp"
+
+namespace utils {
+	int TypeIndex::s_counter = 0;
+}
@@ -0,0 +1,132 @@
+#include "testutils.hpp"
+
+#include <engine/utils/alloctracker.hpp>
+#include <engine/utils/blockalloc.hpp>
+#include <engine/utils/containers/hashmap.hpp>
+#include <engine/utils/containers/weakslotmap.hpp>
+#include <engine/utils/containers/slotmapgroup.hpp>
+#include <nlohmann/json.hpp>
+#include <vector>
+#include <thread>
+
+using utils::AllocTracker;
+using utils::AllocTag;
+
+int main()
+{
+	{
+		utils::HashMap<int, int> map;
+		for (int i = 0; i < 100; ++i)
+			map.add(i, i);
+		EXPECT(AllocTracker::stats(AllocTag::HASH_MAP).numAllocations == 0, "Nothing is tracked while disabled.");
+	}
+
+	AllocTracker::setEnabled(true);
+
+	{
+		{
+			utils::HashMap<int, int> map;
+			for (int i = 0; i < 1000; ++i)
+				map.add(i, i);
+			const AllocTracker::Stats stats = AllocTracker::stats(AllocTag::HASH_MAP);
+			EXPECT(stats.liveBytes > static_cast<int64_t>(1000 * 2 * sizeof(int)) && stats.peakBytes > static_cast<size_t>(stats.liveBytes),
+				"Rehashing HashMap reports live and peak bytes.");
+		}
+		const AllocTracker::Stats stats = AllocTracker::stats(AllocTag::HASH_MAP);
+		EXPECT(stats.liveBytes == 0 && stats.numAllocations > 1 && stats.numAllocations == stats.numDeallocations,
+			"HashMap releases all memory.");
+	}
+
+	{
+		utils::BlockAllocator<int, 16> allocator;
+		for (int i = 0; i < 100; ++i)
+			allocator.create(i);
+		const AllocTracker::Stats stats = AllocTracker::stats(AllocTag::BLOCK_ALLOCATOR);
+		EXPECT(stats.liveBytes == static_cast<int64_t>(allocator.memoryUsage()) && stats.numAllocations == 7, "BlockAllocator reports its blocks.");
+		allocator.reset();
+		EXPECT(AllocTracker::stats(AllocTag::BLOCK_ALLOCATOR).liveBytes == 0, "BlockAllocator releases its blocks.");
+	}
+
+	{
+		{
+			utils::WeakSlotMap<int> slotMap(utils::TypeHolder<double>{});
+			for (int i = 0; i < 100; ++i)
+				slotMap.emplace<double>(i, 1.0);
+			EXPECT(AllocTracker::stats(AllocTag::SLOT_MAP).liveBytes >= static_cast<int64_t>(100 * sizeof(double)), "WeakSlotMap reports its storage.");
+		}
+		EXPECT(AllocTracker::stats(AllocTag::SLOT_MAP).liveBytes == 0, "WeakSlotMap releases its storage.");
+	}
+
+	{
+		utils::SlotMap<uint32_t, int> ints;
+		utils::WeakSlotMap<uint32_t> strings(utils::TypeHolder<std::string>{});
+		for (uint32_t i = 0; i < 100; ++i)
+		{
+			ints.emplace(i, static_cast<int>(i));
+			strings.emplace<std::string>(i, std::to_string(i));
+		}
+		const size_t numAllocations = AllocTracker::stats(AllocTag::SLOT_MAP).numAllocations;
+		utils::SlotMapGroup group(ints, strings);
+		for (uint32_t i = 0; i < 100; i += 2)
+			group.erase<0>(i);
+		EXPECT(group.size() == 50 && AllocTracker::stats(AllocTag::SLOT_MAP).numAllocations == numAllocations + 1,
+			"SlotMapGroup swaps type erased values without allocations.");
+	}
+
+	{
+		AllocTracker::reset();
+		{
+			std::pmr::vector<int> values(AllocTracker::resource(AllocTag::OTHER));
+			for (int i = 0; i < 3; ++i)
+				values.emplace_back(i);
+			values.shrink_to_fit();
+			AllocTracker::nextFrame();
+		}
+		AllocTracker::Stats stats = AllocTracker::stats(AllocTag::OTHER);
+		EXPECT(stats.frameAllocations == 4 && stats.frameBytes == (1 + 2 + 4 + 3) * sizeof(int), "Allocations of a frame are counted.");
+		AllocTracker::nextFrame();
+		stats = AllocTracker::stats(AllocTag::OTHER);
+		EXPECT(stats.frameAllocations == 0 && stats.maxFrameAllocations == 4 && stats.liveBytes == 0 && AllocTracker::frame() == 2,
+			"Frame statistics are reset.");
+	}
+
+	{
+		std::pmr::memory_resource* resource = AllocTracker::resource(AllocTag::OTHER);
+		AllocTracker::setEnabled(false);
+		void* untracked = resource->allocate(1 << 20);
+		AllocTracker::setEnabled(true);
+		const size_t peakBytes = AllocTracker::stats(AllocTag::OTHER).peakBytes;
+		resource->deallocate(untracked, 1 << 20);
+		resource->deallocate(resource->allocate(64), 64);
+		const AllocTracker::Stats stats = AllocTracker::stats(AllocTag::OTHER);
+		EXPECT(stats.liveBytes == -(1 << 20) && stats.peakBytes == peakBytes, "Freeing untracked memory does not wrap around.");
+	}
+
+	{
+		std::vector<std::thread> threads;
+		for (int t = 0; t < 4; ++t)
+			threads.emplace_back([]()
+				{
+					std::pmr::memory_resource* resource = AllocTracker::resource(AllocTag::RENDERER);
+					for (int i = 0; i < 1000; ++i)
+					{
+						void* ptr = resource->allocate(64);
+						resource->deallocate(ptr, 64);
+					}
+				});
+		for (auto& thread : threads)
+			thread.join();
+		const AllocTracker::Stats stats = AllocTracker::stats(AllocTag::RENDERER);
+		EXPECT(stats.numAllocations == 4000 && stats.numDeallocations == 4000 && stats.liveBytes == 0 && stats.peakBytes >= 64,
+			"Concurrent reports are consistent.");
+	}
+
+	{
+		const nlohmann::json json = nlohmann::json::parse(AllocTracker::toJson());
+		EXPECT(json["enabled"] == true && json["frame"] == 2, "JSON contains the global state.");
+		EXPECT(json["tags"]["Renderer"]["numAllocations"] == 4000 && json["tags"].size() == static_cast<size_t>(AllocTag::COUNT),
+			"JSON contains all tags.");
+	}
+
+	return testsFailed;
+}
@@ -0,0 +1,122 @@
+#include "testutils.hpp"
+
+#include <engine/utils/blockalloc.hpp>
+#include <vector>
+#include <thread>
+#include <string>
+#include <atomic>
+
+struct Counted
+{
+	Counted(int _value) : value(_value) { ++numAlive; }
+	~Counted() { --numAlive; }
+
+	int value;
+	std::string name = "counted";
+	static inline std::atomic<int> numAlive = 0;
+};
+
+int main()
+{
+	{
+		utils::BlockAllocator<Counted, 16> alloc;
+		std::vector<Counted*> objects;
+		for (int i = 0; i < 100; ++i)
+			objects.push_back(alloc.create(i));
+		const size_t memory = alloc.memoryUsage();
+		EXPECT(Counted::numAlive == 100 && objects[42]->value == 42, "Create objects.");
+
+		for (int i = 0; i < 100; i += 2)
+			alloc.destroy(objects[i]);
+		EXPECT(Counted::numAlive == 50, "Destroy calls the destructor.");
+		Counted* reused = alloc.create(-1);
+		EXPECT(reused == objects[98] && reused->value == -1, "Last freed slot is reused first.");
+		for (int i = 0; i < 1000; ++i)
+			alloc.destroy(alloc.create(i));
+		EXPECT(alloc.memoryUsage() == memory, "Churn does not allocate new blocks.");
+
+		alloc.reset();
+		EXPECT(Counted::numAlive == 0 && alloc.memoryUsage() == 0, "Reset destroys only live objects.");
+		EXPECT(alloc.create(7)->value == 7, "Create after reset.");
+	}
+	EXPECT(Counted::numAlive == 0, "Destructor of the allocator destroys live objects.");
+
+	{
+		utils::BlockAllocator<Counted, 64, true> alloc;
+		constexpr int NUM_THREADS = 4;
+		std::vector<std::thread> threads;
+		std::vector<std::vector<Counted*>> perThread(NUM_THREADS);
+		for (int t = 0; t < NUM_THREADS; ++t)
+			threads.emplace_back([&, t]()
+				{
+					for (int i = 0; i < 10000; ++i)
+					{
+						perThread[t].push_back(alloc.create(i));
+						if (i % 3 == 0)
+						{
+							alloc.destroy(perThread[t].back());
+							perThread[t].pop_back();
+						}
+					}
+				});
+		for (auto& thread : threads) thread.join();
+		threads.clear();
+		bool allValid = true;
+		for (auto& objects : perThread)
+			for (size_t i = 0; i < objects.size(); ++i)
+				allValid &= objects[i]->name == "counted";
+		EXPECT(allValid && Counted::numAlive == NUM_THREADS * 6666, "Create from multiple threads.");
+
+		// objects freed by other threads are reused
+		const size_t memory = alloc.memoryUsage();
+		std::thread consumer([&]()
+			{
+				for (auto& objects : perThread)
+					for (Counted* object : objects) alloc.destroy(object);
+			});
+		consumer.join();
+		std::thread producer([&]()
+			{
+				for (int i = 0; i < NUM_THREADS * 6666; ++i)
+					alloc.create(i);
+			});
+		producer.join();
+		EXPECT(alloc.memoryUsage() <= memory + 2 * 64 * sizeof(Counted) + 64, "Free slots are shared between threads.");
+		alloc.reset();
+		EXPECT(Counted::numAlive == 0, "Reset with thread local caches.");
+	}
+
+	{
+		// caches of exited threads are handed back instead of holding a block each
+		utils::BlockAllocator<Counted, 16, true> alloc;
+		auto work = [&]()
+		{
+			std::vector<Counted*> objects;
+			for (int i = 0; i < 10; ++i)
+				objects.push_back(alloc.create(i));
+			for (Counted* object : objects)
+				alloc.destroy(object);
+		};
+		std::thread(work).join();
+		const size_t memory = alloc.memoryUsage();
+		for (int i = 0; i < 100; ++i)
+			std::thread(work).join();
+		EXPECT(alloc.memoryUsage() == memory && Counted::numAlive == 0, "Transient threads reuse the slots of exited threads.");
+	}
+
+	{
+		// every allocator adds a cache for this thread which expires with the allocator
+		bool allValid = true;
+		for (int i = 0; i < 1000; ++i)
+		{
+			utils::BlockAllocator<Counted, 16, true> alloc;
+			utils::BlockAllocator<Counted, 16, true> other;
+			Counted* object = alloc.create(i);
+			other.destroy(other.create(-i));
+			allValid &= alloc.create(i + 1)->value == i + 1 && object->value == i;
+		}
+		EXPECT(allValid && Counted::numAlive == 0, "Short-lived allocators with thread local caches.");
+	}
+
+	return testsFailed;
+}
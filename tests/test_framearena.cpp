@@ -0,0 +1,84 @@
+#include "testutils.hpp"
+
+#include <engine/utils/framearena.hpp>
+#include <vector>
+#include <string>
+#include <cstdlib>
+#include <cstdint>
+#include <new>
+
+// Allocation counting hook: every global allocation increments the counter.
+static size_t numAllocations = 0;
+
+void* operator new(size_t _size)
+{
+	++numAllocations;
+	if (void* ptr = std::malloc(_size ? _size : 1)) return ptr;
+	throw std::bad_alloc();
+}
+void* operator new(size_t _size, std::align_val_t _alignment)
+{
+	++numAllocations;
+	const size_t alignment = static_cast<size_t>(_alignment);
+	if (void* ptr = std::aligned_alloc(alignment, (_size + alignment - 1) / alignment * alignment)) return ptr;
+	throw std::bad_alloc();
+}
+void operator delete(void* _ptr) noexcept { std::free(_ptr); }
+void operator delete(void* _ptr, size_t) noexcept { std::free(_ptr); }
+void operator delete(void* _ptr, std::align_val_t) noexcept { std::free(_ptr); }
+void operator delete(void* _ptr, size_t, std::align_val_t) noexcept { std::free(_ptr); }
+
+struct alignas(64) CacheLine { int value; };
+
+// Typical per frame data: a growing instance list and some temporary strings.
+size_t buildFrame(utils::FrameArena& _arena, int _numInstances)
+{
+	std::pmr::vector<CacheLine> instances(&_arena);
+	for (int i = 0; i < _numInstances; ++i)
+		instances.push_back(CacheLine{ i });
+	std::pmr::string label("a label which does not fit into the small string buffer", &_arena);
+	for (int i = 0; i < 10; ++i)
+		label += std::to_string(i).c_str();
+	return instances.size() + label.size();
+}
+
+int main()
+{
+	{
+		utils::FrameArena arena(1024);
+		for (int frame = 0; frame < 4; ++frame)
+		{
+			arena.nextFrame();
+			buildFrame(arena, 2000);
+		}
+		const size_t upstream = arena.numUpstreamAllocations();
+		const size_t allocations = numAllocations;
+		bool allAligned = true;
+		for (int frame = 0; frame < 100; ++frame)
+		{
+			arena.nextFrame();
+			buildFrame(arena, 1000 + frame * 10);
+			std::pmr::vector<CacheLine> aligned(3, CacheLine{ 1 }, &arena);
+			allAligned &= reinterpret_cast<uintptr_t>(aligned.data()) % alignof(CacheLine) == 0;
+		}
+		EXPECT(numAllocations == allocations && arena.numUpstreamAllocations() == upstream,
+			"Steady state frames do not allocate.");
+		EXPECT(allAligned, "Allocations are aligned.");
+	}
+
+	{
+		utils::FrameArena arena(256);
+		std::pmr::vector<int> previous(100, 7, &arena);
+		arena.nextFrame();
+		std::pmr::vector<int> current(1000, 3, &arena);
+		bool valid = true;
+		for (int value : previous) valid &= value == 7;
+		EXPECT(valid && arena.frameUsage() >= 1000 * sizeof(int), "Memory of the previous frame stays valid.");
+
+		arena.nextFrame();
+		arena.nextFrame();
+		EXPECT(arena.capacity() >= 1000 * sizeof(int) && arena.frameUsage() == 0, "Buffer grows to the peak usage.");
+	}
+
+	return testsFailed;
+}
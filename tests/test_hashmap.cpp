@@ -0,0 +1,458 @@
+#include "testutils.hpp"
+
+#include <engine/utils/containers/hashmap.hpp>
+#include <engine/utils/containers/flathashmap.hpp>
+#include <engine/utils/containers/concurrenthashmap.hpp>
+#include <engine/utils/containers/densehashmap.hpp>
+#include <engine/utils/containers/mappedhashmap.hpp>
+#include <engine/utils/resourcemanager.hpp>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <random>
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+
+// Shared test cases for all maps with the HashMap interface.
+template<typename MapT>
+void testMapInterface(const char* _name)
+{
+	MapT map;
+	std::unordered_map<std::string, int> reference;
+
+	EXPECT(map.size() == 0 && !map.begin(), std::string(_name) + ": Construct an empty map.");
+
+	for (int i = 0; i < 1000; ++i)
+	{
+		const std::string key = std::to_string(i * 7);
+		map.add(key, i);
+		reference[key] = i;
+	}
+	EXPECT(map.size() == 1000, std::string(_name) + ": Insert multiple elements with resizes.");
+
+	bool allFound = true;
+	for (auto& [key, value] : reference)
+	{
+		auto hndl = map.find(key);
+		allFound &= hndl && hndl.data() == value;
+	}
+	EXPECT(allFound, std::string(_name) + ": Find all inserted elements.");
+	EXPECT(!map.find("not a key"), std::string(_name) + ": Do not find missing elements.");
+
+	map.add(std::string("0"), -1);
+	EXPECT(map.size() == 1000 && map.find("0").data() == -1, std::string(_name) + ": Overwrite existing elements.");
+	reference["0"] = -1;
+
+	map["new"] = 42;
+	EXPECT(map.size() == 1001 && map.find("new").data() == 42, std::string(_name) + ": Insert with operator[].");
+	reference["new"] = 42;
+
+	// remove every second element
+	for (int i = 0; i < 1000; i += 2)
+	{
+		const std::string key = std::to_string(i * 7);
+		map.remove(key);
+		reference.erase(key);
+	}
+	EXPECT(map.size() == reference.size(), std::string(_name) + ": Remove elements.");
+
+	allFound = true;
+	for (auto& [key, value] : reference)
+	{
+		auto hndl = map.find(key);
+		allFound &= hndl && hndl.data() == value;
+	}
+	EXPECT(allFound, std::string(_name) + ": Remaining elements are found after remove.");
+
+	size_t count = 0;
+	for (auto it : map)
+	{
+		auto refIt = reference.find(it.key());
+		EXPECT(refIt != reference.end() && refIt->second == it.data(), std::string(_name) + ": Iterate over elements.");
+		++count;
+	}
+	EXPECT(count == reference.size(), std::string(_name) + ": Iterate over all elements.");
+
+	// churn to create many tombstones/shifts
+	std::default_random_engine rng(1234);
+	for (int i = 0; i < 10000; ++i)
+	{
+		const std::string key = "churn" + std::to_string(rng() % 100);
+		if (map.find(key)) map.remove(key);
+		else map.add(key, i);
+	}
+	allFound = true;
+	for (auto& [key, value] : reference)
+		allFound &= map.find(key) && map.find(key).data() == value;
+	EXPECT(allFound, std::string(_name) + ": Elements survive insert/remove churn.");
+
+	MapT moved(std::move(map));
+	EXPECT(moved.find("new") && moved.find("new").data() == 42, std::string(_name) + ": Move construct.");
+
+	moved.clear();
+	EXPECT(moved.size() == 0 && !moved.find("new"), std::string(_name) + ": Clear.");
+}
+
+struct TransparentHash
+{
+	using is_transparent = void;
+	size_t operator()(std::string_view _str) const { return std::hash<std::string_view>()(_str); }
+};
+
+template<typename MapT>
+void testTransparentLookup(const char* _name)
+{
+	MapT map;
+	for (int i = 0; i < 100; ++i)
+		map.add(std::to_string(i), i);
+
+	const std::string_view view = "42";
+	EXPECT(map.find(view) && map.find(view).data() == 42, std::string(_name) + ": Find with a std::string_view.");
+	EXPECT(map.find("17") && map.find("17").data() == 17, std::string(_name) + ": Find with a string literal.");
+	EXPECT(!map.find(std::string_view("420")), std::string(_name) + ": Do not find missing elements with a std::string_view.");
+
+	const size_t hash = TransparentHash()(view);
+	EXPECT(map.find(view, hash) && map.find(view, hash).data() == 42, std::string(_name) + ": Find with a precomputed hash.");
+	map.add(std::string("abc"), -1, TransparentHash()("abc"));
+	EXPECT(map.find("abc") && map.find("abc").data() == -1, std::string(_name) + ": Add with a precomputed hash.");
+
+	const MapT& constMap = map;
+	EXPECT(constMap.find(view) && constMap.find(view).data() == 42, std::string(_name) + ": Const find with a std::string_view.");
+}
+
+void testDenseStorage()
+{
+	utils::DenseHashMap<int, int> map;
+	for (int i = 0; i < 100; ++i)
+		map.add(i, i * 2);
+
+	bool inOrder = true;
+	int expected = 0;
+	for (auto it : map)
+	{
+		inOrder &= it.key() == expected && it.data() == expected * 2;
+		++expected;
+	}
+	EXPECT(inOrder && expected == 100, "DenseHashMap: Iterate in insertion order.");
+
+	for (int i = 0; i < 100; ++i)
+		if (i % 10 != 0) map.remove(i);
+	int sum = 0;
+	for (int value : map.values())
+		sum += value;
+	EXPECT(map.size() == 10 && map.values().size() == 10 && sum == 900, "DenseHashMap: Dense values after remove.");
+
+	bool consistent = true;
+	for (uint32_t i = 0; i < map.size(); ++i)
+		consistent &= map.find(map.keys()[i]).data() == map.values()[i];
+	EXPECT(consistent, "DenseHashMap: Swap-remove keeps index table consistent.");
+
+	utils::DenseHashMap<int, bool> flags;
+	for (int i = 0; i < 50; ++i)
+		flags.add(i, i % 2 == 0);
+	flags[7] = true;
+	flags.find(8).data() = false;
+	flags.remove(0);
+	const utils::DenseHashMap<int, bool> flagsCopy = flags;
+	int numSet = 0;
+	for (bool flag : flagsCopy.values())
+		numSet += flag;
+	EXPECT(flagsCopy.size() == 49 && numSet == 24 && flagsCopy.find(7).data() && !flagsCopy.find(8).data(),
+		"DenseHashMap: Bool values are not packed.");
+}
+
+void testMappedHashMap()
+{
+	utils::HashMap<uint32_t, float> map;
+	for (uint32_t i = 0; i < 1000; ++i)
+		map.add(i * 3, static_cast<float>(i) * 0.5f);
+
+	using MappedMap = utils::MappedHashMap<uint32_t, float>;
+	const std::vector<char> image = MappedMap::serialize(map);
+	const MappedMap mapped(image);
+	bool allFound = mapped.isValid() && mapped.size() == 1000;
+	for (auto it : map)
+	{
+		auto hndl = mapped.find(it.key());
+		allFound &= hndl && hndl.key() == it.key() && hndl.data() == it.data();
+	}
+	EXPECT(allFound, "MappedHashMap: Find all elements in an in-memory image.");
+	EXPECT(!mapped.find(1), "MappedHashMap: Do not find missing elements.");
+
+	utils::DenseHashMap<std::string, int> names;
+	for (int i = 0; i < 500; ++i)
+		names.add("textures/tile_" + std::to_string(i) + ".png", i);
+	const char* fileName = "test_hashmap_image.bin";
+	using MappedNames = utils::MappedHashMap<std::string, int>;
+	EXPECT(MappedNames::write(fileName, names), "MappedHashMap: Write an image with string keys.");
+	{
+		const MappedNames mappedNames(fileName);
+		allFound = mappedNames.isValid() && mappedNames.size() == 500;
+		for (auto it : names)
+		{
+			auto hndl = mappedNames.find(it.key());
+			allFound &= hndl && hndl.key() == it.key() && hndl.data() == it.data();
+		}
+		EXPECT(allFound, "MappedHashMap: Find all string keys in a memory mapped file.");
+		EXPECT(!mappedNames.find("textures/tile_500.png"), "MappedHashMap: Do not find missing string keys.");
+	}
+	std::remove(fileName);
+
+	const utils::MappedHashMap<uint64_t, float> wrongType(image);
+	const MappedMap truncated(std::span<const char>(image.data(), image.size() / 2));
+	EXPECT(!wrongType.isValid() && !truncated.isValid() && !truncated.find(3), "MappedHashMap: Reject incompatible images.");
+
+	// corrupt images: every entry used, so probing for a missing key would never end
+	using Header = utils::details::MappedImageHeader;
+	Header header;
+	std::memcpy(&header, image.data(), sizeof(Header));
+	std::vector<char> fullImage = image;
+	const uint32_t used = 1;
+	for (uint32_t i = 0; i < header.capacity; ++i)
+		std::memcpy(fullImage.data() + header.entriesOffset + i * header.entrySize + sizeof(uint32_t), &used, sizeof(uint32_t));
+	header.size = header.capacity;
+	std::memcpy(fullImage.data(), &header, sizeof(Header));
+	const MappedMap full(fullImage);
+	EXPECT(full.isValid() && !full.find(1), "MappedHashMap: Probing ends in images without free entries.");
+
+	// a pooled key which points behind the string pool
+	const std::vector<char> validNamesImage = MappedNames::serialize(names);
+	auto corruptKey = [&](uint32_t _offset, uint64_t _stringPoolSize)
+	{
+		std::vector<char> namesImage = validNamesImage;
+		std::memcpy(&header, namesImage.data(), sizeof(Header));
+		for (uint32_t i = 0; i < header.capacity; ++i)
+		{
+			char* entry = namesImage.data() + header.entriesOffset + i * header.entrySize;
+			uint32_t entryUsed;
+			std::memcpy(&entryUsed, entry + sizeof(uint32_t), sizeof(uint32_t));
+			if (!entryUsed) continue;
+			std::memcpy(entry + 2 * sizeof(uint32_t), &_offset, sizeof(uint32_t));
+			break;
+		}
+		header.stringPoolSize = _stringPoolSize;
+		std::memcpy(namesImage.data(), &header, sizeof(Header));
+		return namesImage;
+	};
+	std::memcpy(&header, validNamesImage.data(), sizeof(Header));
+	const std::vector<char> outsideImage = corruptKey(static_cast<uint32_t>(header.stringPoolSize), header.stringPoolSize);
+	const MappedNames outside(outsideImage);
+	size_t numFound = 0;
+	for (auto it : names)
+		numFound += outside.find(it.key()) ? 1 : 0;
+	EXPECT(outside.isValid() && numFound == names.size() - 1, "MappedHashMap: Ignore keys outside of the string pool.");
+	const std::vector<char> hugePoolImage = corruptKey(0x40000000, ~0ull);
+	EXPECT(!MappedNames(hugePoolImage).isValid(), "MappedHashMap: Reject string pools larger than the image.");
+	EXPECT(MappedNames(validNamesImage).isValid(), "MappedHashMap: Accept valid string images.");
+}
+
+void testSnapshot()
+{
+	using PowerOfTwoMap = utils::HashMap<uint32_t, float, std::hash<uint32_t>, std::equal_to<uint32_t>, utils::PowerOfTwoLayout>;
+	PowerOfTwoMap map;
+	for (uint32_t i = 0; i < 1000; ++i)
+		map.add(i * 3, static_cast<float>(i) * 0.5f);
+	map.remove(30u);
+	std::stringstream stream;
+	utils::BinaryWriter writer(stream);
+	map.snapshot(writer);
+	const std::string data = stream.str();
+
+	PowerOfTwoMap restored;
+	utils::BinaryReader reader(data);
+	bool allFound = restored.restore(reader) && restored.size() == 999;
+	for (auto it : map)
+	{
+		auto hndl = restored.find(it.key());
+		allFound &= hndl && hndl.data() == it.data();
+	}
+	EXPECT(allFound && !restored.find(30u), "HashMap: Restore a table snapshot.");
+	restored.add(30u, 1.f);
+	EXPECT(restored.size() == 1000 && restored.find(30u).data() == 1.f, "HashMap: Add elements after restoring.");
+
+	utils::HashMap<uint32_t, float> otherLayout;
+	utils::BinaryReader otherReader(data);
+	EXPECT(!otherLayout.restore(otherReader) && otherLayout.size() == 0, "HashMap: Reject snapshots with another layout.");
+
+	struct OtherHash
+	{
+		size_t operator()(uint32_t _key) const { return _key * 7u; }
+	};
+	utils::HashMap<uint32_t, float, OtherHash, std::equal_to<uint32_t>, utils::PowerOfTwoLayout> otherHash;
+	utils::BinaryReader otherHashReader(data);
+	EXPECT(!otherHash.restore(otherHashReader) && otherHash.size() == 0, "HashMap: Reject snapshots with another hash.");
+
+	// corrupt tables: all entries used with huge probing distances
+	struct StoredKey { uint32_t key; uint32_t dist; uint32_t hash; };
+	const size_t keysOffset = sizeof(utils::details::SnapshotHeader) + sizeof(uint32_t);
+	uint32_t capacity;
+	std::memcpy(&capacity, data.data() + sizeof(utils::details::SnapshotHeader), sizeof(uint32_t));
+	std::string fullData = data;
+	for (uint32_t i = 0; i < capacity; ++i)
+	{
+		const StoredKey stored{ i, 0x7fffffff, 0 };
+		std::memcpy(fullData.data() + keysOffset + i * sizeof(StoredKey), &stored, sizeof(StoredKey));
+	}
+	utils::BinaryReader fullReader(fullData);
+	EXPECT(!restored.restore(fullReader) && restored.size() == 0, "HashMap: Reject tables with invalid distances.");
+
+	// an element which is not at the position of its hash
+	std::string movedData = data;
+	for (uint32_t i = 0; i < capacity; ++i)
+	{
+		StoredKey stored;
+		std::memcpy(&stored, movedData.data() + keysOffset + i * sizeof(StoredKey), sizeof(StoredKey));
+		if (stored.dist == 0xffffffff) continue;
+		++stored.key;
+		std::memcpy(movedData.data() + keysOffset + i * sizeof(StoredKey), &stored, sizeof(StoredKey));
+		break;
+	}
+	utils::BinaryReader movedReader(movedData);
+	EXPECT(!restored.restore(movedReader) && restored.size() == 0, "HashMap: Reject misplaced elements.");
+
+	utils::HashMap<std::string, int> names;
+	for (int i = 0; i < 500; ++i)
+		names.add("textures/tile_" + std::to_string(i) + ".png", i);
+	std::stringstream namesStream;
+	utils::BinaryWriter namesWriter(namesStream);
+	names.snapshot(namesWriter);
+	const std::string namesData = namesStream.str();
+	utils::HashMap<std::string, int, std::hash<std::string>, std::equal_to<std::string>, utils::PowerOfTwoLayout> restoredNames;
+	utils::BinaryReader namesReader(namesData);
+	allFound = restoredNames.restore(namesReader) && restoredNames.size() == 500;
+	for (auto it : names)
+	{
+		auto hndl = restoredNames.find(it.key());
+		allFound &= hndl && hndl.data() == it.data();
+	}
+	EXPECT(allFound, "HashMap: Restore serialized string keys into another layout.");
+}
+
+struct CountingLoader
+{
+	using Handle = int;
+	static inline std::atomic<int> numLoads = 0;
+	static Handle load(const char* _name) { ++numLoads; return static_cast<int>(std::string_view(_name).size()); }
+	static void unload(Handle) { --numLoads; }
+};
+
+void testConcurrentHashMap()
+{
+	constexpr int NUM_THREADS = 8;
+	constexpr int NUM_KEYS = 10000;
+
+	utils::ConcurrentHashMap<int, int> map;
+	std::atomic<int> numCreated = 0;
+	std::atomic<bool> allValid = true;
+	std::vector<std::thread> threads;
+	for (int t = 0; t < NUM_THREADS; ++t)
+		threads.emplace_back([&, t]()
+			{
+				// private keys: add, read back and remove every second one
+				const int base = (t + 1) * NUM_KEYS;
+				for (int i = 0; i < NUM_KEYS; ++i)
+					map.add(base + i, i);
+				for (int i = 0; i < NUM_KEYS; ++i)
+				{
+					const std::optional<int> value = map.find(base + i);
+					if (!value || *value != i) allValid = false;
+				}
+				for (int i = 0; i < NUM_KEYS; i += 2)
+					map.remove(base + i);
+
+				// shared keys: all threads race to create the same elements
+				for (int i = 0; i < NUM_KEYS; ++i)
+				{
+					const int value = map.findOrAdd(i, std::hash<int>()(i), [&]() { ++numCreated; return -i; });
+					if (value != -i) allValid = false;
+				}
+			});
+	for (auto& thread : threads)
+		thread.join();
+
+	EXPECT(allValid, "ConcurrentHashMap: Concurrent add, find and findOrAdd return the correct values.");
+	EXPECT(numCreated == NUM_KEYS, "ConcurrentHashMap: findOrAdd creates each element exactly once.");
+	EXPECT(map.size() == NUM_KEYS + NUM_THREADS * NUM_KEYS / 2, "ConcurrentHashMap: Size after concurrent modifications.");
+	EXPECT(!map.find(NUM_KEYS) && map.find(NUM_KEYS + 1) == 1, "ConcurrentHashMap: Removed elements are gone.");
+
+	int count = 0;
+	map.forEach([&](int, int) { ++count; });
+	EXPECT(count == static_cast<int>(map.size()), "ConcurrentHashMap: Iterate over all elements.");
+	map.clear();
+	EXPECT(map.size() == 0, "ConcurrentHashMap: Clear.");
+
+	// _create runs without the lock: it can use the map and does not block the shard
+	{
+		utils::ConcurrentHashMap<int, int, std::hash<int>, std::equal_to<int>, utils::OddCapacityLayout, 1> singleShard;
+		std::atomic<bool> creating = false;
+		std::atomic<bool> lookupDone = false;
+		std::thread creator([&]()
+			{
+				singleShard.findOrAdd(1, std::hash<int>()(1), [&]()
+					{
+						creating = true;
+						while (!lookupDone) std::this_thread::yield();
+						return singleShard.findOrAdd(2, std::hash<int>()(2), []() { return 2; }) + 10;
+					});
+			});
+		while (!creating) std::this_thread::yield();
+		singleShard.add(3, 3);
+		const bool found = singleShard.find(3) == 3;
+		lookupDone = true;
+		// waits for the pending creation instead of creating the element again
+		const int value = singleShard.findOrAdd(1, std::hash<int>()(1), []() { return -1; });
+		creator.join();
+		EXPECT(found && value == 12 && singleShard.find(2) == 2, "ConcurrentHashMap: findOrAdd creates elements without holding the lock.");
+
+		bool thrown = false;
+		try {
+			singleShard.findOrAdd(4, std::hash<int>()(4), []() -> int { throw std::runtime_error("failed"); });
+		}
+		catch (const std::runtime_error&) { thrown = true; }
+		EXPECT(thrown && !singleShard.find(4) && singleShard.findOrAdd(4, std::hash<int>()(4), []() { return 4; }) == 4,
+			"ConcurrentHashMap: A failed findOrAdd can be retried.");
+	}
+
+	using Manager = utils::ResourceManager<CountingLoader, utils::details::ResourceRegisterDummy, true>;
+	threads.clear();
+	std::atomic<bool> sameHandles = true;
+	for (int t = 0; t < NUM_THREADS; ++t)
+		threads.emplace_back([&]()
+			{
+				for (int i = 0; i < 1000; ++i)
+				{
+					const std::string name = "resource" + std::to_string(i % 100);
+					// the loader returns the length of the full path
+					if (Manager::get(name.c_str()) != static_cast<int>(name.size() + 13))
+						sameHandles = false;
+				}
+			});
+	for (auto& thread : threads)
+		thread.join();
+	EXPECT(sameHandles && CountingLoader::numLoads == 100, "ResourceManager: Thread safe get loads each resource once.");
+	Manager::clear();
+	EXPECT(CountingLoader::numLoads == 0, "ResourceManager: Clear unloads all resources.");
+}
+
+int main()
+{
+	testMapInterface<utils::HashMap<std::string, int>>("HashMap");
+	testMapInterface<utils::HashMap<std::string, int, std::hash<std::string>, std::equal_to<std::string>, utils::PowerOfTwoLayout>>("HashMap (power of two)");
+	testMapInterface<utils::FlatHashMap<std::string, int>>("FlatHashMap");
+	testMapInterface<utils::DenseHashMap<std::string, int>>("DenseHashMap");
+	testTransparentLookup<utils::HashMap<std::string, int, TransparentHash, std::equal_to<>>>("HashMap");
+	testTransparentLookup<utils::HashMap<std::string, int, TransparentHash, std::equal_to<>, utils::PowerOfTwoLayout>>("HashMap (power of two)");
+	testTransparentLookup<utils::FlatHashMap<std::string, int, TransparentHash, std::equal_to<>>>("FlatHashMap");
+	testTransparentLookup<utils::DenseHashMap<std::string, int, TransparentHash, std::equal_to<>>>("DenseHashMap");
+	testDenseStorage();
+	testConcurrentHashMap();
+	testMappedHashMap();
+	testSnapshot();
+
+	return testsFailed;
+}
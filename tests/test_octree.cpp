@@ -78,7 +78,7 @@ int testOctree2D()
 	EXPECT(tree.remove({ vec2(0.0f), vec2(0.49f) }, 2), "Remove existing element.");
 	EXPECT(!tree.remove({ vec2(0.0f), vec2(0.49f) }, 2), "Remove not existing element.");
 	tree.traverse(proc);
-	EXPECT(proc.descends == 18 && proc.processed == 18, "Remove element.");
+	EXPECT(proc.descends == 17 && proc.processed == 18, "Remove element and free the empty node.");
 	for (auto& el : expectedElements)
 	{
 		if(el.second == 2)
@@ -88,9 +88,58 @@ int testOctree2D()
 	}
 
 
+	for (auto& [box, el] : expectedElements)
+		tree.remove(box, el);
+	for (int i = 0; i < 16; ++i)
+		tree.remove({ vec2(static_cast<float>(i) + 0.1f), vec2(static_cast<float>(i) + 1.51f) }, 3 + i);
+	proc.reset();
+	tree.traverse(proc);
+	EXPECT(proc.descends == 1 && proc.processed == 0, "Empty nodes are freed.");
+	EXPECT(tree.getRootAABB() == TreeT::AABB(vec2(0.f), vec2(1.f)), "Empty tree returns to the initial root.");
+
 	return testsFailed;
 }
 
+void testOctreeShrink()
+{
+	using TreeT = utils::SparseOctree<int, 2, float>;
+
+	TreeT tree(1.f);
+	tree.insert({ vec2(0.1f), vec2(0.2f) }, 0);
+	tree.insert({ vec2(100.f), vec2(100.5f) }, 1);
+	EXPECT(tree.getRootAABB() == TreeT::AABB(vec2(0.f), vec2(128.f)), "Root grows.");
+	const size_t memory = tree.memoryUsage();
+
+	tree.remove({ vec2(100.f), vec2(100.5f) }, 1);
+	EXPECT(tree.getRootAABB() == TreeT::AABB(vec2(0.f), vec2(1.f)), "Root shrinks to the initial size.");
+	TreeT::AABBQuery query({ vec2(0.f), vec2(1.f) });
+	tree.traverse(query);
+	EXPECT(query.hits.size() == 1 && query.hits[0] == 0, "Elements remain after shrinking.");
+
+	for (int i = 0; i < 100; ++i)
+	{
+		tree.insert({ vec2(100.f), vec2(100.5f) }, 1);
+		tree.remove({ vec2(100.f), vec2(100.5f) }, 1);
+	}
+	EXPECT(tree.memoryUsage() == memory, "Freed nodes are reused.");
+
+	// elements which moved away from the origin
+	tree.remove({ vec2(0.1f), vec2(0.2f) }, 0);
+	for (int i = 0; i < 4; ++i)
+		tree.insert({ vec2(50.f + i, 50.f), vec2(50.5f + i, 51.f) }, i);
+	Processor<TreeT> proc;
+	tree.traverse(proc);
+	const int descendsBefore = proc.descends;
+	tree.compact();
+	const TreeT::AABB root = tree.getRootAABB();
+	EXPECT(root.min == vec2(50.f) && root.max[0] < 54.f && root.max[1] < 54.f, "Compact encloses the elements tightly.");
+	proc.reset();
+	tree.traverse(proc);
+	EXPECT(proc.processed == 4 && proc.descends < descendsBefore, "Compact reduces the number of nodes.");
+	for (int i = 0; i < 4; ++i)
+		EXPECT(tree.remove({ vec2(50.f + i, 50.f), vec2(50.5f + i, 51.f) }, i), "Elements can be removed after compact.");
+}
+
 void testOctree3D()
 {
 	using TreeT = utils::SparseOctree<int, 2, double>;
@@ -127,6 +176,7 @@ void testOctree3D()
 int main() 
 {
 	testOctree2D();
+	testOctreeShrink();
 	testOctree3D();
 
 	return testsFailed;
@@ -1,6 +1,8 @@
 #include "testutils.hpp"
 
-#pragma error include registry file!!
+#include <engine/game/core/registry.hpp>
+#include <engine/utils/containers/archetypestorage.hpp>
+#include <string>
 #include <optional>
 #include <vector>
 
@@ -108,4 +110,61 @@ int main()
 			EXPECT(pBar->f == -1.f, "Action can change components.");
 		}
 	}
+
+	{
+		// the smallest pool (Bar) drives the iteration regardless of the parameter order
+		int count = 0;
+		Entity::IdType keySum = 0;
+		registry.execute([&](Foo& foo, Entity ent, const Bar&)
+			{
+				++count;
+				keySum += ent.toIndex();
+				EXPECT(registry.getComponents<Foo>().at(ent) == &foo, "Execute provides the matching components.");
+			});
+		EXPECT(count == 3 && keySum == entities[3].toIndex() + entities[6].toIndex() + entities[9].toIndex(),
+			"Execute visits each entity with all components once.");
+	}
+	{
+		utils::ArchetypeStorage<uint32_t, 256> storage;
+		for (uint32_t i = 0; i < 100; ++i)
+		{
+			storage.emplace<Foo>(i, Foo{ static_cast<int>(i) });
+			if (i % 2) storage.emplace<Bar>(i, Bar{ 0.5f });
+			if (i % 3 == 0) storage.emplace<std::string>(i, std::to_string(i));
+		}
+		EXPECT(storage.size() == 100 && storage.numArchetypes() == 5, "Archetypes for each component set.");
+		EXPECT(storage.at<Foo>(42)->i == 42 && !storage.at<Bar>(42) && *storage.at<std::string>(42) == "42",
+			"Access components in archetypes.");
+
+		int numMatches = 0;
+		bool keysMatch = true;
+		storage.forEach<Foo, const Bar>([&](uint32_t _key, Foo& _foo, const Bar& _bar)
+			{
+				keysMatch &= _foo.i == static_cast<int>(_key) && _bar.f == 0.5f;
+				++numMatches;
+			});
+		EXPECT(numMatches == 50 && keysMatch, "Iterate all keys with a component set.");
+
+		storage.remove<Foo>(3);
+		storage.remove<Bar>(3);
+		storage.remove<Bar>(3);
+		storage.erase(9);
+		storage.emplace<Bar>(4, Bar{ 2.f });
+		EXPECT(!storage.has<Foo>(3) && *storage.at<std::string>(3) == "3" && !storage.contains(9) && storage.size() == 99
+			&& storage.at<Foo>(4)->i == 4 && storage.at<Bar>(4)->f == 2.f, "Move keys between archetypes.");
+
+		int sum = 0;
+		storage.forEach<std::string, Foo>([&](uint32_t, std::string& _str, Foo& _foo)
+			{
+				sum += std::stoi(_str) - _foo.i;
+			});
+		bool stringsValid = true;
+		storage.forEach<const std::string>([&](uint32_t _key, const std::string& _str)
+			{
+				stringsValid &= _str == std::to_string(_key);
+			});
+		EXPECT(sum == 0 && stringsValid, "Non trivial components are moved with their keys.");
+	}
+
+	return testsFailed;
 }
@@ -1,7 +1,16 @@
 #include "testutils.hpp"
 
 #include <engine/utils/containers/weakslotmap.hpp>
+#include <engine/utils/containers/slotmap.hpp>
+#include <engine/utils/containers/flatmultislotmap.hpp>
+#include <engine/utils/containers/deferredcommands.hpp>
+#include <engine/utils/containers/keyintersection.hpp>
+#include <engine/utils/containers/slotmapgroup.hpp>
 #include <unordered_set>
+#include <atomic>
+#include <thread>
+#include <sstream>
+#include <algorithm>
 
 int constructed = 0;
 int moveConstructed = 0;
@@ -29,6 +38,18 @@ struct Dummy
 	std::string s;
 };
 
+// Bulk insertion which would bypass the links of a MultiSlotMap.
+template<typename Map>
+concept BulkEmplace = requires(Map& _map, std::span<const uint32_t> _keys, std::span<const int> _values)
+{
+	_map.emplaceRange(_keys, _values);
+	_map.emplaceN(0u, 1u, [](uint32_t) { return 0; });
+};
+
+// Constructed before the shared empty page of the paged index is first used and
+// therefore destroyed after any function-local static.
+utils::PagedSlotIndex<uint32_t, 256> g_staticIndex;
+
 int main()
 {
 	{
@@ -83,6 +104,583 @@ int main()
 		}
 	}
 	EXPECT(constructed + moveConstructed == destroyed, "All constructed objects have been destroyed after a move.");
+	{
+		utils::WeakSlotMap<int, false, utils::PagedSlotIndex<int>> slotMap(utils::TypeHolder<Dummy>{});
+		constexpr int keys[] = { 3, 50000000, 1024, 1023, 20000000 };
+		for (int key : keys)
+			slotMap.template emplace<Dummy>(key, std::to_string(key));
+		bool allFound = slotMap.size() == 5;
+		for (int key : keys)
+			allFound &= slotMap.contains(key) && slotMap.template at<Dummy>(key).s == std::to_string(key);
+		EXPECT(allFound && !slotMap.contains(1022) && !slotMap.contains(50000001), "Paged slot index with large keys.");
+
+		slotMap.erase(50000000);
+		slotMap.erase(3);
+		EXPECT(!slotMap.contains(50000000) && !slotMap.contains(3) && slotMap.template at<Dummy>(20000000).s == "20000000",
+			"Erase with paged slot index.");
+	}
+	EXPECT(constructed + moveConstructed == destroyed, "All constructed objects have been destroyed with paged slot index.");
+	{
+		using ChunkedMap = utils::WeakSlotMap<int, false, utils::DenseSlotIndex<int>, utils::ChunkedStorage<256>>;
+		ChunkedMap slotMap(utils::TypeHolder<Dummy>{}, 3);
+		Dummy* first = &slotMap.template emplace<Dummy>(0, "0");
+		const int movesBefore = moveConstructed;
+		for (int i = 1; i < 100; ++i)
+			slotMap.template emplace<Dummy>(i, std::to_string(i));
+		EXPECT(first == &slotMap.template at<Dummy>(0) && first->s == "0" && moveConstructed == movesBefore,
+			"Chunked storage keeps elements in place while growing.");
+
+		for (int i = 0; i < 100; i += 3)
+			slotMap.erase(i);
+		int sum = 0;
+		int count = 0;
+		for (const auto& [key, dummy] : slotMap.template iterate<Dummy>())
+		{
+			sum += std::stoi(dummy.s) == key ? key : -10000;
+			++count;
+		}
+		EXPECT(count == 66 && sum == 4950 - 1683 && slotMap.template at<Dummy>(98).s == "98",
+			"Erase and iterate with chunked storage.");
+
+		ChunkedMap moved(utils::TypeHolder<Dummy>{});
+		moved = std::move(slotMap);
+		EXPECT(moved.size() == 66 && moved.template at<Dummy>(97).s == "97", "Move assign with chunked storage.");
+	}
+	EXPECT(constructed + moveConstructed == destroyed, "All constructed objects have been destroyed with chunked storage.");
+	{
+		struct alignas(64) CacheLine { float values[4]; };
+		utils::WeakSlotMap<int, true> alignedMap(utils::TypeHolder<CacheLine>{}, 1);
+		utils::WeakSlotMap<int, true, utils::DenseSlotIndex<int>, utils::ChunkedStorage<256>> chunkedMap(utils::TypeHolder<CacheLine>{});
+		bool aligned = true;
+		for (int i = 0; i < 40; ++i)
+		{
+			aligned &= reinterpret_cast<uintptr_t>(&alignedMap.template emplace<CacheLine>(i, CacheLine{ { float(i) } })) % 64 == 0;
+			aligned &= reinterpret_cast<uintptr_t>(&chunkedMap.template emplace<CacheLine>(i, CacheLine{ { float(i) } })) % 64 == 0;
+		}
+		EXPECT(aligned, "Values are stored with their alignment.");
+
+		for (int i = 0; i < 40; i += 2)
+			alignedMap.erase(i);
+		alignedMap.sort();
+		bool correct = alignedMap.size() == 20;
+		int prevKey = -1;
+		for (const auto& [key, value] : alignedMap.template iterate<CacheLine>())
+		{
+			correct &= key > prevKey && value.values[0] == float(key) && key % 2 == 1;
+			prevKey = key;
+		}
+		EXPECT(correct, "Erase and sort trivially copyable values.");
+	}
+	{
+		utils::PagedSlotIndex<uint32_t, 256> index;
+		utils::DenseSlotIndex<uint32_t> denseIndex;
+		for (uint32_t i = 0; i < 100; ++i)
+		{
+			index.set(i * 1000000, i);
+			denseIndex.set(i * 10000, i);
+		}
+		const size_t usage = index.memoryUsage();
+		// 100 pages + page table (with some slack for the vector growth)
+		const size_t numPages = 99000000 / 256 + 1;
+		EXPECT(usage < 100 * 256 * sizeof(uint32_t) + 2 * numPages * (sizeof(uint32_t*) + sizeof(uint32_t)),
+			"Paged slot index only allocates used pages.");
+		EXPECT(index.get(5000000) == 5 && denseIndex.get(50000) == 5 && index.get(5000001) == index.INVALID,
+			"Slot index lookups.");
+		for (uint32_t i = 0; i < 50; ++i)
+			index.reset(i * 1000000);
+		EXPECT(index.memoryUsage() < usage && index.get(60000000) == 60, "Paged slot index releases empty pages.");
+		g_staticIndex.set(0, 0);
+		g_staticIndex.set(5000, 1);
+		EXPECT(g_staticIndex.get(5000) == 1 && g_staticIndex.get(2000) == g_staticIndex.INVALID, "Static paged slot index.");
+
+		utils::MultiSlotMap<uint32_t, int, utils::PagedSlotIndex<uint32_t>> multiMap;
+		multiMap.emplace(7000000, 1);
+		multiMap.emplace(12, 2);
+		multiMap.emplace(7000000, 3);
+		EXPECT(multiMap.size() == 3 && multiMap[7000000] == 3, "MultiSlotMap with paged slot index.");
+		multiMap.erase(7000000);
+		EXPECT(multiMap.size() == 1 && !multiMap.contains(7000000) && multiMap[12] == 2, "MultiSlotMap erase all values of a key.");
+	}
+	{
+		utils::WeakSlotMap<int> slotMap(utils::TypeHolder<Dummy>{});
+		for (int i = 0; i < 100; ++i)
+			slotMap.template emplace<Dummy>((i * 37) % 100, std::to_string((i * 37) % 100));
+		for (int i = 0; i < 100; i += 3)
+			slotMap.erase(i);
+
+		slotMap.sort();
+		bool sorted = true;
+		int prev = -1;
+		for (const auto& [key, dummy] : slotMap.template iterate<Dummy>())
+		{
+			sorted &= key > prev && dummy.s == std::to_string(key);
+			prev = key;
+		}
+		bool found = true;
+		for (int i = 0; i < 100; ++i)
+			found &= (i % 3 == 0) != slotMap.contains(i) && (i % 3 == 0 || slotMap.template at<Dummy>(i).s == std::to_string(i));
+		EXPECT(sorted && found, "Sort WeakSlotMap by key.");
+
+		slotMap.template sortBy<Dummy>([](const Dummy& a, const Dummy& b) { return a.s > b.s; });
+		sorted = true;
+		std::string prevStr = "~";
+		for (const auto& [key, dummy] : slotMap.template iterate<Dummy>())
+		{
+			sorted &= dummy.s < prevStr && slotMap.template at<Dummy>(key).s == dummy.s;
+			prevStr = dummy.s;
+		}
+		EXPECT(sorted, "Sort WeakSlotMap with a custom order.");
+	}
+	EXPECT(constructed + moveConstructed == destroyed, "All constructed objects have been destroyed after sorting.");
+	{
+		utils::SlotMap<uint32_t, int> slotMap;
+		for (uint32_t i = 0; i < 50; ++i)
+			slotMap.emplace((i * 7) % 50, static_cast<int>((i * 7) % 50) * 10);
+		slotMap.erase(7);
+		slotMap.sort();
+		bool sorted = true;
+		uint32_t expected = 0;
+		for (auto it = slotMap.begin(); it != slotMap.end(); ++it, ++expected)
+		{
+			if (expected == 7) ++expected;
+			sorted &= it.key() == expected && *it == static_cast<int>(expected) * 10 && slotMap[expected] == *it;
+		}
+		EXPECT(sorted, "Sort SlotMap by key.");
+
+		slotMap.sortBy([](int a, int b) { return a > b; });
+		EXPECT(*slotMap.begin() == 490 && slotMap[49] == 490 && slotMap[0] == 0, "Sort SlotMap with a custom order.");
+
+		utils::MultiSlotMap<uint32_t, int> multiMap;
+		for (int i = 0; i < 30; ++i)
+			multiMap.emplace(static_cast<uint32_t>(i % 4), i);
+		multiMap.sort();
+		bool grouped = true;
+		int lastKey = 0;
+		for (auto it = multiMap.begin(); it != multiMap.end(); ++it)
+		{
+			grouped &= static_cast<int>(it.key()) >= lastKey && *it % 4 == static_cast<int>(it.key());
+			lastKey = it.key();
+		}
+		EXPECT(grouped && multiMap[2] == 26, "Sort MultiSlotMap by key.");
+		multiMap.erase(1);
+		multiMap.erase(3);
+		grouped = multiMap.size() == 15;
+		for (auto it = multiMap.begin(); it != multiMap.end(); ++it)
+			grouped &= it.key() == 0 || it.key() == 2;
+		EXPECT(grouped, "Erase from MultiSlotMap after sorting.");
+	}
+	{
+		utils::FlatMultiSlotMap<uint32_t, Dummy> multiMap;
+		EXPECT(multiMap.empty() && multiMap.span(3).empty(), "Construct an empty FlatMultiSlotMap.");
+
+		// interleaved inserts force ranges to move and the buffer to compact
+		for (int i = 0; i < 200; ++i)
+			multiMap.emplace(static_cast<uint32_t>(i % 7), std::to_string(i));
+		bool contiguous = multiMap.size() == 200 && multiMap.numKeys() == 7;
+		for (uint32_t key = 0; key < 7; ++key)
+		{
+			int expected = static_cast<int>(key);
+			for (const Dummy& dummy : multiMap.span(key))
+			{
+				contiguous &= dummy.s == std::to_string(expected);
+				expected += 7;
+			}
+			contiguous &= expected >= 200;
+		}
+		EXPECT(contiguous, "FlatMultiSlotMap keeps all values of a key in insertion order.");
+
+		multiMap.erase(3);
+		multiMap.erase(6);
+		int count = 0;
+		multiMap.forEach(4, [&](Dummy& dummy) { count += dummy.s.size() > 0; });
+		EXPECT(!multiMap.contains(3) && multiMap.numKeys() == 5 && count == 28, "Erase all values of a key in FlatMultiSlotMap.");
+
+		multiMap.compact();
+		for (int i = 0; i < 10; ++i)
+			multiMap.emplace(100u, "x");
+		size_t total = 0;
+		multiMap.forEachKey([&](uint32_t, std::span<Dummy> _values) { total += _values.size(); });
+		EXPECT(total == multiMap.size() && multiMap.span(100).size() == 10 && multiMap.span(0)[1].s == "7",
+			"Compact FlatMultiSlotMap.");
+
+		utils::FlatMultiSlotMap<uint32_t, Dummy> moved(std::move(multiMap));
+		EXPECT(moved.span(100).size() == 10 && multiMap.empty(), "Move construct FlatMultiSlotMap.");
+
+		utils::MultiSlotMap<uint32_t, int> linkedMap;
+		for (int i = 0; i < 20; ++i)
+			linkedMap.emplace(static_cast<uint32_t>(i % 3), i);
+		linkedMap.erase(1);
+		int sum = 0;
+		linkedMap.forEach(2, [&](int _value) { sum += _value; });
+		EXPECT(sum == 2 + 5 + 8 + 11 + 14 + 17 && linkedMap.size() == 13, "MultiSlotMap forEach after erase.");
+		static_assert(BulkEmplace<utils::SlotMap<uint32_t, int>> && !BulkEmplace<utils::MultiSlotMap<uint32_t, int>>,
+			"MultiSlotMap has no bulk emplace.");
+	}
+	EXPECT(constructed + moveConstructed == destroyed, "All constructed objects have been destroyed by FlatMultiSlotMap.");
+	{
+		utils::SlotMap<uint32_t, int> slotMap;
+		for (uint32_t i = 0; i < 1000; ++i)
+			slotMap.emplace(i, static_cast<int>(i));
+
+		// erase all odd keys and add new keys while iterating on multiple threads
+		utils::DeferredCommands<uint32_t, int> commands;
+		std::vector<std::thread> threads;
+		for (uint32_t t = 0; t < 4; ++t)
+		{
+			threads.emplace_back([&, t]()
+				{
+					for (auto it = slotMap.begin(); it != slotMap.end(); ++it)
+					{
+						if (it.key() % 4 != t) continue;
+						if (it.key() % 2) commands.erase(it.key());
+						else commands.emplace(it.key() + 1000, -1);
+					}
+					commands.erase(5000); // does not exist
+				});
+		}
+		for (std::thread& thread : threads)
+			thread.join();
+		EXPECT(commands.size() == 1004 && slotMap.size() == 1000, "Record deferred commands.");
+
+		commands.apply(slotMap);
+		bool correct = slotMap.size() == 1000 && commands.empty();
+		for (uint32_t i = 0; i < 2000; ++i)
+			correct &= slotMap.contains(i) == (i % 2 == 0) && (!slotMap.contains(i) || slotMap[i] == (i < 1000 ? static_cast<int>(i) : -1));
+		EXPECT(correct, "Apply deferred commands to SlotMap.");
+
+		utils::WeakSlotMap<uint32_t> weakMap(utils::TypeHolder<Dummy>{});
+		utils::DeferredCommands<uint32_t, Dummy> weakCommands;
+		for (uint32_t i = 0; i < 10; ++i)
+			weakCommands.emplace(9 - i, std::to_string(9 - i));
+		weakCommands.apply(weakMap);
+		weakCommands.erase(3);
+		weakCommands.erase(3);
+		weakCommands.erase(9);
+		weakCommands.emplace(3, "new");
+		weakCommands.apply(weakMap);
+		EXPECT(weakMap.size() == 9 && weakMap.template at<Dummy>(3).s == "new" && !weakMap.contains(9)
+			&& weakMap.template at<Dummy>(8).s == "8", "Apply deferred commands to WeakSlotMap.");
+	}
+	EXPECT(constructed + moveConstructed == destroyed, "All constructed objects have been destroyed by deferred commands.");
+	{
+		utils::DynamicBitset bits(70);
+		bits.set(3);
+		bits.set(64);
+		bits.resize(130, true);
+		bits.reset(100);
+		std::vector<size_t> setBits;
+		bits.forEachSet([&](size_t _ind) { setBits.push_back(_ind); });
+		EXPECT(setBits.size() == 2 + 59 && setBits[0] == 3 && setBits[1] == 64 && setBits[2] == 70 && bits.count() == 61,
+			"DynamicBitset enumerates set bits.");
+		bits.resize(65);
+		EXPECT(bits.count() == 2 && bits.test(64), "Shrink DynamicBitset.");
+
+		utils::SlotMap<uint32_t, int, utils::DenseSlotIndex<uint32_t>, true> slotMap;
+		for (uint32_t i = 0; i < 200; ++i)
+			slotMap.emplace(i, static_cast<int>(i));
+		EXPECT(slotMap.numDirty() == 200, "New elements are dirty.");
+		slotMap.clearDirty();
+		slotMap[150] = -1;
+		slotMap.markDirty(7);
+		std::as_const(slotMap)[8];
+		slotMap.erase(199);
+		slotMap.erase(7);
+		std::vector<uint32_t> dirtyKeys;
+		slotMap.forEachDirty([&](uint32_t _key, int&) { dirtyKeys.push_back(_key); });
+		EXPECT(dirtyKeys.size() == 1 && dirtyKeys[0] == 150 && slotMap.isDirty(150) && !slotMap.isDirty(198),
+			"SlotMap tracks changes through erase.");
+		slotMap.sortBy([](int a, int b) { return a > b; });
+		EXPECT(slotMap.numDirty() == 1 && slotMap.isDirty(150) && slotMap[150] == -1 && !slotMap.isDirty(198),
+			"SlotMap keeps dirty flags with their elements when sorting.");
+
+		utils::WeakSlotMap<uint32_t, true, utils::DenseSlotIndex<uint32_t>, utils::ContiguousStorage, true> weakMap(utils::TypeHolder<int>{});
+		for (uint32_t i = 0; i < 100; ++i)
+			weakMap.template emplace<int>(i, 0);
+		weakMap.clearDirty();
+		weakMap.template at<int>(42) = 1;
+		weakMap.markDirty(99);
+		weakMap.erase(0); // moves 99 into the first slot
+		int dirtySum = 0;
+		weakMap.template forEachDirty<int>([&](uint32_t _key, int&) { dirtySum += static_cast<int>(_key); });
+		EXPECT(dirtySum == 42 + 99 && weakMap.numDirty() == 2, "WeakSlotMap tracks changes through erase.");
+		weakMap.sort();
+		EXPECT(weakMap.numDirty() == 2 && weakMap.isDirty(42) && weakMap.isDirty(99) && !weakMap.isDirty(98),
+			"WeakSlotMap keeps dirty flags with their elements when sorting.");
+		weakMap.clearDirty();
+		EXPECT(weakMap.numDirty() == 0, "Clear dirty flags.");
+	}
+	{
+		utils::ThreadPool pool(3);
+		utils::ThreadPool serialPool(0);
+		utils::SlotMap<uint32_t, float> slotMap;
+		for (uint32_t i = 0; i < 10000; ++i)
+			slotMap.emplace(i * 3, 0.1f * static_cast<float>(i));
+
+		std::atomic<int> numCalls = 0;
+		slotMap.parallelForEach([&](uint32_t _key, float& _value)
+			{
+				_value = static_cast<float>(_key / 3) * 0.5f;
+				++numCalls;
+			}, pool);
+		EXPECT(numCalls == 10000 && slotMap[300] == 50.f && slotMap[29997] == 4999.5f, "SlotMap parallelForEach visits all elements.");
+
+		auto sum = [](double& _acc, uint32_t, float _value) { _acc += _value; };
+		auto add = [](double _a, double _b) { return _a + _b; };
+		const double parallelSum = slotMap.parallelReduce(0.0, sum, add, pool);
+		const double serialSum = slotMap.parallelReduce(0.0, sum, add, serialPool);
+		EXPECT(parallelSum == serialSum && parallelSum == 0.5 * 9999 * 10000 / 2, "Deterministic parallelReduce.");
+
+		utils::WeakSlotMap<uint32_t> weakMap(utils::TypeHolder<int>{});
+		for (uint32_t i = 0; i < 5000; ++i)
+			weakMap.template emplace<int>(i, 1);
+		weakMap.template iterate<int>().parallelForEach([](uint32_t _key, int& _value) { _value += static_cast<int>(_key); }, pool);
+		const utils::WeakSlotMap<uint32_t>& constMap = weakMap;
+		const int64_t weakSum = constMap.template iterate<int>().parallelReduce(int64_t(0),
+			[](int64_t& _acc, uint32_t, const int& _value) { _acc += _value; },
+			[](int64_t _a, int64_t _b) { return _a + _b; }, pool);
+		EXPECT(weakSum == 5000 + 4999 * 5000 / 2, "Parallel iteration of WeakSlotMap.");
+
+		const bool allPositive = slotMap.parallelReduce(true,
+			[](bool& _acc, uint32_t, float _value) { _acc = _acc && _value >= 0.f; },
+			[](bool _a, bool _b) { return _a && _b; }, pool);
+		EXPECT(allPositive, "parallelReduce with bool results.");
+
+		alignas(64) static char buffer[64 * 1024];
+		bool aligned = true;
+		for (size_t offset = 0; offset < 64; offset += 4)
+		{
+			const char* data = buffer + offset;
+			const utils::details::ChunkGrid chunks(data, 10000, 12);
+			size_t covered = 0;
+			for (size_t c = 0; c < chunks.numChunks(); ++c)
+			{
+				aligned &= chunks.begin(c) == covered && chunks.end(c) > chunks.begin(c);
+				aligned &= c == 0 || reinterpret_cast<uintptr_t>(data + chunks.begin(c) * 12) % 64 == 0;
+				covered = chunks.end(c);
+			}
+			aligned &= covered == 10000;
+		}
+		EXPECT(aligned, "Parallel chunks start on cache lines.");
+
+		// nested calls run serially instead of dead locking
+		std::atomic<int> nestedCalls = 0;
+		pool.run(8, [&](size_t) { pool.run(4, [&](size_t) { ++nestedCalls; }); });
+		EXPECT(nestedCalls == 32, "Nested thread pool calls.");
+	}
+
+	{
+		utils::SlotMap<uint32_t, int64_t, utils::PagedSlotIndex<uint32_t, 64>> slotMap;
+		for (uint32_t i = 0; i < 1000; ++i)
+			slotMap.emplace((i * 7919u) % 100000, i);
+		slotMap.erase((500u * 7919u) % 100000);
+		std::stringstream stream;
+		utils::BinaryWriter writer(stream);
+		slotMap.snapshot(writer);
+		const std::string data = stream.str();
+
+		utils::SlotMap<uint32_t, int64_t, utils::PagedSlotIndex<uint32_t, 64>> restored;
+		restored.emplace(7, 7);
+		utils::BinaryReader reader(data);
+		bool same = restored.restore(reader) && restored.size() == slotMap.size() && reader.remaining() == 0;
+		for (uint32_t i = 0; i < 1000; ++i)
+		{
+			const uint32_t key = (i * 7919u) % 100000;
+			same &= restored.contains(key) == slotMap.contains(key) && (!slotMap.contains(key) || restored[key] == slotMap[key]);
+		}
+		EXPECT(same && !restored.contains(7), "Restore SlotMap with trivial values.");
+
+		utils::BinaryReader truncated(std::span<const char>(data.data(), data.size() - 1));
+		EXPECT(!restored.restore(truncated) && restored.empty(), "Truncated snapshot is rejected.");
+
+		// swap the first two keys of the key array, which precedes the values
+		std::string swappedKeys = data;
+		const size_t keysOffset = data.size() - slotMap.size() * (sizeof(uint32_t) + sizeof(int64_t));
+		std::swap_ranges(swappedKeys.begin() + keysOffset, swappedKeys.begin() + keysOffset + sizeof(uint32_t),
+			swappedKeys.begin() + keysOffset + sizeof(uint32_t));
+		utils::BinaryReader swappedReader(swappedKeys);
+		EXPECT(!restored.restore(swappedReader) && restored.empty(), "Snapshot with inconsistent keys is rejected.");
+
+		utils::SlotMap<uint32_t, std::string, utils::DenseSlotIndex<uint32_t>, true> stringMap;
+		for (uint32_t i = 0; i < 100; ++i)
+			stringMap.emplace(99 - i, std::to_string(i));
+		std::stringstream stringStream;
+		utils::BinaryWriter stringWriter(stringStream);
+		stringMap.snapshot(stringWriter);
+		const std::string stringData = stringStream.str();
+		utils::SlotMap<uint32_t, std::string, utils::DenseSlotIndex<uint32_t>, true> restoredStrings;
+		utils::BinaryReader stringReader(stringData);
+		EXPECT(restoredStrings.restore(stringReader) && restoredStrings.size() == 100 && restoredStrings[10] == "89"
+			&& restoredStrings.begin().key() == 99 && restoredStrings.numDirty() == 100, "Restore SlotMap with serialized values.");
+		utils::BinaryReader wrongType(data);
+		EXPECT(!restoredStrings.restore(wrongType) && restoredStrings.empty(), "Snapshot of another type is rejected.");
+
+		struct alignas(32) Aligned { int value; };
+		utils::WeakSlotMap<uint32_t, true, utils::DenseSlotIndex<uint32_t>, utils::ChunkedStorage<256>> weakMap(utils::TypeHolder<Aligned>{});
+		for (uint32_t i = 0; i < 100; ++i)
+			weakMap.template emplace<Aligned>(i * 2, Aligned{ static_cast<int>(i) });
+		std::stringstream weakStream;
+		utils::BinaryWriter weakWriter(weakStream);
+		weakMap.template snapshot<Aligned>(weakWriter);
+		const std::string weakData = weakStream.str();
+		utils::WeakSlotMap<uint32_t, true, utils::DenseSlotIndex<uint32_t>, utils::ChunkedStorage<256>> restoredWeak(utils::TypeHolder<Aligned>{});
+		utils::BinaryReader weakReader(weakData);
+		EXPECT(restoredWeak.template restore<Aligned>(weakReader) && restoredWeak.size() == 100
+			&& restoredWeak.template at<Aligned>(198).value == 99 && !restoredWeak.contains(1), "Restore WeakSlotMap with chunked storage.");
+		std::string duplicateKey = weakData;
+		const size_t weakKeysOffset = weakData.size() - weakMap.size() * (sizeof(uint32_t) + sizeof(Aligned));
+		std::copy_n(duplicateKey.begin() + weakKeysOffset, sizeof(uint32_t), duplicateKey.begin() + weakKeysOffset + sizeof(uint32_t));
+		utils::BinaryReader duplicateReader(duplicateKey);
+		EXPECT(!restoredWeak.template restore<Aligned>(duplicateReader) && restoredWeak.empty(),
+			"WeakSlotMap snapshot with inconsistent keys is rejected.");
+
+		utils::WeakSlotMap<uint32_t> stringWeakMap(utils::TypeHolder<std::string>{});
+		for (uint32_t i = 0; i < 50; ++i)
+			stringWeakMap.template emplace<std::string>(i, 100, static_cast<char>('a' + i % 26));
+		std::stringstream stringWeakStream;
+		utils::BinaryWriter stringWeakWriter(stringWeakStream);
+		stringWeakMap.template snapshot<std::string>(stringWeakWriter);
+		const std::string stringWeakData = stringWeakStream.str();
+		utils::WeakSlotMap<uint32_t> restoredStringWeak(utils::TypeHolder<std::string>{});
+		utils::BinaryReader stringWeakReader(stringWeakData);
+		EXPECT(restoredStringWeak.template restore<std::string>(stringWeakReader) && restoredStringWeak.size() == 50
+			&& restoredStringWeak.template at<std::string>(27) == std::string(100, 'b'), "Restore WeakSlotMap with serialized values.");
+	}
+
+	{
+		using PresenceIndex = utils::PresenceSlotIndex<uint32_t>;
+		utils::SlotMap<uint32_t, int, PresenceIndex> all;
+		utils::SlotMap<uint32_t, float, PresenceIndex> even;
+		utils::WeakSlotMap<uint32_t, true, utils::PresenceSlotIndex<uint32_t, utils::PagedSlotIndex<uint32_t>>> sparse(utils::TypeHolder<int>{});
+		for (uint32_t i = 0; i < 3000; ++i)
+		{
+			all.emplace(i, 0);
+			if (i % 2 == 0) even.emplace(i, 0.f);
+			if (i % 7 == 0 || i == 2999) sparse.template emplace<int>(i, 0);
+		}
+		sparse.template emplace<int>(5000, 0);
+		all.erase(14);
+
+		std::vector<uint32_t> expected;
+		for (uint32_t i = 0; i < 6000; ++i)
+			if (all.contains(i) && even.contains(i) && sparse.contains(i)) expected.push_back(i);
+		std::vector<uint32_t> iterated;
+		for (uint32_t key : utils::commonKeys(all, even, sparse))
+			iterated.push_back(key);
+		std::vector<uint32_t> visited;
+		utils::commonKeys(sparse, all, even).forEach([&](uint32_t _key) { visited.push_back(_key); });
+		EXPECT(expected.size() == 214 && iterated == expected && visited == expected, "Intersect presence bitmaps.");
+
+		all.clear();
+		EXPECT(utils::commonKeys(all, even).begin() == utils::commonKeys(all, even).end(), "Intersection with an empty map.");
+	}
+
+	{
+		utils::SlotMap<uint32_t, int, utils::DenseSlotIndex<uint32_t>, true> slotMap;
+		slotMap.emplace(3, -1);
+		slotMap.clearDirty();
+		const std::vector<uint32_t> keys = { 10, 3, 7, 12, 7 };
+		const std::vector<int> values = { 1, 2, 3, 4, 5 };
+		slotMap.emplaceRange(keys, values);
+		EXPECT(!slotMap.isDirty(3) && slotMap.isDirty(10) && slotMap.isDirty(7), "Emplaced range is dirty.");
+		EXPECT(slotMap.size() == 4 && slotMap[3] == -1 && slotMap[7] == 3 && slotMap[12] == 4,
+			"Emplace range keeps existing and first duplicate values.");
+
+		const std::vector<uint32_t> newKeys = { 20, 21 };
+		slotMap.emplaceRange(newKeys, std::vector<int>{ 20, 21 });
+		slotMap.emplaceN(8, 5, [](uint32_t _key) { return static_cast<int>(_key) * 2; });
+		EXPECT(slotMap.size() == 9 && slotMap[20] == 20 && slotMap[8] == 16 && slotMap[11] == 22 && slotMap[10] == 1,
+			"Emplace generated elements.");
+		slotMap.erase(8);
+		EXPECT(slotMap.size() == 8 && slotMap[9] == 18 && slotMap[21] == 21, "Erase after bulk emplace.");
+
+		utils::SlotMap<uint32_t, std::string, utils::PagedSlotIndex<uint32_t>> stringMap;
+		stringMap.emplaceN(5000, 10, [](uint32_t _key) { return std::to_string(_key); });
+		stringMap.emplaceRange(std::vector<uint32_t>{ 5003, 70000 }, std::vector<std::string>{ "a", "b" });
+		EXPECT(stringMap.size() == 11 && stringMap[5003] == "5003" && stringMap[70000] == "b", "Bulk emplace strings.");
+	}
+
+	{
+		struct alignas(32) Wide { int value; };
+		utils::WeakSlotMap<uint32_t, true, utils::DenseSlotIndex<uint32_t>, utils::ChunkedStorage<64>, true> weakMap(utils::TypeHolder<Wide>{});
+		std::vector<uint32_t> keys;
+		std::vector<Wide> values(100);
+		for (uint32_t i = 0; i < 100; ++i)
+		{
+			keys.push_back(99 - i);
+			values[i].value = static_cast<int>(i);
+		}
+		weakMap.template emplaceRange<Wide>(keys, values);
+		bool allCorrect = weakMap.size() == 100;
+		for (uint32_t i = 0; i < 100; ++i)
+			allCorrect &= weakMap.template at<Wide>(99 - i).value == static_cast<int>(i) && weakMap.isDirty(i);
+		EXPECT(allCorrect, "Emplace range into chunked storage.");
+
+		weakMap.template emplaceRange<Wide>(std::vector<uint32_t>{ 5, 200, 200 }, std::vector<Wide>(3));
+		weakMap.template emplaceN<Wide>(150, 60, [](uint32_t _key) { return Wide{ static_cast<int>(_key) }; });
+		EXPECT(weakMap.size() == 160 && weakMap.template at<Wide>(5).value == 94 && weakMap.template at<Wide>(200).value == 0
+			&& weakMap.template at<Wide>(209).value == 209, "Emplace range with existing keys and generated elements.");
+
+		utils::WeakSlotMap<uint32_t> stringMap(utils::TypeHolder<std::string>{});
+		stringMap.template emplaceN<std::string>(0, 40, [](uint32_t _key) { return std::string(50, static_cast<char>('a' + _key % 26)); });
+		stringMap.template emplaceRange<std::string>(std::vector<uint32_t>{ 1, 40 }, std::vector<std::string>{ "x", "y" });
+		EXPECT(stringMap.size() == 41 && stringMap.template at<std::string>(27) == std::string(50, 'b')
+			&& stringMap.template at<std::string>(40) == "y", "Bulk emplace into WeakSlotMap with destructors.");
+	}
+
+	{
+		utils::SlotMap<uint32_t, int> ints;
+		utils::SlotMap<uint32_t, float, utils::PagedSlotIndex<uint32_t>, true> floats;
+		utils::WeakSlotMap<uint32_t> strings(utils::TypeHolder<std::string>{});
+		for (uint32_t i = 0; i < 100; ++i)
+		{
+			ints.emplace(i, static_cast<int>(i));
+			if (i % 2 == 0) floats.emplace(i, static_cast<float>(i));
+			if (i % 3 == 0) strings.template emplace<std::string>(i, std::to_string(i));
+		}
+		utils::SlotMapGroup group(ints, floats, strings);
+		EXPECT(group.size() == 17 && group.contains(6) && !group.contains(3), "Group existing elements.");
+
+		group.template emplace<1, float>(3, 3.f);
+		group.template erase<0>(12);
+		group.template erase<2>(18);
+		strings.template emplace<std::string>(1, "1");
+		group.add(1);
+		EXPECT(group.size() == 16 && group.contains(3) && !group.contains(1) && !group.contains(12), "Update group.");
+
+		auto isConsistent = [&]()
+		{
+			bool consistent = true;
+			size_t count = 0;
+			group.template forEach<int, const float, std::string>([&](uint32_t _key, int& _i, const float& _f, std::string& _s)
+				{
+					consistent &= _i == static_cast<int>(_key) && _f == static_cast<float>(_key) && _s == std::to_string(_key);
+					++count;
+				});
+			for (uint32_t i = 0; i < 120; ++i)
+				consistent &= group.contains(i) == (ints.contains(i) && floats.contains(i) && strings.contains(i));
+			auto intIt = ints.begin();
+			auto floatIt = floats.begin();
+			for (size_t i = 0; i < group.size(); ++i, ++intIt, ++floatIt)
+				consistent &= intIt.key() == group.keys()[i] && floatIt.key() == group.keys()[i];
+			return consistent && count == group.size();
+		};
+		EXPECT(isConsistent(), "Grouped elements are packed in the same order.");
+
+		for (uint32_t i = 100; i < 120; ++i)
+		{
+			group.template emplace<0, int>(i, static_cast<int>(i));
+			group.template emplace<2, std::string>(i, std::to_string(i));
+			const float& value = group.template emplace<1, float>(i, static_cast<float>(i));
+			EXPECT(value == static_cast<float>(i), "Emplace returns the moved element.");
+		}
+		for (uint32_t i = 0; i < 120; i += 5)
+			if (group.contains(i)) group.template erase<1>(i);
+		EXPECT(group.size() == 28 && isConsistent(), "Group stays consistent.");
+
+		ints.sort();
+		group.rebuild();
+		EXPECT(group.size() == 28 && isConsistent(), "Rebuild group.");
+	}
 
 	return testsFailed;
 }
\ No newline at end of file